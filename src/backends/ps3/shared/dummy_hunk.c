@@ -25,99 +25,125 @@
  */
 
 /*
- * Code taken from vitaQuakeII
- * As calculated this is takes around 1 megabytes 
- * more RAM (total - after level load) which is negligible
- * It is so until mman.h would be ported to PS3
+ * The PS3 has no mmap(), so the hunk can't reserve address space
+ * without committing it. Instead the reservation is malloc()ed
+ * without touching it and shrunk in place by Hunk_End(). newlibs
+ * realloc() never moves a block it shrinks, so pointers into the
+ * hunk stay valid. Should a loader underestimate its needs, the
+ * hunk grows by chunks chained to the first block instead of
+ * bailing out.
  */
 
 #include "../../../common/header/common.h"
 
-byte *membase;
-int maxhunksize;
-int curhunksize;
+#define HUNK_CHUNK_SIZE (256 * 1024)
 
-void *Hunk_Begin (int maxsize)
+/* Sits in front of each block, 32 bytes to keep the cacheline alignment. */
+typedef struct hunkchunk_s
 {
-	// reserve a huge chunk of memory, but don't commit any yet
-	maxhunksize = maxsize + sizeof(size_t) + 32;
-	curhunksize = 0;
-	membase = malloc(maxhunksize);
-
-	if (membase == NULL)
-    {
-		Sys_Error("unable to allocate %d bytes", maxhunksize);
-    }
-	else
-    {
-		memset (membase, 0, maxhunksize);
-    }
-
-	return membase;
-}
+	struct hunkchunk_s *next;
+	int size;
+	int used;
+	byte pad[32 - sizeof(void *) - 2 * sizeof(int)];
+} hunkchunk_t;
+
+static hunkchunk_t *hunkbase;
+static hunkchunk_t *hunkcur;
 
-void *Hunk_Alloc (int size)
+static hunkchunk_t *
+Hunk_NewChunk(int size)
 {
-	byte *buf;
+	hunkchunk_t *chunk;
 
-	// round to cacheline
-	size = (size+31)&~31;
+	chunk = malloc(sizeof(hunkchunk_t) + size);
 
-	if (curhunksize + size > maxhunksize)
-    {
-		Sys_Error("Hunk_Alloc overflow");
-    }
+	if (chunk == NULL)
+	{
+		Sys_Error("unable to allocate %d bytes", size);
+	}
 
-	buf = membase + curhunksize;
-	curhunksize += size;
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
 
-	return buf;
+	return chunk;
 }
 
-static void loose_counter() 
+void *
+Hunk_Begin(int maxsize)
 {
-    static int loose = 0;
-    loose += (maxhunksize - curhunksize);
-    printf("inc: %d bytes loose: %d bytes\n", maxhunksize - curhunksize, loose);
+	/* plus 32 bytes for cacheline */
+	maxsize = maxsize + sizeof(size_t) + 32;
+
+	hunkbase = hunkcur = Hunk_NewChunk(maxsize);
+
+	return hunkbase + 1;
 }
 
-int Hunk_End (void)
+void *
+Hunk_Alloc(int size)
 {
-	/* We would prefer to shrink the allocated memory
-	 * buffer to 'curhunksize' bytes here, but there exists
-	 * no robust cross-platform method for doing this
-	 * given that pointers to arbitrary locations in
-	 * the buffer are stored and used throughout the
-	 * codebase...
-	 * (i.e. realloc() would invalidate these pointers,
-	 * and break everything)
-	 * Attempts were made to allocate hunks dynamically,
-	 * storing them in an RBUF array - but the codebase
-	 * plays such dirty tricks with the returned pointers
-	 * that this turned out to be impractical (it would
-	 * have required a major rewrite of the renderers...) */
-#if 0
-	byte *n;
-
-	n = realloc(membase, curhunksize);
-
-	if (n != membase)
-		Sys_Error("Hunk_End:  Could not remap virtual block (%d)", errno);
-#endif
-    loose_counter();
-	return curhunksize;
+	byte *buf;
+
+	/* round to cacheline */
+	size = (size + 31) & ~31;
+
+	if (hunkcur->used + size > hunkcur->size)
+	{
+		hunkcur->next = Hunk_NewChunk((size > HUNK_CHUNK_SIZE) ? size : HUNK_CHUNK_SIZE);
+		hunkcur = hunkcur->next;
+	}
+
+	buf = (byte *)(hunkcur + 1) + hunkcur->used;
+	hunkcur->used += size;
+
+	/* only what's handed out is touched */
+	memset(buf, 0, size);
+
+	return buf;
 }
 
-void Hunk_Free (void *base)
+int
+Hunk_End(void)
 {
-	if (base == membase)
-    {
-		membase = NULL;
-    }
-
-	if (base)
-    {
-		free(base);
-    }
+	hunkchunk_t *chunk, *n;
+	int total = 0;
+
+	/* Give the unused tails back. */
+	for (chunk = hunkbase; chunk; chunk = chunk->next)
+	{
+		if (chunk->used < chunk->size)
+		{
+			chunk->size = chunk->used;
+			n = realloc(chunk, sizeof(hunkchunk_t) + chunk->size);
+
+			if (n != chunk)
+			{
+				Sys_Error("Hunk_End: realloc moved the hunk");
+			}
+
+			chunk = n;
+		}
+
+		total += chunk->used;
+	}
+
+	return total;
 }
 
+void
+Hunk_Free(void *base)
+{
+	hunkchunk_t *chunk, *next;
+
+	if (!base)
+	{
+		return;
+	}
+
+	for (chunk = (hunkchunk_t *)base - 1; chunk; chunk = next)
+	{
+		next = chunk->next;
+		free(chunk);
+	}
+}
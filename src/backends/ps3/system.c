@@ -8,6 +8,9 @@
 
 #include <sys/file.h>
 #include <sys/stat.h>
+#include <sys/thread.h>
+#include <sys/mutex.h>
+#include <sys/cond.h>
 
 #include <sys/cdefs.h>
 
@@ -575,3 +578,154 @@ void Sys_FindClose(void)
 		
 	fdir = -1;
 }
+
+// ---------------------------------------------
+//  Threads
+// ---------------------------------------------
+
+// lv2 condition variables are bound to their
+// mutex at creation, that's where the API for
+// all platforms comes from.
+
+#define THREAD_PRIORITY 1500
+#define THREAD_STACKSIZE 0x10000
+
+struct qthread_s
+{
+	sys_ppu_thread_t id;
+	void (*func)(void *);
+	void *data;
+};
+
+struct qmutex_s
+{
+	sys_mutex_t id;
+};
+
+struct qcond_s
+{
+	sys_cond_t id;
+};
+
+static void
+Sys_ThreadEntry(void *arg)
+{
+	qthread_t *thread = arg;
+
+	thread->func(thread->data);
+
+	sysThreadExit(0);
+}
+
+qthread_t *
+Sys_CreateThread(void (*func)(void *), void *data, const char *name)
+{
+	qthread_t *thread;
+
+	thread = malloc(sizeof(qthread_t));
+	YQ2_COM_CHECK_OOM(thread, "malloc()", sizeof(qthread_t))
+
+	thread->func = func;
+	thread->data = data;
+
+	if (sysThreadCreate(&thread->id, Sys_ThreadEntry, thread, THREAD_PRIORITY,
+				THREAD_STACKSIZE, THREAD_JOINABLE, (char *)name) != 0)
+	{
+		Com_Printf("WARNING: Couldn't create thread '%s'.\n", name);
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+void
+Sys_JoinThread(qthread_t *thread)
+{
+	u64 retval;
+
+	sysThreadJoin(thread->id, &retval);
+	free(thread);
+}
+
+qmutex_t *
+Sys_CreateMutex(void)
+{
+	qmutex_t *mutex;
+	sys_mutex_attr_t attr;
+
+	mutex = malloc(sizeof(qmutex_t));
+	YQ2_COM_CHECK_OOM(mutex, "malloc()", sizeof(qmutex_t))
+
+	memset(&attr, 0, sizeof(attr));
+	attr.attr_protocol = SYS_MUTEX_PROTOCOL_FIFO;
+	attr.attr_recursive = SYS_MUTEX_ATTR_NOT_RECURSIVE;
+	attr.attr_pshared = SYS_MUTEX_ATTR_PSHARED;
+	attr.attr_adaptive = SYS_MUTEX_ATTR_NOT_ADAPTIVE;
+
+	sysMutexCreate(&mutex->id, &attr);
+
+	return mutex;
+}
+
+void
+Sys_DestroyMutex(qmutex_t *mutex)
+{
+	sysMutexDestroy(mutex->id);
+	free(mutex);
+}
+
+void
+Sys_LockMutex(qmutex_t *mutex)
+{
+	sysMutexLock(mutex->id, 0);
+}
+
+void
+Sys_UnlockMutex(qmutex_t *mutex)
+{
+	sysMutexUnlock(mutex->id);
+}
+
+qcond_t *
+Sys_CreateCond(qmutex_t *mutex)
+{
+	qcond_t *cond;
+	sys_cond_attr_t attr;
+
+	cond = malloc(sizeof(qcond_t));
+	YQ2_COM_CHECK_OOM(cond, "malloc()", sizeof(qcond_t))
+
+	memset(&attr, 0, sizeof(attr));
+	attr.attr_pshared = SYS_COND_ATTR_PSHARED;
+
+	sysCondCreate(&cond->id, mutex->id, &attr);
+
+	return cond;
+}
+
+void
+Sys_DestroyCond(qcond_t *cond)
+{
+	sysCondDestroy(cond->id);
+	free(cond);
+}
+
+void
+Sys_WaitCond(qcond_t *cond)
+{
+	sysCondWait(cond->id, 0);
+}
+
+void
+Sys_BroadcastCond(qcond_t *cond)
+{
+	sysCondBroadcast(cond->id);
+}
+
+int
+Sys_GetNumCPUs(void)
+{
+	// The PPU has two hardware threads.
+	return 2;
+}
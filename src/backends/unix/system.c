@@ -27,6 +27,7 @@
 #include <dirent.h>
 #include <dlfcn.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -647,3 +648,134 @@ Sys_SetWorkDir(char *path)
 
 	return false;
 }
+
+/* ================================================================ */
+
+struct qthread_s
+{
+	pthread_t thread;
+	void (*func)(void *);
+	void *data;
+};
+
+struct qmutex_s
+{
+	pthread_mutex_t mutex;
+};
+
+struct qcond_s
+{
+	pthread_cond_t cond;
+	qmutex_t *mutex;
+};
+
+static void *
+Sys_ThreadEntry(void *arg)
+{
+	qthread_t *thread = arg;
+
+	thread->func(thread->data);
+
+	return NULL;
+}
+
+qthread_t *
+Sys_CreateThread(void (*func)(void *), void *data, const char *name)
+{
+	qthread_t *thread;
+
+	thread = malloc(sizeof(qthread_t));
+	YQ2_COM_CHECK_OOM(thread, "malloc()", sizeof(qthread_t))
+
+	thread->func = func;
+	thread->data = data;
+
+	if (pthread_create(&thread->thread, NULL, Sys_ThreadEntry, thread) != 0)
+	{
+		Com_Printf("WARNING: Couldn't create thread '%s'.\n", name);
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+void
+Sys_JoinThread(qthread_t *thread)
+{
+	pthread_join(thread->thread, NULL);
+	free(thread);
+}
+
+qmutex_t *
+Sys_CreateMutex(void)
+{
+	qmutex_t *mutex;
+
+	mutex = malloc(sizeof(qmutex_t));
+	YQ2_COM_CHECK_OOM(mutex, "malloc()", sizeof(qmutex_t))
+
+	pthread_mutex_init(&mutex->mutex, NULL);
+
+	return mutex;
+}
+
+void
+Sys_DestroyMutex(qmutex_t *mutex)
+{
+	pthread_mutex_destroy(&mutex->mutex);
+	free(mutex);
+}
+
+void
+Sys_LockMutex(qmutex_t *mutex)
+{
+	pthread_mutex_lock(&mutex->mutex);
+}
+
+void
+Sys_UnlockMutex(qmutex_t *mutex)
+{
+	pthread_mutex_unlock(&mutex->mutex);
+}
+
+qcond_t *
+Sys_CreateCond(qmutex_t *mutex)
+{
+	qcond_t *cond;
+
+	cond = malloc(sizeof(qcond_t));
+	YQ2_COM_CHECK_OOM(cond, "malloc()", sizeof(qcond_t))
+
+	pthread_cond_init(&cond->cond, NULL);
+	cond->mutex = mutex;
+
+	return cond;
+}
+
+void
+Sys_DestroyCond(qcond_t *cond)
+{
+	pthread_cond_destroy(&cond->cond);
+	free(cond);
+}
+
+void
+Sys_WaitCond(qcond_t *cond)
+{
+	pthread_cond_wait(&cond->cond, &cond->mutex->mutex);
+}
+
+void
+Sys_BroadcastCond(qcond_t *cond)
+{
+	pthread_cond_broadcast(&cond->cond);
+}
+
+int
+Sys_GetNumCPUs(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (cpus > 0) ? (int)cpus : 1;
+}
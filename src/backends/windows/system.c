@@ -793,3 +793,137 @@ Sys_SetHighDPIMode(void)
 		SetProcessDPIAware();
 	}
 }
+
+/* ================================================================ */
+
+struct qthread_s
+{
+	HANDLE handle;
+	void (*func)(void *);
+	void *data;
+};
+
+struct qmutex_s
+{
+	CRITICAL_SECTION cs;
+};
+
+struct qcond_s
+{
+	CONDITION_VARIABLE cv;
+	qmutex_t *mutex;
+};
+
+static DWORD WINAPI
+Sys_ThreadEntry(LPVOID arg)
+{
+	qthread_t *thread = arg;
+
+	thread->func(thread->data);
+
+	return 0;
+}
+
+qthread_t *
+Sys_CreateThread(void (*func)(void *), void *data, const char *name)
+{
+	qthread_t *thread;
+
+	thread = malloc(sizeof(qthread_t));
+	YQ2_COM_CHECK_OOM(thread, "malloc()", sizeof(qthread_t))
+
+	thread->func = func;
+	thread->data = data;
+	thread->handle = CreateThread(NULL, 0, Sys_ThreadEntry, thread, 0, NULL);
+
+	if (thread->handle == NULL)
+	{
+		Com_Printf("WARNING: Couldn't create thread '%s'.\n", name);
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+void
+Sys_JoinThread(qthread_t *thread)
+{
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+	free(thread);
+}
+
+qmutex_t *
+Sys_CreateMutex(void)
+{
+	qmutex_t *mutex;
+
+	mutex = malloc(sizeof(qmutex_t));
+	YQ2_COM_CHECK_OOM(mutex, "malloc()", sizeof(qmutex_t))
+
+	InitializeCriticalSection(&mutex->cs);
+
+	return mutex;
+}
+
+void
+Sys_DestroyMutex(qmutex_t *mutex)
+{
+	DeleteCriticalSection(&mutex->cs);
+	free(mutex);
+}
+
+void
+Sys_LockMutex(qmutex_t *mutex)
+{
+	EnterCriticalSection(&mutex->cs);
+}
+
+void
+Sys_UnlockMutex(qmutex_t *mutex)
+{
+	LeaveCriticalSection(&mutex->cs);
+}
+
+qcond_t *
+Sys_CreateCond(qmutex_t *mutex)
+{
+	qcond_t *cond;
+
+	cond = malloc(sizeof(qcond_t));
+	YQ2_COM_CHECK_OOM(cond, "malloc()", sizeof(qcond_t))
+
+	InitializeConditionVariable(&cond->cv);
+	cond->mutex = mutex;
+
+	return cond;
+}
+
+void
+Sys_DestroyCond(qcond_t *cond)
+{
+	free(cond);
+}
+
+void
+Sys_WaitCond(qcond_t *cond)
+{
+	SleepConditionVariableCS(&cond->cv, &cond->mutex->cs, INFINITE);
+}
+
+void
+Sys_BroadcastCond(qcond_t *cond)
+{
+	WakeAllConditionVariable(&cond->cv);
+}
+
+int
+Sys_GetNumCPUs(void)
+{
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+
+	return (info.dwNumberOfProcessors > 0) ? (int)info.dwNumberOfProcessors : 1;
+}
@@ -72,6 +72,74 @@ static const char *env_suf[6] = {"rt", "bk", "lf", "ft", "up", "dn"};
 #define ENV_CNT (CS_PLAYERSKINS + MAX_CLIENTS * PLAYER_MULT)
 #define TEXTURE_CNT (ENV_CNT + 13)
 
+/*
+ * Queues everything the level is going to load, so it's
+ * read in the background while the map is registered.
+ * Must mirror the names CL_RegisterSounds() and
+ * CL_PrepRefresh() ask the filesystem for.
+ */
+static void
+CL_PrefetchAssets(void)
+{
+	char fn[MAX_OSPATH];
+	const char *name;
+	int i;
+
+	FS_BeginPrefetch();
+
+	for (i = 1; i < MAX_MODELS && cl.configstrings[CS_MODELS + i][0]; i++)
+	{
+		name = cl.configstrings[CS_MODELS + i];
+
+		if ((name[0] != '*') && (name[0] != '#'))
+		{
+			FS_Prefetch(name);
+		}
+	}
+
+	for (i = 0; i < CM_NumTexinfo(); i++)
+	{
+		Com_sprintf(fn, sizeof(fn), "textures/%s.wal", CM_TexinfoName(i));
+		FS_Prefetch(fn);
+	}
+
+	for (i = 1; i < MAX_SOUNDS && cl.configstrings[CS_SOUNDS + i][0]; i++)
+	{
+		name = cl.configstrings[CS_SOUNDS + i];
+
+		if (name[0] == '*')
+		{
+			/* sexed sounds are resolved later */
+			continue;
+		}
+
+		if (name[0] == '#')
+		{
+			FS_Prefetch(name + 1);
+		}
+		else
+		{
+			Com_sprintf(fn, sizeof(fn), "sound/%s", name);
+			FS_Prefetch(fn);
+		}
+	}
+
+	for (i = 1; i < MAX_IMAGES && cl.configstrings[CS_IMAGES + i][0]; i++)
+	{
+		name = cl.configstrings[CS_IMAGES + i];
+
+		if ((name[0] == '/') || (name[0] == '\\'))
+		{
+			FS_Prefetch(name + 1);
+		}
+		else
+		{
+			Com_sprintf(fn, sizeof(fn), "pics/%s.pcx", name);
+			FS_Prefetch(fn);
+		}
+	}
+}
+
 void
 CL_RequestNextDownload(void)
 {
@@ -479,17 +547,14 @@ CL_RequestNextDownload(void)
 	/* confirm existance of textures, download any that don't exist */
 	if (precache_check == TEXTURE_CNT + 1)
 	{
-		extern int numtexinfo;
-		extern mapsurface_t map_surfaces[];
-
 		if (allow_download->value && allow_download_maps->value)
 		{
-			while (precache_tex < numtexinfo)
+			while (precache_tex < CM_NumTexinfo())
 			{
 				char fn[MAX_OSPATH];
 
 				sprintf(fn, "textures/%s.wal",
-						map_surfaces[precache_tex++].rname);
+						CM_TexinfoName(precache_tex++));
 
 				if (!CL_CheckOrDownloadFile(fn))
 				{
@@ -520,6 +585,7 @@ CL_RequestNextDownload(void)
 	dlquirks.filelist = true;
 #endif
 
+	CL_PrefetchAssets();
 	CL_RegisterSounds();
 	CL_PrepRefresh();
 
@@ -792,6 +858,8 @@ CL_ParseDownload(void)
 			Com_Printf("failed to rename.\n");
 		}
 
+		FS_FlushMissingCache();
+
 		cls.download = NULL;
 		cls.downloadpercent = 0;
 
@@ -42,6 +42,7 @@ cvar_t *cl_noskins;
 cvar_t *cl_footsteps;
 cvar_t *cl_timeout;
 cvar_t *cl_predict;
+cvar_t *cl_packedentities;
 cvar_t *cl_showfps;
 cvar_t *cl_gun;
 cvar_t *cl_add_particles;
@@ -176,6 +177,13 @@ CL_Record_f(void)
 	Com_sprintf(name, sizeof(name), "%s/demos/%s.dm2", FS_Gamedir(), Cmd_Argv(1));
 
 	Com_Printf("recording to %s.\n", name);
+
+	if (cl.packedentities)
+	{
+		Com_Printf("WARNING: the server sends bit packed entities, only "
+				"clients with cl_packedentities can play this demo.\n");
+	}
+
 	FS_CreatePath(name);
 	cls.demofile = Q_fopen(name, "wb");
 
@@ -515,6 +523,7 @@ CL_InitLocal(void)
 	cl_showmiss = Cvar_Get("cl_showmiss", "0", 0);
 	cl_showclamp = Cvar_Get("showclamp", "0", 0);
 	cl_timeout = Cvar_Get("cl_timeout", "120", 0);
+	cl_packedentities = Cvar_Get("cl_packedentities", "0", CVAR_ARCHIVE);
 	cl_paused = Cvar_Get("paused", "0", 0);
 	cl_loadpaused = Cvar_Get("cl_loadpaused", "1", CVAR_ARCHIVE);
 
@@ -644,6 +653,9 @@ CL_WriteConfiguration(void)
 	fflush(f);
 	fclose(f);
 
+	/* config.cfg may have been missing so far */
+	FS_FlushMissingCache();
+
 	Cvar_WriteVariables(path);
 }
 
@@ -920,6 +932,10 @@ CL_Init(void)
 
 	cls.disable_screen = true; /* don't draw yet */
 
+	/* the client state is static, but counts nevertheless */
+	Mem_Account(MEM_CLIENT, sizeof(cls) + sizeof(cl) +
+			sizeof(cl_entities) + sizeof(cl_parse_entities));
+
 	CL_InitLocal();
 
 	Cbuf_Execute();
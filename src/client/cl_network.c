@@ -134,8 +134,11 @@ CL_SendConnectPacket(void)
 
 	userinfo_modified = false;
 
-	Netchan_OutOfBandPrint(NS_CLIENT, adr, "connect %i %i %i \"%s\"\n",
-			PROTOCOL_VERSION, port, cls.challenge, Cvar_Userinfo());
+	/* servers that don't know about the bit packed
+	   entities ignore the additional argument */
+	Netchan_OutOfBandPrint(NS_CLIENT, adr, "connect %i %i %i \"%s\"%s\n",
+			PROTOCOL_VERSION, port, cls.challenge, Cvar_Userinfo(),
+			cl_packedentities->value ? " packedents=1" : "");
 }
 
 /*
@@ -55,7 +55,8 @@ char *svc_strings[256] = {
 	"svc_playerinfo",
 	"svc_packetentities",
 	"svc_deltapacketentities",
-	"svc_frame"
+	"svc_frame",
+	"svc_packedentities"
 };
 
 void
@@ -86,51 +87,20 @@ CL_RegisterSounds(void)
 int
 CL_ParseEntityBits(unsigned *bits)
 {
-	unsigned b, total;
 	int i;
 	int number;
 
-	total = MSG_ReadByte(&net_message);
-
-	if (total & U_MOREBITS1)
-	{
-		b = MSG_ReadByte(&net_message);
-		total |= b << 8;
-	}
-
-	if (total & U_MOREBITS2)
-	{
-		b = MSG_ReadByte(&net_message);
-		total |= b << 16;
-	}
-
-	if (total & U_MOREBITS3)
-	{
-		b = MSG_ReadByte(&net_message);
-		total |= b << 24;
-	}
+	number = MSG_ReadEntityBits(&net_message, bits);
 
 	/* count the bits for net profiling */
 	for (i = 0; i < 32; i++)
 	{
-		if (total & (1u << i))
+		if (*bits & (1u << i))
 		{
 			bitcounts[i]++;
 		}
 	}
 
-	if (total & U_NUMBER16)
-	{
-		number = MSG_ReadShort(&net_message);
-	}
-
-	else
-	{
-		number = MSG_ReadByte(&net_message);
-	}
-
-	*bits = total;
-
 	return number;
 }
 
@@ -140,135 +110,7 @@ CL_ParseEntityBits(unsigned *bits)
 void
 CL_ParseDelta(entity_state_t *from, entity_state_t *to, int number, int bits)
 {
-	/* set everything to the state we are delta'ing from */
-	*to = *from;
-
-	VectorCopy(from->origin, to->old_origin);
-	to->number = number;
-
-	if (bits & U_MODEL)
-	{
-		to->modelindex = MSG_ReadByte(&net_message);
-	}
-
-	if (bits & U_MODEL2)
-	{
-		to->modelindex2 = MSG_ReadByte(&net_message);
-	}
-
-	if (bits & U_MODEL3)
-	{
-		to->modelindex3 = MSG_ReadByte(&net_message);
-	}
-
-	if (bits & U_MODEL4)
-	{
-		to->modelindex4 = MSG_ReadByte(&net_message);
-	}
-
-	if (bits & U_FRAME8)
-	{
-		to->frame = MSG_ReadByte(&net_message);
-	}
-
-	if (bits & U_FRAME16)
-	{
-		to->frame = MSG_ReadShort(&net_message);
-	}
-
-	/* used for laser colors */
-	if ((bits & U_SKIN8) && (bits & U_SKIN16))
-	{
-		to->skinnum = MSG_ReadLong(&net_message);
-	}
-	else if (bits & U_SKIN8)
-	{
-		to->skinnum = MSG_ReadByte(&net_message);
-	}
-	else if (bits & U_SKIN16)
-	{
-		to->skinnum = MSG_ReadShort(&net_message);
-	}
-
-	if ((bits & (U_EFFECTS8 | U_EFFECTS16)) == (U_EFFECTS8 | U_EFFECTS16))
-	{
-		to->effects = MSG_ReadLong(&net_message);
-	}
-	else if (bits & U_EFFECTS8)
-	{
-		to->effects = MSG_ReadByte(&net_message);
-	}
-	else if (bits & U_EFFECTS16)
-	{
-		to->effects = MSG_ReadShort(&net_message);
-	}
-
-	if ((bits & (U_RENDERFX8 | U_RENDERFX16)) == (U_RENDERFX8 | U_RENDERFX16))
-	{
-		to->renderfx = MSG_ReadLong(&net_message);
-	}
-	else if (bits & U_RENDERFX8)
-	{
-		to->renderfx = MSG_ReadByte(&net_message);
-	}
-	else if (bits & U_RENDERFX16)
-	{
-		to->renderfx = MSG_ReadShort(&net_message);
-	}
-
-	if (bits & U_ORIGIN1)
-	{
-		to->origin[0] = MSG_ReadCoord(&net_message);
-	}
-
-	if (bits & U_ORIGIN2)
-	{
-		to->origin[1] = MSG_ReadCoord(&net_message);
-	}
-
-	if (bits & U_ORIGIN3)
-	{
-		to->origin[2] = MSG_ReadCoord(&net_message);
-	}
-
-	if (bits & U_ANGLE1)
-	{
-		to->angles[0] = MSG_ReadAngle(&net_message);
-	}
-
-	if (bits & U_ANGLE2)
-	{
-		to->angles[1] = MSG_ReadAngle(&net_message);
-	}
-
-	if (bits & U_ANGLE3)
-	{
-		to->angles[2] = MSG_ReadAngle(&net_message);
-	}
-
-	if (bits & U_OLDORIGIN)
-	{
-		MSG_ReadPos(&net_message, to->old_origin);
-	}
-
-	if (bits & U_SOUND)
-	{
-		to->sound = MSG_ReadByte(&net_message);
-	}
-
-	if (bits & U_EVENT)
-	{
-		to->event = MSG_ReadByte(&net_message);
-	}
-	else
-	{
-		to->event = 0;
-	}
-
-	if (bits & U_SOLID)
-	{
-		to->solid = MSG_ReadShort(&net_message);
-	}
+	MSG_ReadDeltaEntity(&net_message, from, to, number, bits);
 }
 
 /*
@@ -276,7 +118,8 @@ CL_ParseDelta(entity_state_t *from, entity_state_t *to, int number, int bits)
  * the current frame
  */
 void
-CL_DeltaEntity(frame_t *frame, int newnum, entity_state_t *old, int bits)
+CL_DeltaEntity(frame_t *frame, int newnum, entity_state_t *old, int bits,
+		qboolean packed)
 {
 	centity_t *ent;
 	entity_state_t *state;
@@ -287,7 +130,14 @@ CL_DeltaEntity(frame_t *frame, int newnum, entity_state_t *old, int bits)
 	cl.parse_entities++;
 	frame->num_entities++;
 
-	CL_ParseDelta(old, state, newnum, bits);
+	if (packed)
+	{
+		MSG_ReadPackedDeltaEntity(&net_message, old, state, newnum, bits);
+	}
+	else
+	{
+		CL_ParseDelta(old, state, newnum, bits);
+	}
 
 	/* some data changes will force no lerping */
 	if ((state->modelindex != ent->current.modelindex) ||
@@ -335,18 +185,19 @@ CL_DeltaEntity(frame_t *frame, int newnum, entity_state_t *old, int bits)
 }
 
 /*
- * An svc_packetentities has just been
- * parsed, deal with the rest of the
- * data stream.
+ * An svc_packetentities or svc_packedentities
+ * has just been parsed, deal with the rest
+ * of the data stream.
  */
 void
-CL_ParsePacketEntities(frame_t *oldframe, frame_t *newframe)
+CL_ParsePacketEntities(frame_t *oldframe, frame_t *newframe, qboolean packed)
 {
 	unsigned int newnum;
 	unsigned bits;
 	entity_state_t
 	*oldstate = NULL;
 	int oldindex, oldnum;
+	int lastnum = 0;
 
 	newframe->parse_entities = cl.parse_entities;
 	newframe->num_entities = 0;
@@ -376,7 +227,15 @@ CL_ParsePacketEntities(frame_t *oldframe, frame_t *newframe)
 
 	while (1)
 	{
-		newnum = CL_ParseEntityBits(&bits);
+		if (packed)
+		{
+			newnum = MSG_ReadPackedEntityBits(&net_message, &bits, lastnum);
+			lastnum = newnum;
+		}
+		else
+		{
+			newnum = CL_ParseEntityBits(&bits);
+		}
 
 		if (newnum >= MAX_EDICTS)
 		{
@@ -401,7 +260,7 @@ CL_ParsePacketEntities(frame_t *oldframe, frame_t *newframe)
 				Com_Printf("   unchanged: %i\n", oldnum);
 			}
 
-			CL_DeltaEntity(newframe, oldnum, oldstate, 0);
+			CL_DeltaEntity(newframe, oldnum, oldstate, 0, packed);
 
 			oldindex++;
 
@@ -456,7 +315,7 @@ CL_ParsePacketEntities(frame_t *oldframe, frame_t *newframe)
 				Com_Printf("   delta: %i\n", newnum);
 			}
 
-			CL_DeltaEntity(newframe, newnum, oldstate, bits);
+			CL_DeltaEntity(newframe, newnum, oldstate, bits, packed);
 
 			oldindex++;
 
@@ -485,7 +344,7 @@ CL_ParsePacketEntities(frame_t *oldframe, frame_t *newframe)
 
 			CL_DeltaEntity(newframe, newnum,
 					&cl_entities[newnum].baseline,
-					bits);
+					bits, packed);
 			continue;
 		}
 	}
@@ -499,7 +358,7 @@ CL_ParsePacketEntities(frame_t *oldframe, frame_t *newframe)
 			Com_Printf("   unchanged: %i\n", oldnum);
 		}
 
-		CL_DeltaEntity(newframe, oldnum, oldstate, 0);
+		CL_DeltaEntity(newframe, oldnum, oldstate, 0, packed);
 
 		oldindex++;
 
@@ -770,12 +629,13 @@ CL_ParseFrame(void)
 	cmd = MSG_ReadByte(&net_message);
 	SHOWNET(svc_strings[cmd]);
 
-	if (cmd != svc_packetentities)
+	if ((cmd != svc_packetentities) && (cmd != svc_packedentities))
 	{
 		Com_Error(ERR_DROP, "CL_ParseFrame: 0x%X not packetentities", cmd);
 	}
 
-	CL_ParsePacketEntities(old, &cl.frame);
+	CL_ParsePacketEntities(old, &cl.frame, cmd == svc_packedentities);
+	cl.packedentities = (cmd == svc_packedentities);
 
 	/* save the frame off in the backup array for later delta comparisons */
 	cl.frames[cl.frame.serverframe & UPDATE_MASK] = cl.frame;
@@ -1382,6 +1242,7 @@ CL_ParseServerMessage(void)
 			case svc_playerinfo:
 			case svc_packetentities:
 			case svc_deltapacketentities:
+			case svc_packedentities:
 				Com_Error(ERR_DROP, "Out of place frame data");
 				break;
 		}
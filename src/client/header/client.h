@@ -131,6 +131,7 @@ typedef struct
 	vec3_t		prediction_error;
 
 	frame_t		frame; /* received from server */
+	qboolean	packedentities; /* the frames came with svc_packedentities */
 	int			surpressCount; /* number of messages rate supressed */
 	frame_t		frames[UPDATE_BACKUP];
 
@@ -281,6 +282,7 @@ extern	cvar_t	*cl_add_lights;
 extern	cvar_t	*cl_add_particles;
 extern	cvar_t	*cl_add_entities;
 extern	cvar_t	*cl_predict;
+extern	cvar_t	*cl_packedentities;
 extern	cvar_t	*cl_footsteps;
 extern	cvar_t	*cl_noskins;
 extern	cvar_t	*cl_upspeed;
@@ -267,6 +267,7 @@ Mod_ForName (char *name, model_t *parent_model, qboolean crash)
 	}
 
 	mod->extradatasize = Hunk_End();
+	ri.Mem_Account(MEM_HUNK, mod->extradatasize);
 
 	ri.FS_FreeFile(buf);
 
@@ -1059,6 +1060,7 @@ void
 Mod_Free(model_t *mod)
 {
 	Hunk_Free(mod->extradata);
+	ri.Mem_Account(MEM_HUNK, -mod->extradatasize);
 	memset(mod, 0, sizeof(*mod));
 }
 
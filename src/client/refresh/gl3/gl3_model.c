@@ -946,6 +946,7 @@ static void
 Mod_Free(gl3model_t *mod)
 {
 	Hunk_Free(mod->extradata);
+	ri.Mem_Account(MEM_HUNK, -mod->extradatasize);
 	memset(mod, 0, sizeof(*mod));
 }
 
@@ -1067,6 +1068,7 @@ Mod_ForName (char *name, gl3model_t *parent_model, qboolean crash)
 	}
 
 	mod->extradatasize = Hunk_End();
+	ri.Mem_Account(MEM_HUNK, mod->extradatasize);
 
 	ri.FS_FreeFile(buf);
 
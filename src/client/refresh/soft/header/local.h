@@ -569,6 +569,7 @@ void R_NewMap (void);
 void Draw_InitLocal(void);
 void R_InitCaches(void);
 void D_FlushCaches(void);
+void D_FreeCaches(void);
 
 void	RE_BeginRegistration (char *model);
 struct model_s	*RE_RegisterModel (char *name);
@@ -213,6 +213,7 @@ typedef struct model_s
 	image_t		*skins[MAX_MD2SKINS];
 	void		*extradata;
 	int		extradatasize;
+	int		extradatareserved;	// passed to Hunk_Begin()
 
 	// submodules
 	vec3_t		origin;	// for sounds or lights
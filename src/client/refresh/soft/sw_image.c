@@ -26,6 +26,7 @@ static image_t		r_images[MAX_RIMAGES];
 static int		numr_images;
 static int		image_max = 0;
 
+static size_t R_GetImageMipsSize(size_t mip1_size);
 
 /*
 ===============
@@ -35,12 +36,14 @@ R_ImageList_f
 void
 R_ImageList_f (void)
 {
-	int		i, used, texels;
+	int		i, used, texels, bytes, scaled;
 	image_t	*image;
 	qboolean	freeup;
 
 	R_Printf(PRINT_ALL, "------------------\n");
 	texels = 0;
+	bytes = 0;
+	scaled = 0;
 	used = 0;
 
 	for (i=0, image=r_images ; i<numr_images ; i++, image++)
@@ -56,6 +59,12 @@ R_ImageList_f (void)
 		if (image->registration_sequence <= 0)
 			continue;
 		texels += image->width*image->height;
+		bytes += R_GetImageMipsSize(image->width*image->height);
+		if (image->width*image->height > image->asset_width*image->asset_height)
+		{
+			scaled += R_GetImageMipsSize(image->width*image->height) -
+				R_GetImageMipsSize(image->asset_width*image->asset_height);
+		}
 		switch (image->type)
 		{
 		case it_skin:
@@ -80,6 +89,8 @@ R_ImageList_f (void)
 			image->width, image->height, in_use);
 	}
 	R_Printf(PRINT_ALL, "Total texel count: %i\n", texels);
+	R_Printf(PRINT_ALL, "Total image memory: %i KB, %i KB spent on upscaling\n",
+		bytes / 1024, scaled / 1024);
 	freeup = R_ImageHasFreeSpace();
 	R_Printf(PRINT_ALL, "Used %d of %d images%s.\n", used, image_max, freeup ? ", has free space" : "");
 }
@@ -243,6 +254,7 @@ R_LoadPic (char *name, byte *pic, int width, int realwidth, int height, int real
 		// code never returns after ERR_FATAL
 		return NULL;
 	}
+	ri.Mem_Account(MEM_IMAGES, full_size);
 
 	image->transparent = false;
 	if (type != it_wall)
@@ -480,6 +492,7 @@ R_LoadM8 (char *name, imagetype_t type)
 	}
 
 	image->pixels[0] = malloc (size);
+	ri.Mem_Account(MEM_IMAGES, R_GetImageMipsSize(image->width*image->height));
 	image->pixels[1] = image->pixels[0] + image->width*image->height;
 	image->pixels[2] = image->pixels[1] + image->width*image->height/4;
 	image->pixels[3] = image->pixels[2] + image->width*image->height/16;
@@ -793,6 +806,7 @@ R_FreeUnusedImages (void)
 			continue; // don't free pics
 		// free it
 		free (image->pixels[0]); // the other mip levels just follow
+		ri.Mem_Account(MEM_IMAGES, -(int)R_GetImageMipsSize(image->width*image->height));
 		memset(image, 0, sizeof(*image));
 	}
 }
@@ -943,7 +957,10 @@ R_ShutdownImages (void)
 
 		// free it
 		if (image->pixels[0])
+		{
 			free(image->pixels[0]); // the other mip levels just follow
+			ri.Mem_Account(MEM_IMAGES, -(int)R_GetImageMipsSize(image->width*image->height));
+		}
 
 		memset(image, 0, sizeof(*image));
 	}
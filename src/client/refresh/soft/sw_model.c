@@ -75,11 +75,12 @@ Mod_Modellist_f
 void
 Mod_Modellist_f (void)
 {
-	int		i, total, used;
+	int		i, total, reserved, used;
 	model_t	*mod;
 	qboolean	freeup;
 
 	total = 0;
+	reserved = 0;
 	used = 0;
 
 	R_Printf(PRINT_ALL,"Loaded models:\n");
@@ -95,11 +96,15 @@ Mod_Modellist_f (void)
 
 		if (!mod->name[0])
 			continue;
-		R_Printf(PRINT_ALL, "%8i : %s %s\n",
-			 mod->extradatasize, mod->name, in_use);
+		R_Printf(PRINT_ALL, "%8i %8i : %s %s\n",
+			 mod->extradatasize, mod->extradatareserved, mod->name, in_use);
 		total += mod->extradatasize;
+		reserved += mod->extradatareserved;
 	}
 	R_Printf(PRINT_ALL, "Total resident: %i\n", total);
+	// the hunk reservation is the peak while loading, the
+	// difference is what the loaders overestimated
+	R_Printf(PRINT_ALL, "Total reserved: %i, %i unused\n", reserved, reserved - total);
 	// update statistics
 	freeup = Mod_HasFreeSpace();
 	R_Printf(PRINT_ALL, "Used %d of %d models%s.\n", used, mod_max, freeup ? ", has free space" : "");
@@ -217,6 +222,7 @@ Mod_ForName (char *name, model_t *parent_model, qboolean crash)
 	}
 
 	mod->extradatasize = Hunk_End();
+	ri.Mem_Account(MEM_HUNK, mod->extradatasize);
 
 	ri.FS_FreeFile(buf);
 
@@ -1024,6 +1030,7 @@ Mod_LoadBrushModel(model_t *mod, void *buffer, int modfilelen)
 	hunkSize += 1048576; // 1MB extra just in case
 
 	mod->extradata = Hunk_Begin(hunkSize);
+	mod->extradatareserved = hunkSize;
 
 	mod->type = mod_brush;
 
@@ -1088,6 +1095,7 @@ Mod_LoadAliasModel(model_t *mod, void *buffer, int modfilelen)
 	}
 
 	mod->extradata = Hunk_Begin(modfilelen);
+	mod->extradatareserved = modfilelen;
 	pheader = Hunk_Alloc(ofs_end);
 
 	// byte swap the header fields and sanity check
@@ -1233,6 +1241,7 @@ Mod_LoadSpriteModel(model_t *mod, void *buffer, int modfilelen)
 
 	sprin = (dsprite_t *)buffer;
 	mod->extradata = Hunk_Begin(modfilelen);
+	mod->extradatareserved = modfilelen;
 	sprout = Hunk_Alloc(modfilelen);
 
 	sprout->ident = LittleLong (sprin->ident);
@@ -1384,6 +1393,7 @@ void
 Mod_Free (model_t *mod)
 {
 	Hunk_Free (mod->extradata);
+	ri.Mem_Account(MEM_HUNK, -mod->extradatasize);
 	memset (mod, 0, sizeof(*mod));
 }
 
@@ -491,12 +491,7 @@ RE_Shutdown (void)
 		d_pzbuffer = NULL;
 	}
 	// free surface cache
-	if (sc_base)
-	{
-		D_FlushCaches ();
-		free (sc_base);
-		sc_base = NULL;
-	}
+	D_FreeCaches ();
 
 	// free colormap
 	if (vid_colormap)
@@ -1421,12 +1416,7 @@ R_InitGraphics( int width, int height )
 	}
 
 	// free surface cache
-	if (sc_base)
-	{
-		D_FlushCaches();
-		free(sc_base);
-		sc_base = NULL;
-	}
+	D_FreeCaches();
 
 	d_pzbuffer = malloc(width * height * sizeof(zvalue_t));
 
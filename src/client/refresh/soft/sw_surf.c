@@ -318,6 +318,7 @@ R_InitCaches (void)
 		// code never returns after ERR_FATAL
 		return;
 	}
+	ri.Mem_Account(MEM_SURFCACHE, sc_size);
 	sc_rover = sc_base;
 
 	sc_base->next = NULL;
@@ -351,6 +352,23 @@ D_FlushCaches (void)
 	sc_base->size = sc_size;
 }
 
+/*
+==================
+D_FreeCaches
+==================
+*/
+void
+D_FreeCaches (void)
+{
+	if (!sc_base)
+		return;
+
+	D_FlushCaches ();
+	free (sc_base);
+	ri.Mem_Account(MEM_SURFCACHE, -sc_size);
+	sc_base = NULL;
+}
+
 /*
 =================
 D_SCAlloc
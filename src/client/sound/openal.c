@@ -197,7 +197,7 @@ AL_UploadSfx(sfx_t *s, wavinfo_t *s_info, byte *data, short volume,
 	}
 
 	/* allocate placeholder sfxcache */
-	sc = s->cache = Z_TagMalloc(sizeof(*sc), 0);
+	sc = s->cache = Z_TagMalloc(sizeof(*sc), Z_TAG_SOUND);
 	sc->length = s_info->samples * 1000 / s_info->rate;
 	sc->loopstart = s_info->loopstart;
 	sc->width = s_info->width;
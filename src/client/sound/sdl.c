@@ -931,7 +931,7 @@ SDL_Cache(sfx_t *sfx, wavinfo_t *info, byte *data, short volume,
 	}
 
 	len = len * info->width * info->channels;
-	sc = sfx->cache = Z_Malloc(len + sizeof(sfxcache_t));
+	sc = sfx->cache = Z_TagMalloc(len + sizeof(sfxcache_t), Z_TAG_SOUND);
 
 	if (!sc)
 	{
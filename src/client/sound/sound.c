@@ -73,6 +73,7 @@ cvar_t* s_underwater;
 cvar_t* s_underwater_gain_hf;
 cvar_t* s_doppler;
 cvar_t* s_ps_sorting;
+static cvar_t *s_game;
 
 channel_t channels[MAX_CHANNELS];
 static int num_sfx;
@@ -1177,12 +1178,10 @@ S_StartSound(vec3_t origin, int entnum, int entchannel, sfx_t *sfx,
 		}
 	}
 
-	cvar_t *game = Cvar_Get("game",  "", CVAR_LATCH | CVAR_SERVERINFO);
-
 	const qboolean is_mission_pack =
-		(strcmp(game->string, "") == 0) ||
-		(strcmp(game->string, "rogue") == 0) ||
-		(strcmp(game->string, "xatrix") == 0);
+		(strcmp(s_game->string, "") == 0) ||
+		(strcmp(s_game->string, "rogue") == 0) ||
+		(strcmp(s_game->string, "xatrix") == 0);
 
 	if ((s_ps_sorting->value == 1 && is_mission_pack) ||
 			s_ps_sorting->value == 2 ||
@@ -1552,6 +1551,7 @@ S_Init(void)
 	s_underwater_gain_hf = Cvar_Get("s_underwater_gain_hf", "0.25", CVAR_ARCHIVE);
 	s_doppler = Cvar_Get("s_doppler", "0", CVAR_ARCHIVE);
 	s_ps_sorting = Cvar_Get("s_ps_sorting", "1", CVAR_ARCHIVE);
+	s_game = Cvar_Get("game", "", CVAR_LATCH | CVAR_SERVERINFO);
 
 	Cmd_AddCommand("play", S_Play);
 	Cmd_AddCommand("stopsound", S_StopAllSounds);
@@ -125,7 +125,7 @@ typedef enum {
 } ref_restart_t;
 
 // FIXME: bump API_VERSION?
-#define	API_VERSION		5
+#define	API_VERSION		6
 #define EXPORT
 #define IMPORT
 
@@ -243,6 +243,9 @@ typedef struct
 	qboolean	(IMPORT *GLimp_GetDesktopMode)(int *pwidth, int *pheight);
 
 	void		(IMPORT *Vid_RequestRestart)(ref_restart_t rs);
+
+	// reports allocations (and frees as negative sizes) to "memstats"
+	void		(IMPORT *Mem_Account)(memsubsystem_t subsystem, int bytes);
 } refimport_t;
 
 // this is the only function actually exported at the linker level
@@ -440,6 +440,7 @@ VID_LoadRenderer(void)
 	ri.FS_LoadFile = FS_LoadFile;
 	ri.GLimp_InitGraphics = GLimp_InitGraphics;
 	ri.GLimp_GetDesktopMode = GLimp_GetDesktopMode;
+	ri.Mem_Account = Mem_Account;
 	ri.Sys_Error = Com_Error;
 	ri.Vid_GetModeInfo = VID_GetModeInfo;
 	ri.Vid_MenuInit = VID_MenuInit;
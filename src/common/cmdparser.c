@@ -32,19 +32,23 @@
 
 #define MAX_ALIAS_NAME 32
 #define ALIAS_LOOP_COUNT 16
+#define CMD_HASH_SIZE 256 /* must be a power of two */
 
 typedef struct cmd_function_s
 {
 	struct cmd_function_s *next;
+	struct cmd_function_s *hashNext;
 	char *name;
 	xcommand_t function;
 } cmd_function_t;
 
 static cmd_function_t *cmd_functions; /* possible commands to execute */
+static cmd_function_t *cmd_hash[CMD_HASH_SIZE];
 
 typedef struct cmdalias_s
 {
 	struct cmdalias_s *next;
+	struct cmdalias_s *hashNext;
 	char name[MAX_ALIAS_NAME];
 	char *value;
 } cmdalias_t;
@@ -52,6 +56,12 @@ typedef struct cmdalias_s
 char retval[256];
 int alias_count; /* for detecting runaway loops */
 cmdalias_t *cmd_alias;
+static cmdalias_t *alias_hash[CMD_HASH_SIZE];
+
+/* Sorted names of all commands, aliases and cvars for completion. */
+static char **cmd_completion;
+static int cmd_numCompletion;
+static qboolean cmd_completionValid;
 int cmd_wait;
 static int cmd_argc;
 static int cmd_argc;
@@ -461,7 +471,7 @@ Cmd_Alias_f(void)
 	}
 
 	/* if the alias already exists, reuse it */
-	for (a = cmd_alias; a; a = a->next)
+	for (a = alias_hash[Q_strhash(s, CMD_HASH_SIZE)]; a; a = a->hashNext)
 	{
 		if (!strcmp(s, a->name))
 		{
@@ -472,12 +482,17 @@ Cmd_Alias_f(void)
 
 	if (!a)
 	{
+		unsigned hash = Q_strhash(s, CMD_HASH_SIZE);
+
 		a = Z_Malloc(sizeof(cmdalias_t));
 		a->next = cmd_alias;
 		cmd_alias = a;
-	}
+		a->hashNext = alias_hash[hash];
+		alias_hash[hash] = a;
 
-	strcpy(a->name, s);
+		strcpy(a->name, s);
+		Cmd_InvalidateCompletion();
+	}
 
 	/* copy the rest of the command line */
 	cmd[0] = 0; /* start out with a null string */
@@ -704,6 +719,7 @@ Cmd_AddCommand(char *cmd_name, xcommand_t function)
 {
 	cmd_function_t *cmd;
 	cmd_function_t **pos;
+	unsigned hash;
 
 	/* fail if the command is a variable name */
 	if (Cvar_VariableString(cmd_name)[0])
@@ -712,19 +728,22 @@ Cmd_AddCommand(char *cmd_name, xcommand_t function)
 	}
 
 	/* fail if the command already exists */
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
+	if (Cmd_Exists(cmd_name))
 	{
-		if (!strcmp(cmd_name, cmd->name))
-		{
-			Com_Printf("Cmd_AddCommand: %s already defined\n", cmd_name);
-			return;
-		}
+		Com_Printf("Cmd_AddCommand: %s already defined\n", cmd_name);
+		return;
 	}
 
 	cmd = Z_Malloc(sizeof(cmd_function_t));
 	cmd->name = cmd_name;
 	cmd->function = function;
 
+	hash = Q_strhash(cmd_name, CMD_HASH_SIZE);
+	cmd->hashNext = cmd_hash[hash];
+	cmd_hash[hash] = cmd;
+
+	Cmd_InvalidateCompletion();
+
 	/* link the command in */
 	pos = &cmd_functions;
 	while (*pos && strcmp((*pos)->name, cmd->name) < 0)
@@ -755,7 +774,16 @@ Cmd_RemoveCommand(char *cmd_name)
 		if (!strcmp(cmd_name, cmd->name))
 		{
 			*back = cmd->next;
+
+			for (back = &cmd_hash[Q_strhash(cmd_name, CMD_HASH_SIZE)];
+				 *back != cmd; back = &(*back)->hashNext)
+			{
+			}
+
+			*back = cmd->hashNext;
+
 			Z_Free(cmd);
+			Cmd_InvalidateCompletion();
 			return;
 		}
 
@@ -768,7 +796,7 @@ Cmd_Exists(char *cmd_name)
 {
 	cmd_function_t *cmd;
 
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
+	for (cmd = cmd_hash[Q_strhash(cmd_name, CMD_HASH_SIZE)]; cmd; cmd = cmd->hashNext)
 	{
 		if (!strcmp(cmd_name, cmd->name))
 		{
@@ -779,93 +807,144 @@ Cmd_Exists(char *cmd_name)
 	return false;
 }
 
-char *
-Cmd_CompleteCommand(char *partial)
+/*
+ * Must be called whenever a command, an alias or a
+ * cvar is added or removed. The index is rebuilt by
+ * the next completion.
+ */
+void
+Cmd_InvalidateCompletion(void)
+{
+	cmd_completionValid = false;
+}
+
+static void
+Cmd_BuildCompletion(void)
 {
 	cmd_function_t *cmd;
-	int len, i, o, p;
 	cmdalias_t *a;
 	cvar_t *cvar;
-	char *pmatch[1024];
-	qboolean diff = false;
+	int count;
 
-	len = strlen(partial);
+	count = 0;
 
-	if (!len)
+	for (cmd = cmd_functions; cmd; cmd = cmd->next)
 	{
-		return NULL;
+		count++;
 	}
 
-	/* check for exact match */
+	for (a = cmd_alias; a; a = a->next)
+	{
+		count++;
+	}
+
+	for (cvar = cvar_vars; cvar; cvar = cvar->next)
+	{
+		count++;
+	}
+
+	if (cmd_completion)
+	{
+		Z_Free(cmd_completion);
+	}
+
+	cmd_completion = Z_Malloc((count + 1) * sizeof(char *));
+	cmd_numCompletion = 0;
+
 	for (cmd = cmd_functions; cmd; cmd = cmd->next)
 	{
-		if (!strcmp(partial, cmd->name))
-		{
-			return cmd->name;
-		}
+		cmd_completion[cmd_numCompletion++] = cmd->name;
 	}
 
 	for (a = cmd_alias; a; a = a->next)
 	{
-		if (!strcmp(partial, a->name))
-		{
-			return a->name;
-		}
+		cmd_completion[cmd_numCompletion++] = a->name;
 	}
 
 	for (cvar = cvar_vars; cvar; cvar = cvar->next)
 	{
-		if (!strcmp(partial, cvar->name))
-		{
-			return cvar->name;
-		}
+		cmd_completion[cmd_numCompletion++] = cvar->name;
 	}
 
-	for (i = 0; i < 1024; i++)
+	qsort(cmd_completion, cmd_numCompletion, sizeof(char *), Q_sort_strcomp);
+
+	cmd_completionValid = true;
+}
+
+/*
+ * Returns the index of the first name not sorting before partial.
+ */
+static int
+Cmd_FindCompletion(const char *partial)
+{
+	int low, high, mid;
+
+	if (!cmd_completionValid)
 	{
-		pmatch[i] = NULL;
+		Cmd_BuildCompletion();
 	}
 
-	i = 0;
+	low = 0;
+	high = cmd_numCompletion;
 
-	/* check for partial match */
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
+	while (low < high)
 	{
-		if (!strncmp(partial, cmd->name, len))
+		mid = (low + high) / 2;
+
+		if (strcmp(cmd_completion[mid], partial) < 0)
 		{
-			pmatch[i] = cmd->name;
-			i++;
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
 		}
 	}
 
-	for (a = cmd_alias; a; a = a->next)
+	return low;
+}
+
+char *
+Cmd_CompleteCommand(char *partial)
+{
+	int len, first, i, o, p;
+	qboolean diff = false;
+
+	len = strlen(partial);
+
+	if (!len)
 	{
-		if (!strncmp(partial, a->name, len))
-		{
-			pmatch[i] = a->name;
-			i++;
-		}
+		return NULL;
 	}
 
-	for (cvar = cvar_vars; cvar; cvar = cvar->next)
+	first = Cmd_FindCompletion(partial);
+
+	/* check for exact match */
+	if ((first < cmd_numCompletion) && !strcmp(partial, cmd_completion[first]))
+	{
+		return cmd_completion[first];
+	}
+
+	/* check for partial match, they're all in a row */
+	for (i = first; i < cmd_numCompletion; i++)
 	{
-		if (!strncmp(partial, cvar->name, len))
+		if (strncmp(partial, cmd_completion[i], len))
 		{
-			pmatch[i] = cvar->name;
-			i++;
+			break;
 		}
 	}
 
+	i -= first;
+
 	if (i)
 	{
+		char **pmatch = &cmd_completion[first];
+
 		if (i == 1)
 		{
 			return pmatch[0];
 		}
 
-		/* Sort it */
-		qsort(pmatch, i, sizeof(pmatch[0]), Q_sort_strcomp);
-
 		Com_Printf("\n\n");
 
 		for (o = 0; o < i; o++)
@@ -989,36 +1068,12 @@ Cmd_CompleteMapCommand(char *partial)
 qboolean
 Cmd_IsComplete(char *command)
 {
-	cmd_function_t *cmd;
-	cmdalias_t *a;
-	cvar_t *cvar;
+	int first;
 
 	/* check for exact match */
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
-	{
-		if (!strcmp(command, cmd->name))
-		{
-			return true;
-		}
-	}
-
-	for (a = cmd_alias; a; a = a->next)
-	{
-		if (!strcmp(command, a->name))
-		{
-			return true;
-		}
-	}
+	first = Cmd_FindCompletion(command);
 
-	for (cvar = cvar_vars; cvar; cvar = cvar->next)
-	{
-		if (!strcmp(command, cvar->name))
-		{
-			return true;
-		}
-	}
-
-	return false;
+	return (first < cmd_numCompletion) && !strcmp(command, cmd_completion[first]);
 }
 
 /* ugly hack to suppress warnings from default.cfg in Key_Bind_f() */
@@ -1032,6 +1087,7 @@ Cmd_ExecuteString(char *text)
 {
 	cmd_function_t *cmd;
 	cmdalias_t *a;
+	unsigned hash;
 
 	Cmd_TokenizeString(text, true);
 
@@ -1047,8 +1103,10 @@ Cmd_ExecuteString(char *text)
 		doneWithDefaultCfg = true;
 	}
 
+	hash = Q_strhash(cmd_argv[0], CMD_HASH_SIZE);
+
 	/* check functions */
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
+	for (cmd = cmd_hash[hash]; cmd; cmd = cmd->hashNext)
 	{
 		if (!Q_strcasecmp(cmd_argv[0], cmd->name))
 		{
@@ -1067,7 +1125,7 @@ Cmd_ExecuteString(char *text)
 	}
 
 	/* check alias */
-	for (a = cmd_alias; a; a = a->next)
+	for (a = alias_hash[hash]; a; a = a->hashNext)
 	{
 		if (!Q_strcasecmp(cmd_argv[0], a->name))
 		{
@@ -1134,4 +1192,7 @@ Cmd_Shutdown(void)
 		Z_Free(cmd_alias);
 		cmd_alias = next;
 	}
+
+	memset(alias_hash, 0, sizeof(alias_hash));
+	Cmd_InvalidateCompletion();
 }
@@ -29,6 +29,20 @@
 
 #include "header/common.h"
 
+/* every trace context gets its own box hull,
+   so CM_HeadnodeForBox() can be used from
+   several threads at once */
+#define MAX_TRACE_CONTEXTS 16
+
+/* GCCs generic vectors become SSE, AltiVec or NEON
+   code, or plain scalar code on anything else */
+#if defined(__GNUC__) && !defined(CM_NO_SIMD)
+#define CM_SIMD
+
+typedef float cmvec4_t __attribute__((vector_size(16)));
+typedef int cmint4_t __attribute__((vector_size(16)));
+#endif
+
 typedef struct
 {
 	cplane_t	*plane;
@@ -55,7 +69,7 @@ typedef struct
 	int			contents;
 	int			numsides;
 	int			firstbrushside;
-	int			checkcount;	/* to avoid repeated testings */
+	vec3_t		mins, maxs; /* from the axial sides */
 } cbrush_t;
 
 typedef struct
@@ -66,34 +80,170 @@ typedef struct
 	int		floodvalid;
 } carea_t;
 
+/*
+ * Everything a single trace needs while it walks the
+ * tree. Each thread tracing concurrently owns one of
+ * these, the brush stamps replace the shared visit
+ * counter that used to live in cbrush_t.
+ */
+struct cmtrace_s
+{
+	trace_t		trace;
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	vec3_t		extents;
+	vec3_t		absmins, absmaxs; /* swept box */
+	int			contents;
+	qboolean	ispoint; /* optimized case */
+	int			checkcount;
+	int			*brushstamps; /* to avoid repeated testings */
+	int			numbrushstamps;
+	int			boxhull; /* index into the box hulls */
+};
+
+typedef struct
+{
+	float		*mins, *maxs;
+	int			*list;
+	int			count, maxcount;
+	int			topnode;
+} cleaflist_t;
+
+/* what the sides of a brush say about a move */
+typedef struct
+{
+	float		enterfrac, leavefrac;
+	cplane_t	*clipplane;
+	cbrushside_t	*leadside;
+	qboolean	getout, startout;
+} cbrushclip_t;
+
+/* The part of space a node or leaf covers, as its bounds
+   and the planes above it not already implied by them */
+typedef struct
+{
+	vec3_t		mins, maxs;
+	int			parent; /* -1 for the root */
+	int			firstplane; /* into map_regionplanes, -1 for none */
+	int			numplanes;
+} cregion_t;
+
+/* remembered point lookups */
+typedef struct
+{
+	vec3_t		p;
+	int			leafnum;
+	int			frame;
+} cpointmemo_t;
+
+#define POINT_MEMO_SIZE 1024
+
+/* a decompressed vis row in the LRU cache */
+typedef struct
+{
+	int			key; /* cluster * 2 + DVIS_PVS / DVIS_PHS, -1 if free */
+	int			lastused;
+	int			frame; /* rows handed out this frame stay */
+	byte		*bits;
+} cvisrow_t;
+
+#ifdef CM_SIMD
+/*
+ * The sides of each brush in groups of four, split into
+ * components so four planes can be tested at once. The
+ * last group is padded with copies of the last side,
+ * which can't change the result.
+ */
+typedef struct
+{
+	cmvec4_t	normal[3];
+	cmvec4_t	dist;
+} cplane4_t;
+#endif
+
 byte *cmod_base;
-byte map_visibility[MAX_MAP_VISIBILITY];
+byte *map_visibility;
 // DG: is casted to int32_t* in SV_FatPVS() so align accordingly
 static YQ2_ALIGNAS_TYPE(int32_t) byte pvsrow[MAX_MAP_LEAFS / 8];
 byte phsrow[MAX_MAP_LEAFS / 8];
-carea_t	map_areas[MAX_MAP_AREAS];
-cbrush_t map_brushes[MAX_MAP_BRUSHES];
-cbrushside_t map_brushsides[MAX_MAP_BRUSHSIDES];
+
+/* Decompressed vis. If all rows fit into cm_viscache
+   they're expanded at load time, otherwise the most
+   recently used ones are kept. */
+cvar_t *cm_viscache;
+static void *map_visrows_mem;
+static byte *map_visrows; /* all rows, NULL if not expanded */
+static int map_visrowsize;
+static cvisrow_t *map_visslots;
+static int *map_visslotindex; /* key -> slot or -1 */
+static int map_numvisslots;
+static int map_visused, map_visframe;
+
+static void CM_InitVisCache(void);
+static void CM_FreeVisCache(void);
+static qboolean CM_VisFitsCache(void);
+
+/* Precomputed data of the current map is read from a cache
+   file into this block. Everything is native endian. */
+#define CMCACHE_IDENT (('M' << 24) + ('C' << 16) + ('2' << 8) + 'Q')
+#define CMCACHE_VERSION 1
+#define CMCACHE_BYTEORDER 0x01020304
+
+typedef struct
+{
+	int			ident;
+	int			version;
+	int			byteorder;
+	unsigned	checksum; /* of the bsp */
+	int			numbrushes;
+	int			numplanegroups; /* cplane4_t, 0 without CM_SIMD */
+	int			numregions;
+	int			numregionplanes;
+	int			numclusters;
+	int			visrowsize; /* 0 if the rows aren't expanded */
+	int			planegroupsize;
+	int			regionsize;
+} cmcacheheader_t;
+
+cvar_t *cm_cache;
+static void *map_cachemem;
+
+static qboolean CM_ReadCollisionCache(const char *name, unsigned checksum);
+static void CM_WriteCollisionCache(const char *name, unsigned checksum);
+static void CM_FreeCollisionCache(void);
+
+/* Regions of all nodes followed by all leafs, for checking
+   whether a point is still in the same leaf. */
+static cregion_t *map_regions;
+static int *map_regionplanes; /* plane number * 2 + side */
+static cpointmemo_t map_pointmemo[POINT_MEMO_SIZE];
+static int map_pointframe;
+static int c_leafhint_hits, c_leafhint_parenthits, c_leafhint_misses;
+static int c_boxhint_hits, c_boxhint_parenthits, c_boxhint_misses;
+static int c_pointmemo_hits, c_pointmemo_misses;
+/* The arrays of the current map, all in map_block and
+   sized from the lumps. The box hulls follow the nodes,
+   planes, leafs, leaf brushes, brushes and brush sides
+   of the map. */
+static void *map_block;
+carea_t	*map_areas;
+cbrush_t *map_brushes;
+cbrushside_t *map_brushsides;
 char map_name[MAX_QPATH];
-char map_entitystring[MAX_MAP_ENTSTRING];
+char *map_entitystring;
 cbrush_t *box_brush;
 cleaf_t	*box_leaf;
-cleaf_t	map_leafs[MAX_MAP_LEAFS];
-cmodel_t map_cmodels[MAX_MAP_MODELS];
-cnode_t	map_nodes[MAX_MAP_NODES+6]; /* extra for box hull */
+cleaf_t	*map_leafs;
+cmodel_t *map_cmodels;
+cnode_t	*map_nodes;
 cplane_t *box_planes;
-cplane_t map_planes[MAX_MAP_PLANES+6]; /* extra for box hull */
+cplane_t *map_planes;
 cvar_t *map_noareas;
-dareaportal_t map_areaportals[MAX_MAP_AREAPORTALS];
-dvis_t *map_vis = (dvis_t *)map_visibility;
+dareaportal_t *map_areaportals;
+dvis_t *map_vis;
 int box_headnode;
-int	checkcount;
 int	emptyleaf, solidleaf;
 int	floodvalid;
-float *leaf_mins, *leaf_maxs;
-int leaf_count, leaf_maxcount;
-int *leaf_list;
-int leaf_topnode;
 int	numareaportals;
 int numareas = 1;
 int	numbrushes;
@@ -107,20 +257,28 @@ int	numnodes;
 int	numplanes;
 int	numtexinfo;
 int	numvisibility;
-int trace_contents;
-mapsurface_t map_surfaces[MAX_MAP_TEXINFO];
+mapsurface_t *map_surfaces;
 mapsurface_t nullsurface;
 qboolean portalopen[MAX_MAP_AREAPORTALS];
-qboolean trace_ispoint; /* optimized case */
-trace_t trace_trace;
-unsigned short	map_leafbrushes[MAX_MAP_LEAFBRUSHES];
-vec3_t trace_start, trace_end;
-vec3_t trace_mins, trace_maxs;
-vec3_t trace_extents;
+unsigned short	*map_leafbrushes;
+
+#ifdef CM_SIMD
+cvar_t *cm_simd;
+static cplane4_t *map_brushplanes4;
+static void *map_brushplanes4_mem;
+static int *map_brushfirst4;
+#endif
+
+/* used by CM_BoxTrace() and friends, main thread only */
+static cmtrace_t cm_trace;
+static cmtrace_t *cm_tracecontexts[MAX_TRACE_CONTEXTS] = {&cm_trace};
 
 #ifndef DEDICATED_ONLY
+/* statistics only, may be off by a few
+   when traces run on several threads */
 int		c_pointcontents;
 int		c_traces, c_brush_traces;
+int		c_brush_rejects; /* brushes skipped by the bounds check */
 #endif
 
 /* 1/32 epsilon to keep floating point happy */
@@ -315,100 +473,133 @@ CM_HeadnodeVisible(int nodenum, byte *visbits)
 /*
  * Set up the planes and nodes so that the six floats of a bounding box
  * can just be stored out and get a proper clipping hull structure.
+ * One hull is built for each possible trace context, they follow
+ * each other behind the map data.
  */
 void
 CM_InitBoxHull(void)
 {
-	int i;
+	int i, h;
 	int side;
 	cnode_t *c;
-	cplane_t *p;
+	cplane_t *p, *planes;
 	cbrushside_t *s;
+	cbrush_t *brush;
+	cleaf_t *leaf;
+	int headnode, brushnum, firstside, firstleafbrush;
 
 	box_headnode = numnodes;
 	box_planes = &map_planes[numplanes];
+	box_brush = &map_brushes[numbrushes];
+	box_leaf = &map_leafs[numleafs];
 
-	if ((numnodes + 6 > MAX_MAP_NODES) ||
-		(numbrushes + 1 > MAX_MAP_BRUSHES) ||
-		(numleafbrushes + 1 > MAX_MAP_LEAFBRUSHES) ||
-		(numbrushsides + 6 > MAX_MAP_BRUSHSIDES) ||
-		(numplanes + 12 > MAX_MAP_PLANES))
+	/* leaf brushes are stored as 16 bit */
+	if ((numbrushes + MAX_TRACE_CONTEXTS > 65536) ||
+		(numleafbrushes + MAX_TRACE_CONTEXTS > 65536))
 	{
 		Com_Error(ERR_DROP, "Not enough room for box tree");
 	}
 
-	box_brush = &map_brushes[numbrushes];
-	box_brush->numsides = 6;
-	box_brush->firstbrushside = numbrushsides;
-	box_brush->contents = CONTENTS_MONSTER;
+	for (h = 0; h < MAX_TRACE_CONTEXTS; h++)
+	{
+		headnode = box_headnode + h * 6;
+		planes = &box_planes[h * 12];
+		brushnum = numbrushes + h;
+		firstside = numbrushsides + h * 6;
+		firstleafbrush = numleafbrushes + h;
 
-	box_leaf = &map_leafs[numleafs];
-	box_leaf->contents = CONTENTS_MONSTER;
-	box_leaf->firstleafbrush = numleafbrushes;
-	box_leaf->numleafbrushes = 1;
+		brush = &map_brushes[brushnum];
+		brush->numsides = 6;
+		brush->firstbrushside = firstside;
+		brush->contents = CONTENTS_MONSTER;
 
-	map_leafbrushes[numleafbrushes] = numbrushes;
+		leaf = &map_leafs[numleafs + h];
+		leaf->contents = CONTENTS_MONSTER;
+		leaf->firstleafbrush = firstleafbrush;
+		leaf->numleafbrushes = 1;
 
-	for (i = 0; i < 6; i++)
-	{
-		side = i & 1;
+		map_leafbrushes[firstleafbrush] = brushnum;
 
-		/* brush sides */
-		s = &map_brushsides[numbrushsides + i];
-		s->plane = map_planes + (numplanes + i * 2 + side);
-		s->surface = &nullsurface;
+		for (i = 0; i < 6; i++)
+		{
+			side = i & 1;
 
-		/* nodes */
-		c = &map_nodes[box_headnode + i];
-		c->plane = map_planes + (numplanes + i * 2);
-		c->children[side] = -1 - emptyleaf;
+			/* brush sides */
+			s = &map_brushsides[firstside + i];
+			s->plane = planes + (i * 2 + side);
+			s->surface = &nullsurface;
 
-		if (i != 5)
-		{
-			c->children[side ^ 1] = box_headnode + i + 1;
-		}
+			/* nodes */
+			c = &map_nodes[headnode + i];
+			c->plane = planes + (i * 2);
+			c->children[side] = -1 - emptyleaf;
 
-		else
-		{
-			c->children[side ^ 1] = -1 - numleafs;
-		}
+			if (i != 5)
+			{
+				c->children[side ^ 1] = headnode + i + 1;
+			}
 
-		/* planes */
-		p = &box_planes[i * 2];
-		p->type = i >> 1;
-		p->signbits = 0;
-		VectorClear(p->normal);
-		p->normal[i >> 1] = 1;
+			else
+			{
+				c->children[side ^ 1] = -1 - (numleafs + h);
+			}
 
-		p = &box_planes[i * 2 + 1];
-		p->type = 3 + (i >> 1);
-		p->signbits = 0;
-		VectorClear(p->normal);
-		p->normal[i >> 1] = -1;
+			/* planes */
+			p = &planes[i * 2];
+			p->type = i >> 1;
+			p->signbits = 0;
+			VectorClear(p->normal);
+			p->normal[i >> 1] = 1;
+
+			p = &planes[i * 2 + 1];
+			p->type = 3 + (i >> 1);
+			p->signbits = 0;
+			VectorClear(p->normal);
+			p->normal[i >> 1] = -1;
+		}
 	}
 }
 
 /*
  * To keep everything totally uniform, bounding boxes are turned into
- * small BSP trees instead of being compared directly.
+ * small BSP trees instead of being compared directly. The hull
+ * belongs to the context and stays valid until its next call.
  */
 int
-CM_HeadnodeForBox(vec3_t mins, vec3_t maxs)
+CM_HeadnodeForBoxContext(cmtrace_t *tc, vec3_t mins, vec3_t maxs)
 {
-	box_planes[0].dist = maxs[0];
-	box_planes[1].dist = -maxs[0];
-	box_planes[2].dist = mins[0];
-	box_planes[3].dist = -mins[0];
-	box_planes[4].dist = maxs[1];
-	box_planes[5].dist = -maxs[1];
-	box_planes[6].dist = mins[1];
-	box_planes[7].dist = -mins[1];
-	box_planes[8].dist = maxs[2];
-	box_planes[9].dist = -maxs[2];
-	box_planes[10].dist = mins[2];
-	box_planes[11].dist = -mins[2];
+	cplane_t *planes;
+
+	if (!tc)
+	{
+		tc = &cm_trace;
+	}
+
+	planes = &box_planes[tc->boxhull * 12];
+
+	planes[0].dist = maxs[0];
+	planes[1].dist = -maxs[0];
+	planes[2].dist = mins[0];
+	planes[3].dist = -mins[0];
+	planes[4].dist = maxs[1];
+	planes[5].dist = -maxs[1];
+	planes[6].dist = mins[1];
+	planes[7].dist = -mins[1];
+	planes[8].dist = maxs[2];
+	planes[9].dist = -maxs[2];
+	planes[10].dist = mins[2];
+	planes[11].dist = -mins[2];
+
+	VectorCopy(mins, map_brushes[numbrushes + tc->boxhull].mins);
+	VectorCopy(maxs, map_brushes[numbrushes + tc->boxhull].maxs);
+
+	return box_headnode + tc->boxhull * 6;
+}
 
-	return box_headnode;
+int
+CM_HeadnodeForBox(vec3_t mins, vec3_t maxs)
+{
+	return CM_HeadnodeForBoxContext(&cm_trace, mins, maxs);
 }
 
 int
@@ -451,14 +642,135 @@ CM_PointLeafnum_r(vec3_t p, int num)
 	return -1 - num;
 }
 
+static inline int
+CM_PointMemoHash(vec3_t p)
+{
+	unsigned int bits[3];
+
+	memcpy(bits, p, sizeof(bits));
+
+	return ((bits[0] * 73856093) ^ (bits[1] * 19349663) ^
+			(bits[2] * 83492791)) & (POINT_MEMO_SIZE - 1);
+}
+
+/*
+ * Results are remembered until the next CM_NewFrame(),
+ * the game asks for the same points several times a
+ * frame. Only for the main thread.
+ */
 int
 CM_PointLeafnum(vec3_t p)
 {
+	cpointmemo_t *memo;
+
 	if (!numplanes)
 	{
 		return 0; /* sound may call this without map loaded */
 	}
 
+	memo = &map_pointmemo[CM_PointMemoHash(p)];
+
+	if ((memo->frame == map_pointframe) && VectorCompare(memo->p, p))
+	{
+		c_pointmemo_hits++;
+		return memo->leafnum;
+	}
+
+	c_pointmemo_misses++;
+
+	VectorCopy(p, memo->p);
+	memo->frame = map_pointframe;
+	memo->leafnum = CM_PointLeafnum_r(p, 0);
+
+	return memo->leafnum;
+}
+
+/*
+ * Returns true if the point is in the given region. This
+ * is exact: the bounds and the remaining planes together
+ * make sure that the point is on the same side of every
+ * node above as CM_PointLeafnum_r() would decide.
+ */
+static qboolean
+CM_PointInRegion(vec3_t p, cregion_t *region)
+{
+	int i, ref;
+	float d;
+	cplane_t *plane;
+
+	if (region->firstplane < 0)
+	{
+		return false;
+	}
+
+	if ((p[0] < region->mins[0]) || (p[0] > region->maxs[0]) ||
+		(p[1] < region->mins[1]) || (p[1] > region->maxs[1]) ||
+		(p[2] < region->mins[2]) || (p[2] > region->maxs[2]))
+	{
+		return false;
+	}
+
+	for (i = 0; i < region->numplanes; i++)
+	{
+		ref = map_regionplanes[region->firstplane + i];
+		plane = &map_planes[ref >> 1];
+
+		if (plane->type < 3)
+		{
+			d = p[plane->type] - plane->dist;
+		}
+
+		else
+		{
+			d = DotProduct(plane->normal, p) - plane->dist;
+		}
+
+		if ((ref & 1) ? (d >= 0) : (d < 0))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Like CM_PointLeafnum(), but starts with the leaf the
+ * caller found the last time, e.g. for a moving client.
+ * If the point left it, its parent node is tried before
+ * descending from the root.
+ */
+int
+CM_PointLeafnumHint(vec3_t p, int hint)
+{
+	int parent;
+
+	if (!numplanes)
+	{
+		return 0;
+	}
+
+	if (!map_regions || (hint < 0) || (hint >= numleafs))
+	{
+		c_leafhint_misses++;
+		return CM_PointLeafnum_r(p, 0);
+	}
+
+	if (CM_PointInRegion(p, &map_regions[numnodes + hint]))
+	{
+		c_leafhint_hits++;
+		return hint;
+	}
+
+	parent = map_regions[numnodes + hint].parent;
+
+	if ((parent >= 0) && CM_PointInRegion(p, &map_regions[parent]))
+	{
+		c_leafhint_parenthits++;
+		return CM_PointLeafnum_r(p, parent);
+	}
+
+	c_leafhint_misses++;
 	return CM_PointLeafnum_r(p, 0);
 }
 
@@ -466,8 +778,8 @@ CM_PointLeafnum(vec3_t p)
  * Fills in a list of all the leafs touched
  */
 
-void
-CM_BoxLeafnums_r(int nodenum)
+static void
+CM_BoxLeafnums_r(cleaflist_t *ll, int nodenum)
 {
 	cplane_t *plane;
 	cnode_t *node;
@@ -477,18 +789,18 @@ CM_BoxLeafnums_r(int nodenum)
 	{
 		if (nodenum < 0)
 		{
-			if (leaf_count >= leaf_maxcount)
+			if (ll->count >= ll->maxcount)
 			{
 				return;
 			}
 
-			leaf_list[leaf_count++] = -1 - nodenum;
+			ll->list[ll->count++] = -1 - nodenum;
 			return;
 		}
 
 		node = &map_nodes[nodenum];
 		plane = node->plane;
-		s = BOX_ON_PLANE_SIDE(leaf_mins, leaf_maxs, plane);
+		s = BOX_ON_PLANE_SIDE(ll->mins, ll->maxs, plane);
 
 		if (s == 1)
 		{
@@ -503,12 +815,12 @@ CM_BoxLeafnums_r(int nodenum)
 		else
 		{
 			/* go down both */
-			if (leaf_topnode == -1)
+			if (ll->topnode == -1)
 			{
-				leaf_topnode = nodenum;
+				ll->topnode = nodenum;
 			}
 
-			CM_BoxLeafnums_r(node->children[0]);
+			CM_BoxLeafnums_r(ll, node->children[0]);
 			nodenum = node->children[1];
 		}
 	}
@@ -518,22 +830,24 @@ int
 CM_BoxLeafnums_headnode(vec3_t mins, vec3_t maxs, int *list,
 		int listsize, int headnode, int *topnode)
 {
-	leaf_list = list;
-	leaf_count = 0;
-	leaf_maxcount = listsize;
-	leaf_mins = mins;
-	leaf_maxs = maxs;
+	cleaflist_t ll;
+
+	ll.list = list;
+	ll.count = 0;
+	ll.maxcount = listsize;
+	ll.mins = mins;
+	ll.maxs = maxs;
 
-	leaf_topnode = -1;
+	ll.topnode = -1;
 
-	CM_BoxLeafnums_r(headnode);
+	CM_BoxLeafnums_r(&ll, headnode);
 
 	if (topnode)
 	{
-		*topnode = leaf_topnode;
+		*topnode = ll.topnode;
 	}
 
-	return leaf_count;
+	return ll.count;
 }
 
 int
@@ -543,6 +857,90 @@ CM_BoxLeafnums(vec3_t mins, vec3_t maxs, int *list, int listsize, int *topnode)
 			listsize, map_cmodels[0].headnode, topnode);
 }
 
+/*
+ * Returns true if the box is in the given region, i.e. on
+ * the same side of every node above as CM_BoxLeafnums_r()
+ * would decide. The kept planes are tested the same way,
+ * the bounds cover the others with room for rounding.
+ */
+static qboolean
+CM_BoxInRegion(vec3_t mins, vec3_t maxs, cregion_t *region)
+{
+	int i, ref;
+	cplane_t *plane;
+
+	if (region->firstplane < 0)
+	{
+		return false;
+	}
+
+	if ((mins[0] < region->mins[0]) || (maxs[0] > region->maxs[0]) ||
+		(mins[1] < region->mins[1]) || (maxs[1] > region->maxs[1]) ||
+		(mins[2] < region->mins[2]) || (maxs[2] > region->maxs[2]))
+	{
+		return false;
+	}
+
+	for (i = 0; i < region->numplanes; i++)
+	{
+		ref = map_regionplanes[region->firstplane + i];
+		plane = &map_planes[ref >> 1];
+
+		if (BOX_ON_PLANE_SIDE(mins, maxs, plane) != ((ref & 1) ? 2 : 1))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Like CM_BoxLeafnums(), but starts with the node (or the
+ * leaf, as -1 - leafnum) the caller got the last time, e.g.
+ * the topnode of a relinked entity. If the box left it, its
+ * parent node is tried before descending from the root.
+ */
+int
+CM_BoxLeafnumsHint(vec3_t mins, vec3_t maxs, int *list, int listsize,
+		int *topnode, int hint)
+{
+	int headnode;
+	cregion_t *region;
+
+	headnode = map_cmodels[0].headnode;
+
+	if (!map_regions || (hint >= numnodes) || (hint < -numleafs))
+	{
+		c_boxhint_misses++;
+		return CM_BoxLeafnums_headnode(mins, maxs, list,
+				listsize, headnode, topnode);
+	}
+
+	region = &map_regions[(hint < 0) ? numnodes + (-1 - hint) : hint];
+
+	if (CM_BoxInRegion(mins, maxs, region))
+	{
+		c_boxhint_hits++;
+		headnode = hint;
+	}
+
+	else if ((region->parent >= 0) &&
+			 CM_BoxInRegion(mins, maxs, &map_regions[region->parent]))
+	{
+		c_boxhint_parenthits++;
+		headnode = region->parent;
+	}
+
+	else
+	{
+		c_boxhint_misses++;
+	}
+
+	return CM_BoxLeafnums_headnode(mins, maxs, list,
+			listsize, headnode, topnode);
+}
+
 int
 CM_PointContents(vec3_t p, int headnode)
 {
@@ -553,7 +951,15 @@ CM_PointContents(vec3_t p, int headnode)
 		return 0;
 	}
 
-	l = CM_PointLeafnum_r(p, headnode);
+	if (headnode == 0)
+	{
+		l = CM_PointLeafnum(p);
+	}
+
+	else
+	{
+		l = CM_PointLeafnum_r(p, headnode);
+	}
 
 	return map_leafs[l].contents;
 }
@@ -575,7 +981,7 @@ CM_TransformedPointContents(vec3_t p, int headnode,
 	VectorSubtract(p, origin, p_l);
 
 	/* rotate start and end into the models frame of reference */
-	if ((headnode != box_headnode) &&
+	if ((headnode < box_headnode) &&
 		(angles[0] || angles[1] || angles[2]))
 	{
 		AngleVectors(angles, forward, right, up);
@@ -591,43 +997,26 @@ CM_TransformedPointContents(vec3_t p, int headnode,
 	return map_leafs[l].contents;
 }
 
-void
-CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
-		vec3_t p2, trace_t *trace, cbrush_t *brush)
+/*
+ * Returns false if the move can't touch the brush.
+ */
+static qboolean
+CM_ClipBrushSides(cmtrace_t *tc, cbrush_t *brush, cbrushclip_t *clip)
 {
 	int i, j;
-	cplane_t *plane, *clipplane;
+	cplane_t *plane;
 	float dist;
-	float enterfrac, leavefrac;
 	vec3_t ofs;
 	float d1, d2;
-	qboolean getout, startout;
 	float f;
-	cbrushside_t *side, *leadside;
-
-	enterfrac = -1;
-	leavefrac = 1;
-	clipplane = NULL;
-
-	if (!brush->numsides)
-	{
-		return;
-	}
-
-#ifndef DEDICATED_ONLY
-	c_brush_traces++;
-#endif
-
-	getout = false;
-	startout = false;
-	leadside = NULL;
+	cbrushside_t *side;
 
 	for (i = 0; i < brush->numsides; i++)
 	{
 		side = &map_brushsides[brush->firstbrushside + i];
 		plane = side->plane;
 
-		if (!trace_ispoint)
+		if (!tc->ispoint)
 		{
 			/* general box case
 			   push the plane out
@@ -636,12 +1025,12 @@ CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 			{
 				if (plane->normal[j] < 0)
 				{
-					ofs[j] = maxs[j];
+					ofs[j] = tc->maxs[j];
 				}
 
 				else
 				{
-					ofs[j] = mins[j];
+					ofs[j] = tc->mins[j];
 				}
 			}
 
@@ -655,23 +1044,23 @@ CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 			dist = plane->dist;
 		}
 
-		d1 = DotProduct(p1, plane->normal) - dist;
-		d2 = DotProduct(p2, plane->normal) - dist;
+		d1 = DotProduct(tc->start, plane->normal) - dist;
+		d2 = DotProduct(tc->end, plane->normal) - dist;
 
 		if (d2 > 0)
 		{
-			getout = true; /* endpoint is not in solid */
+			clip->getout = true; /* endpoint is not in solid */
 		}
 
 		if (d1 > 0)
 		{
-			startout = true;
+			clip->startout = true;
 		}
 
 		/* if completely in front of face, no intersection */
 		if ((d1 > 0) && (d2 >= d1))
 		{
-			return;
+			return false;
 		}
 
 		if ((d1 <= 0) && (d2 <= 0))
@@ -685,11 +1074,11 @@ CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 			/* enter */
 			f = (d1 - DIST_EPSILON) / (d1 - d2);
 
-			if (f > enterfrac)
+			if (f > clip->enterfrac)
 			{
-				enterfrac = f;
-				clipplane = plane;
-				leadside = side;
+				clip->enterfrac = f;
+				clip->clipplane = plane;
+				clip->leadside = side;
 			}
 		}
 
@@ -698,51 +1087,271 @@ CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 			/* leave */
 			f = (d1 + DIST_EPSILON) / (d1 - d2);
 
-			if (f < leavefrac)
+			if (f < clip->leavefrac)
 			{
-				leavefrac = f;
+				clip->leavefrac = f;
 			}
 		}
 	}
 
-	if (!startout)
+	return true;
+}
+
+#ifdef CM_SIMD
+static inline cmvec4_t
+CM_Select4(cmint4_t mask, cmvec4_t a, cmvec4_t b)
+{
+	return (cmvec4_t)(((cmint4_t)a & mask) | ((cmint4_t)b & ~mask));
+}
+
+static inline qboolean
+CM_Any4(cmint4_t mask)
+{
+	return (mask[0] | mask[1] | mask[2] | mask[3]) != 0;
+}
+
+/*
+ * Same as CM_ClipBrushSides(), but the distances are
+ * calculated for four sides at once. The operations
+ * are done in the same order as in the scalar code,
+ * so the results are bit for bit the same. That needs
+ * -ffp-contract=off, otherwise the compiler may fuse
+ * the multiply-adds of one path and not the other.
+ */
+static qboolean
+CM_ClipBrushSides4(cmtrace_t *tc, cbrush_t *brush, cbrushclip_t *clip)
+{
+	int i, k;
+	const cplane4_t *planes;
+	cmvec4_t zero = {0, 0, 0, 0};
+	cmvec4_t mins[3], maxs[3], p1[3], p2[3];
+	cmvec4_t ofs0, ofs1, ofs2, dist, d1, d2;
+	cmint4_t cross;
+	float f;
+
+	for (k = 0; k < 3; k++)
 	{
-		/* original point was inside brush */
-		trace->startsolid = true;
+		mins[k] = zero + tc->mins[k];
+		maxs[k] = zero + tc->maxs[k];
+		p1[k] = zero + tc->start[k];
+		p2[k] = zero + tc->end[k];
+	}
+
+	planes = &map_brushplanes4[map_brushfirst4[brush - map_brushes]];
 
-		if (!getout)
+	for (i = 0; i < brush->numsides; i += 4, planes++)
+	{
+		if (!tc->ispoint)
 		{
-			trace->allsolid = true;
+			ofs0 = CM_Select4(planes->normal[0] < zero, maxs[0], mins[0]);
+			ofs1 = CM_Select4(planes->normal[1] < zero, maxs[1], mins[1]);
+			ofs2 = CM_Select4(planes->normal[2] < zero, maxs[2], mins[2]);
+
+			dist = ofs0 * planes->normal[0] + ofs1 * planes->normal[1] +
+				ofs2 * planes->normal[2];
+			dist = planes->dist - dist;
 		}
 
-		return;
-	}
+		else
+		{
+			dist = planes->dist;
+		}
 
-	if (enterfrac < leavefrac)
-	{
-		if ((enterfrac > -1) && (enterfrac < trace->fraction))
+		d1 = (p1[0] * planes->normal[0] + p1[1] * planes->normal[1] +
+			p1[2] * planes->normal[2]) - dist;
+		d2 = (p2[0] * planes->normal[0] + p2[1] * planes->normal[1] +
+			p2[2] * planes->normal[2]) - dist;
+
+		if (CM_Any4(d2 > zero))
+		{
+			clip->getout = true;
+		}
+
+		if (CM_Any4(d1 > zero))
+		{
+			clip->startout = true;
+		}
+
+		/* if completely in front of any face, no intersection */
+		if (CM_Any4((d1 > zero) & (d2 >= d1)))
 		{
-			if (enterfrac < 0)
+			return false;
+		}
+
+		/* lanes that cross their face */
+		cross = (d1 > zero) | (d2 > zero);
+
+		if (!CM_Any4(cross))
+		{
+			continue;
+		}
+
+		for (k = 0; (k < 4) && (i + k < brush->numsides); k++)
+		{
+			if (!cross[k])
 			{
-				enterfrac = 0;
+				continue;
 			}
 
-			if (clipplane == NULL)
+			if (d1[k] > d2[k])
 			{
-				Com_Error(ERR_FATAL, "clipplane was NULL!\n");
+				f = (d1[k] - DIST_EPSILON) / (d1[k] - d2[k]);
+
+				if (f > clip->enterfrac)
+				{
+					clip->enterfrac = f;
+					clip->leadside = &map_brushsides[brush->firstbrushside + i + k];
+					clip->clipplane = clip->leadside->plane;
+				}
 			}
 
-			trace->fraction = enterfrac;
-			trace->plane = *clipplane;
-			trace->surface = &(leadside->surface->c);
-			trace->contents = brush->contents;
-		}
-	}
+			else
+			{
+				f = (d1[k] + DIST_EPSILON) / (d1[k] - d2[k]);
+
+				if (f < clip->leavefrac)
+				{
+					clip->leavefrac = f;
+				}
+			}
+		}
+	}
+
+	return true;
 }
 
-void
-CM_TestBoxInBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
-		trace_t *trace, cbrush_t *brush)
+/*
+ * Same as the plane loop in CM_TestBoxInBrush().
+ */
+static qboolean
+CM_TestBrushSides4(cmtrace_t *tc, cbrush_t *brush)
+{
+	int i, k;
+	const cplane4_t *planes;
+	cmvec4_t zero = {0, 0, 0, 0};
+	cmvec4_t mins[3], maxs[3], p1[3];
+	cmvec4_t ofs0, ofs1, ofs2, dist, d1;
+
+	for (k = 0; k < 3; k++)
+	{
+		mins[k] = zero + tc->mins[k];
+		maxs[k] = zero + tc->maxs[k];
+		p1[k] = zero + tc->start[k];
+	}
+
+	planes = &map_brushplanes4[map_brushfirst4[brush - map_brushes]];
+
+	for (i = 0; i < brush->numsides; i += 4, planes++)
+	{
+		ofs0 = CM_Select4(planes->normal[0] < zero, maxs[0], mins[0]);
+		ofs1 = CM_Select4(planes->normal[1] < zero, maxs[1], mins[1]);
+		ofs2 = CM_Select4(planes->normal[2] < zero, maxs[2], mins[2]);
+
+		dist = ofs0 * planes->normal[0] + ofs1 * planes->normal[1] +
+			ofs2 * planes->normal[2];
+		dist = planes->dist - dist;
+
+		d1 = (p1[0] * planes->normal[0] + p1[1] * planes->normal[1] +
+			p1[2] * planes->normal[2]) - dist;
+
+		/* if completely in front of face, no intersection */
+		if (CM_Any4(d1 > zero))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Box hull brushes change with every trace,
+ * so they're always clipped the scalar way.
+ */
+static inline qboolean
+CM_UseSimd(cbrush_t *brush)
+{
+	return map_brushplanes4 && (brush - map_brushes < numbrushes) &&
+		cm_simd->value;
+}
+#endif
+
+static void
+CM_ClipBoxToBrush(cmtrace_t *tc, cbrush_t *brush)
+{
+	cbrushclip_t clip;
+	qboolean touched;
+	trace_t *trace = &tc->trace;
+
+	if (!brush->numsides)
+	{
+		return;
+	}
+
+#ifndef DEDICATED_ONLY
+	c_brush_traces++;
+#endif
+
+	clip.enterfrac = -1;
+	clip.leavefrac = 1;
+	clip.clipplane = NULL;
+	clip.leadside = NULL;
+	clip.getout = false;
+	clip.startout = false;
+
+#ifdef CM_SIMD
+	if (CM_UseSimd(brush))
+	{
+		touched = CM_ClipBrushSides4(tc, brush, &clip);
+	}
+	else
+#endif
+	{
+		touched = CM_ClipBrushSides(tc, brush, &clip);
+	}
+
+	if (!touched)
+	{
+		return;
+	}
+
+	if (!clip.startout)
+	{
+		/* original point was inside brush */
+		trace->startsolid = true;
+
+		if (!clip.getout)
+		{
+			trace->allsolid = true;
+		}
+
+		return;
+	}
+
+	if (clip.enterfrac < clip.leavefrac)
+	{
+		if ((clip.enterfrac > -1) && (clip.enterfrac < trace->fraction))
+		{
+			if (clip.enterfrac < 0)
+			{
+				clip.enterfrac = 0;
+			}
+
+			if (clip.clipplane == NULL)
+			{
+				Com_Error(ERR_FATAL, "clipplane was NULL!\n");
+			}
+
+			trace->fraction = clip.enterfrac;
+			trace->plane = *clip.clipplane;
+			trace->surface = &(clip.leadside->surface->c);
+			trace->contents = brush->contents;
+		}
+	}
+}
+
+static void
+CM_TestBoxInBrush(cmtrace_t *tc, cbrush_t *brush)
 {
 	int i, j;
 	cplane_t *plane;
@@ -750,12 +1359,29 @@ CM_TestBoxInBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 	vec3_t ofs;
 	float d1;
 	cbrushside_t *side;
+	trace_t *trace = &tc->trace;
 
 	if (!brush->numsides)
 	{
 		return;
 	}
 
+#ifdef CM_SIMD
+	if (CM_UseSimd(brush))
+	{
+		if (!CM_TestBrushSides4(tc, brush))
+		{
+			return;
+		}
+
+		/* inside this brush */
+		trace->startsolid = trace->allsolid = true;
+		trace->fraction = 0;
+		trace->contents = brush->contents;
+		return;
+	}
+#endif
+
 	for (i = 0; i < brush->numsides; i++)
 	{
 		side = &map_brushsides[brush->firstbrushside + i];
@@ -768,19 +1394,19 @@ CM_TestBoxInBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 		{
 			if (plane->normal[j] < 0)
 			{
-				ofs[j] = maxs[j];
+				ofs[j] = tc->maxs[j];
 			}
 
 			else
 			{
-				ofs[j] = mins[j];
+				ofs[j] = tc->mins[j];
 			}
 		}
 
 		dist = DotProduct(ofs, plane->normal);
 		dist = plane->dist - dist;
 
-		d1 = DotProduct(p1, plane->normal) - dist;
+		d1 = DotProduct(tc->start, plane->normal) - dist;
 
 		/* if completely in front of face, no intersection */
 		if (d1 > 0)
@@ -795,8 +1421,34 @@ CM_TestBoxInBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 	trace->contents = brush->contents;
 }
 
-void
-CM_TraceToLeaf(int leafnum)
+/*
+ * Returns true if the swept box can't reach the brush.
+ * Clipping against a brush that is more than DIST_EPSILON
+ * away on any axis never changes the trace. The test is
+ * padded by a whole unit instead, so rounding in the
+ * bounds can't reject a brush that would matter.
+ */
+static inline qboolean
+CM_BrushOutsideTrace(cmtrace_t *tc, cbrush_t *brush)
+{
+	if ((tc->absmins[0] > brush->maxs[0] + 1) ||
+		(tc->absmins[1] > brush->maxs[1] + 1) ||
+		(tc->absmins[2] > brush->maxs[2] + 1) ||
+		(tc->absmaxs[0] < brush->mins[0] - 1) ||
+		(tc->absmaxs[1] < brush->mins[1] - 1) ||
+		(tc->absmaxs[2] < brush->mins[2] - 1))
+	{
+#ifndef DEDICATED_ONLY
+		c_brush_rejects++;
+#endif
+		return true;
+	}
+
+	return false;
+}
+
+static void
+CM_TraceToLeaf(cmtrace_t *tc, int leafnum)
 {
 	int k;
 	int brushnum;
@@ -805,7 +1457,7 @@ CM_TraceToLeaf(int leafnum)
 
 	leaf = &map_leafs[leafnum];
 
-	if (!(leaf->contents & trace_contents))
+	if (!(leaf->contents & tc->contents))
 	{
 		return;
 	}
@@ -816,30 +1468,34 @@ CM_TraceToLeaf(int leafnum)
 		brushnum = map_leafbrushes[leaf->firstleafbrush + k];
 		b = &map_brushes[brushnum];
 
-		if (b->checkcount == checkcount)
+		if (tc->brushstamps[brushnum] == tc->checkcount)
 		{
 			continue; /* already checked this brush in another leaf */
 		}
 
-		b->checkcount = checkcount;
+		tc->brushstamps[brushnum] = tc->checkcount;
+
+		if (!(b->contents & tc->contents))
+		{
+			continue;
+		}
 
-		if (!(b->contents & trace_contents))
+		if (CM_BrushOutsideTrace(tc, b))
 		{
 			continue;
 		}
 
-		CM_ClipBoxToBrush(trace_mins, trace_maxs, trace_start,
-				trace_end, &trace_trace, b);
+		CM_ClipBoxToBrush(tc, b);
 
-		if (!trace_trace.fraction)
+		if (!tc->trace.fraction)
 		{
 			return;
 		}
 	}
 }
 
-void
-CM_TestInLeaf(int leafnum)
+static void
+CM_TestInLeaf(cmtrace_t *tc, int leafnum)
 {
 	int k;
 	int brushnum;
@@ -848,7 +1504,7 @@ CM_TestInLeaf(int leafnum)
 
 	leaf = &map_leafs[leafnum];
 
-	if (!(leaf->contents & trace_contents))
+	if (!(leaf->contents & tc->contents))
 	{
 		return;
 	}
@@ -859,29 +1515,35 @@ CM_TestInLeaf(int leafnum)
 		brushnum = map_leafbrushes[leaf->firstleafbrush + k];
 		b = &map_brushes[brushnum];
 
-		if (b->checkcount == checkcount)
+		if (tc->brushstamps[brushnum] == tc->checkcount)
 		{
 			continue; /* already checked this brush in another leaf */
 		}
 
-		b->checkcount = checkcount;
+		tc->brushstamps[brushnum] = tc->checkcount;
+
+		if (!(b->contents & tc->contents))
+		{
+			continue;
+		}
 
-		if (!(b->contents & trace_contents))
+		if (CM_BrushOutsideTrace(tc, b))
 		{
 			continue;
 		}
 
-		CM_TestBoxInBrush(trace_mins, trace_maxs, trace_start, &trace_trace, b);
+		CM_TestBoxInBrush(tc, b);
 
-		if (!trace_trace.fraction)
+		if (!tc->trace.fraction)
 		{
 			return;
 		}
 	}
 }
 
-void
-CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
+static void
+CM_RecursiveHullCheck(cmtrace_t *tc, int num, float p1f, float p2f,
+		vec3_t p1, vec3_t p2)
 {
 	cnode_t *node;
 	cplane_t *plane;
@@ -893,7 +1555,7 @@ CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 	int side;
 	float midf;
 
-	if (trace_trace.fraction <= p1f)
+	if (tc->trace.fraction <= p1f)
 	{
 		return; /* already hit something nearer */
 	}
@@ -901,7 +1563,7 @@ CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 	/* if < 0, we are in a leaf node */
 	if (num < 0)
 	{
-		CM_TraceToLeaf(-1 - num);
+		CM_TraceToLeaf(tc, -1 - num);
 		return;
 	}
 
@@ -914,7 +1576,7 @@ CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 	{
 		t1 = p1[plane->type] - plane->dist;
 		t2 = p2[plane->type] - plane->dist;
-		offset = trace_extents[plane->type];
+		offset = tc->extents[plane->type];
 	}
 
 	else
@@ -922,29 +1584,29 @@ CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 		t1 = DotProduct(plane->normal, p1) - plane->dist;
 		t2 = DotProduct(plane->normal, p2) - plane->dist;
 
-		if (trace_ispoint)
+		if (tc->ispoint)
 		{
 			offset = 0;
 		}
 
 		else
 		{
-			offset = (float)fabs(trace_extents[0] * plane->normal[0]) +
-					 (float)fabs(trace_extents[1] * plane->normal[1]) +
-					 (float)fabs(trace_extents[2] * plane->normal[2]);
+			offset = (float)fabs(tc->extents[0] * plane->normal[0]) +
+					 (float)fabs(tc->extents[1] * plane->normal[1]) +
+					 (float)fabs(tc->extents[2] * plane->normal[2]);
 		}
 	}
 
 	/* see which sides we need to consider */
 	if ((t1 >= offset) && (t2 >= offset))
 	{
-		CM_RecursiveHullCheck(node->children[0], p1f, p2f, p1, p2);
+		CM_RecursiveHullCheck(tc, node->children[0], p1f, p2f, p1, p2);
 		return;
 	}
 
 	if ((t1 < -offset) && (t2 < -offset))
 	{
-		CM_RecursiveHullCheck(node->children[1], p1f, p2f, p1, p2);
+		CM_RecursiveHullCheck(tc, node->children[1], p1f, p2f, p1, p2);
 		return;
 	}
 
@@ -990,7 +1652,7 @@ CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 		mid[i] = p1[i] + frac * (p2[i] - p1[i]);
 	}
 
-	CM_RecursiveHullCheck(node->children[side], p1f, midf, p1, mid);
+	CM_RecursiveHullCheck(tc, node->children[side], p1f, midf, p1, mid);
 
 	/* go past the node */
 	if (frac2 < 0)
@@ -1010,36 +1672,119 @@ CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 		mid[i] = p1[i] + frac2 * (p2[i] - p1[i]);
 	}
 
-	CM_RecursiveHullCheck(node->children[side ^ 1], midf, p2f, mid, p2);
+	CM_RecursiveHullCheck(tc, node->children[side ^ 1], midf, p2f, mid, p2);
+}
+
+/* one brush stamp per brush of the map and box hull */
+static void
+CM_ResizeTraceContext(cmtrace_t *tc)
+{
+	if (tc->brushstamps)
+	{
+		Z_Free(tc->brushstamps);
+	}
+
+	tc->numbrushstamps = numbrushes + MAX_TRACE_CONTEXTS;
+	tc->brushstamps = Z_TagMalloc(tc->numbrushstamps * sizeof(int),
+			Z_TAG_COLLISION);
+	tc->checkcount = 0;
+}
+
+/*
+ * Returns NULL if all contexts are taken, the
+ * caller has to trace on the main thread then.
+ */
+cmtrace_t *
+CM_CreateTraceContext(void)
+{
+	int i;
+	cmtrace_t *tc;
+
+	for (i = 1; i < MAX_TRACE_CONTEXTS; i++)
+	{
+		if (!cm_tracecontexts[i])
+		{
+			tc = Z_TagMalloc(sizeof(cmtrace_t), Z_TAG_COLLISION);
+			tc->boxhull = i;
+			CM_ResizeTraceContext(tc);
+			cm_tracecontexts[i] = tc;
+
+			return tc;
+		}
+	}
+
+	return NULL;
+}
+
+void
+CM_FreeTraceContext(cmtrace_t *tc)
+{
+	if (!tc || (tc == &cm_trace))
+	{
+		return;
+	}
+
+	cm_tracecontexts[tc->boxhull] = NULL;
+
+	if (tc->brushstamps)
+	{
+		Z_Free(tc->brushstamps);
+	}
+
+	Z_Free(tc);
 }
 
+/*
+ * Reentrant version of CM_BoxTrace(), as long as every
+ * thread passes its own context. NULL selects the main
+ * thread context. The map must not be reloaded while
+ * traces are in flight.
+ */
 trace_t
-CM_BoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
-		int headnode, int brushmask)
+CM_BoxTraceContext(cmtrace_t *tc, vec3_t start, vec3_t end,
+		vec3_t mins, vec3_t maxs, int headnode, int brushmask)
 {
 	int i;
 
-	checkcount++; /* for multi-check avoidance */
+	if (!tc)
+	{
+		tc = &cm_trace;
+	}
+
+	tc->checkcount++; /* for multi-check avoidance */
+
+	if (!tc->checkcount)
+	{
+		/* wrapped around, stale stamps could match */
+		memset(tc->brushstamps, 0, tc->numbrushstamps * sizeof(int));
+		tc->checkcount = 1;
+	}
 
 #ifndef DEDICATED_ONLY
 	c_traces++; /* for statistics, may be zeroed */
 #endif
 
 	/* fill in a default trace */
-	memset(&trace_trace, 0, sizeof(trace_trace));
-	trace_trace.fraction = 1;
-	trace_trace.surface = &(nullsurface.c);
+	memset(&tc->trace, 0, sizeof(tc->trace));
+	tc->trace.fraction = 1;
+	tc->trace.surface = &(nullsurface.c);
 
 	if (!numnodes)  /* map not loaded */
 	{
-		return trace_trace;
+		return tc->trace;
 	}
 
-	trace_contents = brushmask;
-	VectorCopy(start, trace_start);
-	VectorCopy(end, trace_end);
-	VectorCopy(mins, trace_mins);
-	VectorCopy(maxs, trace_maxs);
+	tc->contents = brushmask;
+	VectorCopy(start, tc->start);
+	VectorCopy(end, tc->end);
+	VectorCopy(mins, tc->mins);
+	VectorCopy(maxs, tc->maxs);
+
+	for (i = 0; i < 3; i++)
+	{
+		tc->absmins[i] = (start[i] < end[i] ? start[i] : end[i]) + mins[i];
+		tc->absmaxs[i] = (start[i] > end[i] ? start[i] : end[i]) + maxs[i];
+	}
 
 	/* check for position test special case */
 	if ((start[0] == end[0]) && (start[1] == end[1]) && (start[2] == end[2]))
@@ -1063,52 +1808,60 @@ CM_BoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
 
 		for (i = 0; i < numleafs; i++)
 		{
-			CM_TestInLeaf(leafs[i]);
+			CM_TestInLeaf(tc, leafs[i]);
 
-			if (trace_trace.allsolid)
+			if (tc->trace.allsolid)
 			{
 				break;
 			}
 		}
 
-		VectorCopy(start, trace_trace.endpos);
-		return trace_trace;
+		VectorCopy(start, tc->trace.endpos);
+		return tc->trace;
 	}
 
 	/* check for point special case */
 	if ((mins[0] == 0) && (mins[1] == 0) && (mins[2] == 0) &&
 		(maxs[0] == 0) && (maxs[1] == 0) && (maxs[2] == 0))
 	{
-		trace_ispoint = true;
-		VectorClear(trace_extents);
+		tc->ispoint = true;
+		VectorClear(tc->extents);
 	}
 
 	else
 	{
-		trace_ispoint = false;
-		trace_extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
-		trace_extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
-		trace_extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
+		tc->ispoint = false;
+		tc->extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
+		tc->extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
+		tc->extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
 	}
 
 	/* general sweeping through world */
-	CM_RecursiveHullCheck(headnode, 0, 1, start, end);
+	CM_RecursiveHullCheck(tc, headnode, 0, 1, start, end);
 
-	if (trace_trace.fraction == 1)
+	if (tc->trace.fraction == 1)
 	{
-		VectorCopy(end, trace_trace.endpos);
+		VectorCopy(end, tc->trace.endpos);
 	}
 
 	else
 	{
 		for (i = 0; i < 3; i++)
 		{
-			trace_trace.endpos[i] = start[i] + trace_trace.fraction *
+			tc->trace.endpos[i] = start[i] + tc->trace.fraction *
 									(end[i] - start[i]);
 		}
 	}
 
-	return trace_trace;
+	return tc->trace;
+}
+
+trace_t
+CM_BoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
+		int headnode, int brushmask)
+{
+	return CM_BoxTraceContext(&cm_trace, start, end, mins, maxs,
+			headnode, brushmask);
 }
 
 /*
@@ -1116,8 +1869,9 @@ CM_BoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
  * rotating entities
  */
 trace_t
-CM_TransformedBoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
-		int headnode, int brushmask, vec3_t origin, vec3_t angles)
+CM_TransformedBoxTraceContext(cmtrace_t *tc, vec3_t start, vec3_t end,
+		vec3_t mins, vec3_t maxs, int headnode, int brushmask,
+		vec3_t origin, vec3_t angles)
 {
 	trace_t trace;
 	vec3_t start_l, end_l;
@@ -1131,7 +1885,7 @@ CM_TransformedBoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
 	VectorSubtract(end, origin, end_l);
 
 	/* rotate start and end into the models frame of reference */
-	if ((headnode != box_headnode) &&
+	if ((headnode < box_headnode) &&
 		(angles[0] || angles[1] || angles[2]))
 	{
 		rotated = true;
@@ -1158,7 +1912,8 @@ CM_TransformedBoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
 	}
 
 	/* sweep the box through the model */
-	trace = CM_BoxTrace(start_l, end_l, mins, maxs, headnode, brushmask);
+	trace = CM_BoxTraceContext(tc, start_l, end_l, mins, maxs,
+			headnode, brushmask);
 
 	if (rotated && (trace.fraction != 1.0))
 	{
@@ -1178,6 +1933,14 @@ CM_TransformedBoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
 	return trace;
 }
 
+trace_t
+CM_TransformedBoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
+		int headnode, int brushmask, vec3_t origin, vec3_t angles)
+{
+	return CM_TransformedBoxTraceContext(&cm_trace, start, end, mins, maxs,
+			headnode, brushmask, origin, angles);
+}
+
 void
 CMod_LoadSubmodels(lump_t *l)
 {
@@ -1243,11 +2006,6 @@ CMod_LoadSurfaces(lump_t *l)
 		Com_Error(ERR_DROP, "Map with no surfaces");
 	}
 
-	if (count > MAX_MAP_TEXINFO)
-	{
-		Com_Error(ERR_DROP, "Map has too many surfaces");
-	}
-
 	numtexinfo = count;
 	out = map_surfaces;
 
@@ -1282,11 +2040,6 @@ CMod_LoadNodes(lump_t *l)
 		Com_Error(ERR_DROP, "Map has no nodes");
 	}
 
-	if (count > MAX_MAP_NODES)
-	{
-		Com_Error(ERR_DROP, "Map has too many nodes");
-	}
-
 	out = map_nodes;
 
 	numnodes = count;
@@ -1303,92 +2056,265 @@ CMod_LoadNodes(lump_t *l)
 	}
 }
 
-void
-CMod_LoadBrushes(lump_t *l)
-{
-	dbrush_t *in;
-	cbrush_t *out;
-	int i, count;
+#define MAX_REGION_DEPTH 512
 
-	in = (void *)(cmod_base + l->fileofs);
+typedef struct
+{
+	dnode_t		*nodes;
+	dleaf_t		*leafs;
+	int			path[MAX_REGION_DEPTH]; /* plane number * 2 + side */
+	int			numplanes;
+	qboolean	fill;
+} cregionbuild_t;
 
-	if (l->filelen % sizeof(*in))
-	{
-		Com_Error(ERR_DROP, "Mod_LoadBrushes: funny lump size");
-	}
+/*
+ * Returns false if the whole region lies on the
+ * given side of the plane anyway.
+ */
+static qboolean
+CMod_RegionNeedsPlane(cregion_t *region, int ref)
+{
+	int j;
+	float dmin, dmax;
+	cplane_t *plane;
+	vec3_t lo, hi;
 
-	count = l->filelen / sizeof(*in);
+	plane = &map_planes[ref >> 1];
 
-	if (count > MAX_MAP_BRUSHES)
+	for (j = 0; j < 3; j++)
 	{
-		Com_Error(ERR_DROP, "Map has too many brushes");
+		lo[j] = (plane->normal[j] < 0) ? region->maxs[j] : region->mins[j];
+		hi[j] = (plane->normal[j] < 0) ? region->mins[j] : region->maxs[j];
 	}
 
-	out = map_brushes;
-
-	numbrushes = count;
+	dmin = DotProduct(plane->normal, lo) - plane->dist;
+	dmax = DotProduct(plane->normal, hi) - plane->dist;
 
-	for (i = 0; i < count; i++, out++, in++)
+	/* with some room for rounding */
+	if (ref & 1)
 	{
-		out->firstbrushside = LittleLong(in->firstside);
-		out->numsides = LittleLong(in->numsides);
-		out->contents = LittleLong(in->contents);
+		return dmax >= -0.5f;
 	}
+
+	return dmin <= 0.5f;
 }
 
-void
-CMod_LoadLeafs(lump_t *l)
+/*
+ * Walks the tree, keeping the planes from the root. For
+ * every node and leaf only the planes its bounds don't
+ * already lie in front of (or behind) are kept.
+ */
+static void
+CMod_BuildRegions_r(cregionbuild_t *rb, int num, int parent, int depth)
 {
-	int i;
-	cleaf_t *out;
-	dleaf_t *in;
-	int count;
+	int i, j, ref;
+	short *mins, *maxs;
+	cregion_t *region;
 
-	in = (void *)(cmod_base + l->fileofs);
-
-	if (l->filelen % sizeof(*in))
+	if (num < 0)
 	{
-		Com_Error(ERR_DROP, "Mod_LoadLeafs: funny lump size");
+		region = &map_regions[numnodes + (-1 - num)];
+		mins = rb->leafs[-1 - num].mins;
+		maxs = rb->leafs[-1 - num].maxs;
 	}
 
-	count = l->filelen / sizeof(*in);
-
-	if (count < 1)
+	else
 	{
-		Com_Error(ERR_DROP, "Map with no leafs");
+		region = &map_regions[num];
+		mins = rb->nodes[num].mins;
+		maxs = rb->nodes[num].maxs;
 	}
 
-	/* need to save space for box planes */
-	if (count > MAX_MAP_PLANES)
+	if (!rb->fill)
 	{
-		Com_Error(ERR_DROP, "Map has too many planes");
-	}
+		if (region->parent != -2)
+		{
+			/* reached twice, don't use it */
+			region->firstplane = -1;
+		}
 
-	out = map_leafs;
-	numleafs = count;
-	numclusters = 0;
+		else
+		{
+			region->parent = parent;
+			region->firstplane = 0;
+		}
 
-	for (i = 0; i < count; i++, in++, out++)
-	{
-		out->contents = LittleLong(in->contents);
-		out->cluster = LittleShort(in->cluster);
-		out->area = LittleShort(in->area);
-		out->firstleafbrush = LittleShort(in->firstleafbrush);
-		out->numleafbrushes = LittleShort(in->numleafbrushes);
+		for (j = 0; j < 3; j++)
+		{
+			/* the lump is rounded to integers */
+			region->mins[j] = LittleShort(mins[j]) - 1;
+			region->maxs[j] = LittleShort(maxs[j]) + 1;
+		}
 
-		if (out->cluster >= numclusters)
+		for (i = 0; i < depth; i++)
 		{
-			numclusters = out->cluster + 1;
+			if (CMod_RegionNeedsPlane(region, rb->path[i]))
+			{
+				region->numplanes++;
+			}
 		}
-	}
 
-	if (map_leafs[0].contents != CONTENTS_SOLID)
-	{
-		Com_Error(ERR_DROP, "Map leaf 0 is not CONTENTS_SOLID");
+		rb->numplanes += region->numplanes;
 	}
 
-	solidleaf = 0;
-	emptyleaf = -1;
+	else if (region->firstplane >= 0)
+	{
+		region->firstplane = rb->numplanes;
+
+		for (i = 0; i < depth; i++)
+		{
+			if (CMod_RegionNeedsPlane(region, rb->path[i]))
+			{
+				map_regionplanes[rb->numplanes++] = rb->path[i];
+			}
+		}
+	}
+
+	if (num < 0)
+	{
+		return;
+	}
+
+	if (depth >= MAX_REGION_DEPTH)
+	{
+		Com_Error(ERR_DROP, "CMod_BuildRegions: tree too deep");
+	}
+
+	ref = (map_nodes[num].plane - map_planes) * 2;
+
+	for (i = 0; i < 2; i++)
+	{
+		rb->path[depth] = ref + i;
+		CMod_BuildRegions_r(rb, map_nodes[num].children[i], num, depth + 1);
+	}
+}
+
+/*
+ * Sets up the regions CM_PointLeafnumHint() checks.
+ * Needs the bounds from the node and leaf lumps.
+ */
+static void
+CMod_BuildRegions(lump_t *nodes, lump_t *leafs)
+{
+	int i;
+	cregionbuild_t rb;
+
+	if (map_regions)
+	{
+		Z_Free(map_regions);
+		map_regions = NULL;
+	}
+
+	if (map_regionplanes)
+	{
+		Z_Free(map_regionplanes);
+		map_regionplanes = NULL;
+	}
+
+	map_regions = Z_TagMalloc((numnodes + numleafs) * sizeof(cregion_t),
+			Z_TAG_COLLISION);
+
+	for (i = 0; i < numnodes + numleafs; i++)
+	{
+		map_regions[i].parent = -2;
+		map_regions[i].firstplane = -1;
+	}
+
+	memset(&rb, 0, sizeof(rb));
+	rb.nodes = (void *)(cmod_base + nodes->fileofs);
+	rb.leafs = (void *)(cmod_base + leafs->fileofs);
+
+	CMod_BuildRegions_r(&rb, 0, -1, 0);
+
+	map_regionplanes = Z_TagMalloc((rb.numplanes + 1) * sizeof(int),
+			Z_TAG_COLLISION);
+	rb.numplanes = 0;
+	rb.fill = true;
+
+	CMod_BuildRegions_r(&rb, 0, -1, 0);
+}
+
+void
+CMod_LoadBrushes(lump_t *l)
+{
+	dbrush_t *in;
+	cbrush_t *out;
+	int i, count;
+
+	in = (void *)(cmod_base + l->fileofs);
+
+	if (l->filelen % sizeof(*in))
+	{
+		Com_Error(ERR_DROP, "Mod_LoadBrushes: funny lump size");
+	}
+
+	count = l->filelen / sizeof(*in);
+
+	out = map_brushes;
+
+	numbrushes = count;
+
+	for (i = 0; i < count; i++, out++, in++)
+	{
+		out->firstbrushside = LittleLong(in->firstside);
+		out->numsides = LittleLong(in->numsides);
+		out->contents = LittleLong(in->contents);
+	}
+}
+
+void
+CMod_LoadLeafs(lump_t *l)
+{
+	int i;
+	cleaf_t *out;
+	dleaf_t *in;
+	int count;
+
+	in = (void *)(cmod_base + l->fileofs);
+
+	if (l->filelen % sizeof(*in))
+	{
+		Com_Error(ERR_DROP, "Mod_LoadLeafs: funny lump size");
+	}
+
+	count = l->filelen / sizeof(*in);
+
+	if (count < 1)
+	{
+		Com_Error(ERR_DROP, "Map with no leafs");
+	}
+
+	out = map_leafs;
+	numleafs = count;
+	numclusters = 0;
+
+	for (i = 0; i < count; i++, in++, out++)
+	{
+		out->contents = LittleLong(in->contents);
+		out->cluster = LittleShort(in->cluster);
+		out->area = LittleShort(in->area);
+		out->firstleafbrush = LittleShort(in->firstleafbrush);
+		out->numleafbrushes = LittleShort(in->numleafbrushes);
+
+		if (out->cluster >= numclusters)
+		{
+			numclusters = out->cluster + 1;
+		}
+	}
+
+	/* the server keeps vis rows in fixed buffers */
+	if (numclusters > MAX_MAP_LEAFS)
+	{
+		Com_Error(ERR_DROP, "Map has too many clusters");
+	}
+
+	if (map_leafs[0].contents != CONTENTS_SOLID)
+	{
+		Com_Error(ERR_DROP, "Map leaf 0 is not CONTENTS_SOLID");
+	}
+
+	solidleaf = 0;
+	emptyleaf = -1;
 
 	for (i = 1; i < numleafs; i++)
 	{
@@ -1428,12 +2354,6 @@ CMod_LoadPlanes(lump_t *l)
 		Com_Error(ERR_DROP, "Map with no planes");
 	}
 
-	/* need to save space for box planes */
-	if (count > MAX_MAP_PLANES)
-	{
-		Com_Error(ERR_DROP, "Map has too many planes");
-	}
-
 	out = map_planes;
 	numplanes = count;
 
@@ -1479,12 +2399,6 @@ CMod_LoadLeafBrushes(lump_t *l)
 		Com_Error(ERR_DROP, "Map with no planes");
 	}
 
-	/* need to save space for box planes */
-	if (count > MAX_MAP_LEAFBRUSHES)
-	{
-		Com_Error(ERR_DROP, "Map has too many leafbrushes");
-	}
-
 	out = map_leafbrushes;
 	numleafbrushes = count;
 
@@ -1512,12 +2426,6 @@ CMod_LoadBrushSides(lump_t *l)
 
 	count = l->filelen / sizeof(*in);
 
-	/* need to save space for box planes */
-	if (count > MAX_MAP_BRUSHSIDES)
-	{
-		Com_Error(ERR_DROP, "Map has too many planes");
-	}
-
 	out = map_brushsides;
 	numbrushsides = count;
 
@@ -1536,6 +2444,110 @@ CMod_LoadBrushSides(lump_t *l)
 	}
 }
 
+/*
+ * Calculates the bounds of each brush from its axial
+ * sides. The compiler always adds them, but a broken
+ * map could lack some, so those axes stay unbounded.
+ */
+static void
+CMod_BuildBrushBounds(void)
+{
+	int i, j, axis;
+	cbrush_t *brush;
+	cplane_t *plane;
+
+	for (i = 0, brush = map_brushes; i < numbrushes; i++, brush++)
+	{
+		VectorSet(brush->mins, -999999, -999999, -999999);
+		VectorSet(brush->maxs, 999999, 999999, 999999);
+
+		for (j = 0; j < brush->numsides; j++)
+		{
+			plane = map_brushsides[brush->firstbrushside + j].plane;
+			axis = plane->type;
+
+			if (axis > PLANE_Z)
+			{
+				continue;
+			}
+
+			if (plane->normal[axis] > 0)
+			{
+				brush->maxs[axis] = plane->dist;
+			}
+
+			else
+			{
+				brush->mins[axis] = -plane->dist;
+			}
+		}
+	}
+}
+
+#ifdef CM_SIMD
+/*
+ * Copies the planes of all brushes into groups of
+ * four, in the layout CM_ClipBrushSides4() wants.
+ */
+static void
+CMod_BuildBrushPlanes(void)
+{
+	int i, j, k, count;
+	cbrush_t *brush;
+	cplane_t *plane;
+	cplane4_t *out;
+
+	if (map_brushplanes4_mem)
+	{
+		Z_Free(map_brushplanes4_mem);
+		map_brushplanes4_mem = NULL;
+		map_brushplanes4 = NULL;
+	}
+
+	count = 0;
+
+	for (i = 0; i < numbrushes; i++)
+	{
+		count += (map_brushes[i].numsides + 3) / 4;
+	}
+
+	if (!count)
+	{
+		return;
+	}
+
+	/* Z_TagMalloc only guarantees pointer alignment */
+	map_brushplanes4_mem = Z_TagMalloc(count * sizeof(cplane4_t) + 15,
+			Z_TAG_COLLISION);
+	map_brushplanes4 = (cplane4_t *)(((size_t)map_brushplanes4_mem + 15) & ~(size_t)15);
+
+	out = map_brushplanes4;
+	plane = NULL;
+
+	for (i = 0, brush = map_brushes; i < numbrushes; i++, brush++)
+	{
+		map_brushfirst4[i] = out - map_brushplanes4;
+
+		for (j = 0; j < brush->numsides; j += 4, out++)
+		{
+			for (k = 0; k < 4; k++)
+			{
+				/* pad with the last side */
+				if (j + k < brush->numsides)
+				{
+					plane = map_brushsides[brush->firstbrushside + j + k].plane;
+				}
+
+				out->normal[0][k] = plane->normal[0];
+				out->normal[1][k] = plane->normal[1];
+				out->normal[2][k] = plane->normal[2];
+				out->dist[k] = plane->dist;
+			}
+		}
+	}
+}
+#endif
+
 void
 CMod_LoadAreas(lump_t *l)
 {
@@ -1586,9 +2598,10 @@ CMod_LoadAreaPortals(lump_t *l)
 
 	count = l->filelen / sizeof(*in);
 
-	if (count > MAX_MAP_AREAS)
+	/* portalopen[] is part of the savegames */
+	if (count > MAX_MAP_AREAPORTALS)
 	{
-		Com_Error(ERR_DROP, "Map has too many areas");
+		Com_Error(ERR_DROP, "Map has too many area portals");
 	}
 
 	out = map_areaportals;
@@ -1602,11 +2615,6 @@ CMod_LoadVisibility(lump_t *l)
 {
 	numvisibility = l->filelen;
 
-	if (l->filelen > MAX_MAP_VISIBILITY)
-	{
-		Com_Error(ERR_DROP, "Map has too large visibility lump");
-	}
-
 	memcpy(map_visibility, cmod_base + l->fileofs, l->filelen);
 
 	map_vis->numclusters = LittleLong(map_vis->numclusters);
@@ -1628,20 +2636,13 @@ CMod_LoadEntityString(lump_t *l, char *name)
 
 		if (buffer != NULL && bufLen > 1)
 		{
-			if (bufLen + 1 > sizeof(map_entitystring))
-			{
-				Com_Printf("CMod_LoadEntityString: .ent file %s too large: %i > %lu.\n", s, bufLen, (unsigned long)sizeof(map_entitystring));
-				FS_FreeFile(buffer);
-			}
-			else
-			{
-				Com_Printf ("CMod_LoadEntityString: .ent file %s loaded.\n", s);
-				numentitychars = bufLen;
-				memcpy(map_entitystring, buffer, bufLen);
-				map_entitystring[bufLen] = 0; /* jit entity bug - null terminate the entity string! */
-				FS_FreeFile(buffer);
-				return;
-			}
+			Com_Printf ("CMod_LoadEntityString: .ent file %s loaded.\n", s);
+			numentitychars = bufLen;
+			map_entitystring = Z_TagMalloc(bufLen + 1, Z_TAG_COLLISION);
+			memcpy(map_entitystring, buffer, bufLen);
+			map_entitystring[bufLen] = 0; /* jit entity bug - null terminate the entity string! */
+			FS_FreeFile(buffer);
+			return;
 		}
 		else if (bufLen != -1)
 		{
@@ -1653,13 +2654,102 @@ CMod_LoadEntityString(lump_t *l, char *name)
 
 	numentitychars = l->filelen;
 
-	if (l->filelen + 1 > sizeof(map_entitystring))
+	map_entitystring = Z_TagMalloc(l->filelen + 1, Z_TAG_COLLISION);
+	memcpy(map_entitystring, cmod_base + l->fileofs, l->filelen);
+	map_entitystring[l->filelen] = 0;
+}
+
+/* arrays in map_block start 16 byte aligned */
+#define MAP_ALIGN(x) (((x) + 15) & ~15)
+
+static void
+CMod_FreeMap(void)
+{
+	if (map_block)
 	{
-		Com_Error(ERR_DROP, "Map has too large entity lump");
+		Z_Free(map_block);
+		map_block = NULL;
 	}
 
-	memcpy(map_entitystring, cmod_base + l->fileofs, l->filelen);
-	map_entitystring[l->filelen] = 0;
+	if (map_entitystring)
+	{
+		Z_Free(map_entitystring);
+		map_entitystring = NULL;
+	}
+}
+
+/*
+ * Allocates the arrays of a map in one block, sized from
+ * the lumps. Everything a trace walks comes first and in
+ * the order it's walked: nodes, planes, leafs, leaf brushes,
+ * brushes and their sides. Without a header there's only
+ * room for the empty map of a cinematic server.
+ */
+static void
+CMod_AllocMap(dheader_t *header)
+{
+	int i, size;
+	byte *p;
+	int counts[HEADER_LUMPS];
+	int offsets[HEADER_LUMPS + 2];
+	static const struct
+	{
+		int lump;
+		int filesize; /* one element in the file */
+		int size; /* one element in memory */
+		int extra; /* for the box hulls */
+	} layout[] = {
+		{LUMP_NODES, sizeof(dnode_t), sizeof(cnode_t), 6 * MAX_TRACE_CONTEXTS},
+		{LUMP_PLANES, sizeof(dplane_t), sizeof(cplane_t), 12 * MAX_TRACE_CONTEXTS},
+		{LUMP_LEAFS, sizeof(dleaf_t), sizeof(cleaf_t), MAX_TRACE_CONTEXTS},
+		{LUMP_LEAFBRUSHES, sizeof(unsigned short), sizeof(unsigned short), MAX_TRACE_CONTEXTS},
+		{LUMP_BRUSHES, sizeof(dbrush_t), sizeof(cbrush_t), MAX_TRACE_CONTEXTS},
+		{LUMP_BRUSHSIDES, sizeof(dbrushside_t), sizeof(cbrushside_t), 6 * MAX_TRACE_CONTEXTS},
+		{LUMP_TEXINFO, sizeof(texinfo_t), sizeof(mapsurface_t), 0},
+		{LUMP_MODELS, sizeof(dmodel_t), sizeof(cmodel_t), 1},
+		{LUMP_AREAS, sizeof(darea_t), sizeof(carea_t), 1},
+		{LUMP_AREAPORTALS, sizeof(dareaportal_t), sizeof(dareaportal_t), 0},
+		{LUMP_VISIBILITY, 1, 1, sizeof(dvis_t)}
+	};
+	const int numarrays = sizeof(layout) / sizeof(layout[0]);
+
+	CMod_FreeMap();
+
+	size = 0;
+
+	for (i = 0; i < numarrays; i++)
+	{
+		counts[i] = header ?
+			header->lumps[layout[i].lump].filelen / layout[i].filesize : 0;
+		counts[i] += layout[i].extra;
+		offsets[i] = size;
+		size += MAP_ALIGN(counts[i] * layout[i].size);
+	}
+
+#ifdef CM_SIMD
+	/* per brush index into the plane groups */
+	offsets[numarrays] = size;
+	size += MAP_ALIGN(counts[4] * sizeof(int));
+#endif
+
+	map_block = Z_TagMalloc(size + 15, Z_TAG_COLLISION);
+	p = (byte *)(((size_t)map_block + 15) & ~(size_t)15);
+
+	map_nodes = (cnode_t *)(p + offsets[0]);
+	map_planes = (cplane_t *)(p + offsets[1]);
+	map_leafs = (cleaf_t *)(p + offsets[2]);
+	map_leafbrushes = (unsigned short *)(p + offsets[3]);
+	map_brushes = (cbrush_t *)(p + offsets[4]);
+	map_brushsides = (cbrushside_t *)(p + offsets[5]);
+	map_surfaces = (mapsurface_t *)(p + offsets[6]);
+	map_cmodels = (cmodel_t *)(p + offsets[7]);
+	map_areas = (carea_t *)(p + offsets[8]);
+	map_areaportals = (dareaportal_t *)(p + offsets[9]);
+	map_visibility = p + offsets[10];
+	map_vis = (dvis_t *)map_visibility;
+#ifdef CM_SIMD
+	map_brushfirst4 = (int *)(p + offsets[numarrays]);
+#endif
 }
 
 /*
@@ -1694,14 +2784,23 @@ CM_LoadMap(char *name, qboolean clientload, unsigned *checksum)
 	numplanes = 0;
 	numnodes = 0;
 	numleafs = 0;
+	numleafbrushes = 0;
+	numbrushes = 0;
+	numbrushsides = 0;
+	numtexinfo = 0;
+	numareaportals = 0;
 	numcmodels = 0;
 	numvisibility = 0;
 	numentitychars = 0;
-	map_entitystring[0] = 0;
 	map_name[0] = 0;
+	map_pointframe++;
+	CM_FreeVisCache();
+	CM_FreeCollisionCache();
 
 	if (!name[0])
 	{
+		CMod_AllocMap(NULL);
+		map_entitystring = Z_TagMalloc(1, Z_TAG_COLLISION);
 		numleafs = 1;
 		numclusters = 1;
 		numareas = 1;
@@ -1735,6 +2834,8 @@ CM_LoadMap(char *name, qboolean clientload, unsigned *checksum)
 
 	cmod_base = (byte *)buf;
 
+	CMod_AllocMap(&header);
+
 	/* load into heap */
 	CMod_LoadSurfaces(&header.lumps[LUMP_TEXINFO]);
 	CMod_LoadLeafs(&header.lumps[LUMP_LEAFS]);
@@ -1750,10 +2851,32 @@ CM_LoadMap(char *name, qboolean clientload, unsigned *checksum)
 	/* From kmquake2: adding an extra parameter for .ent support. */
 	CMod_LoadEntityString(&header.lumps[LUMP_ENTITIES], name);
 
+	/* everything derived from the lumps comes
+	   from the cache file, if it's up to date */
+	if (!CM_ReadCollisionCache(name, last_checksum))
+	{
+		CMod_BuildBrushBounds();
+#ifdef CM_SIMD
+		CMod_BuildBrushPlanes();
+#endif
+		CMod_BuildRegions(&header.lumps[LUMP_NODES], &header.lumps[LUMP_LEAFS]);
+		CM_InitVisCache();
+
+		CM_WriteCollisionCache(name, last_checksum);
+	}
+
 	FS_FreeFile(buf);
 
 	CM_InitBoxHull();
 
+	for (i = 0; i < MAX_TRACE_CONTEXTS; i++)
+	{
+		if (cm_tracecontexts[i])
+		{
+			CM_ResizeTraceContext(cm_tracecontexts[i]);
+		}
+	}
+
 	memset(portalopen, 0, sizeof(portalopen));
 	FloodAreaConnections();
 
@@ -1800,6 +2923,24 @@ CM_EntityString(void)
 	return map_entitystring;
 }
 
+int
+CM_NumTexinfo(void)
+{
+	return numtexinfo;
+}
+
+/* the texture name without textures/ and .wal */
+const char *
+CM_TexinfoName(int i)
+{
+	if ((i < 0) || (i >= numtexinfo))
+	{
+		Com_Error(ERR_DROP, "CM_TexinfoName: bad number");
+	}
+
+	return map_surfaces[i].rname;
+}
+
 int
 CM_LeafContents(int leafnum)
 {
@@ -1833,6 +2974,22 @@ CM_LeafArea(int leafnum)
 	return map_leafs[leafnum].area;
 }
 
+/*
+ * Returns the compressed row of a cluster, NULL if
+ * the map has none and everything is visible.
+ */
+static byte *
+CM_VisData(int cluster, int vistype)
+{
+	if (!numvisibility || (cluster < 0) ||
+		(cluster >= map_vis->numclusters))
+	{
+		return NULL;
+	}
+
+	return map_visibility + LittleLong(map_vis->bitofs[cluster][vistype]);
+}
+
 void
 CM_DecompressVis(byte *in, byte *out)
 {
@@ -1881,36 +3038,797 @@ CM_DecompressVis(byte *in, byte *out)
 	while (out_p - out < row);
 }
 
-byte *
-CM_ClusterPVS(int cluster)
+/*
+ * Frees the decompressed vis of the last map.
+ */
+static void
+CM_FreeVisCache(void)
 {
-	if (cluster == -1)
-	{
-		memset(pvsrow, 0, (numclusters + 7) >> 3);
-	}
-	else
+	if (map_visrows_mem)
 	{
-		CM_DecompressVis(map_visibility +
-				LittleLong(map_vis->bitofs[cluster][DVIS_PVS]), pvsrow);
+		Z_Free(map_visrows_mem);
 	}
 
-	return pvsrow;
-}
-
-byte *
-CM_ClusterPHS(int cluster)
-{
-	if (cluster == -1)
+	if (map_visslots)
 	{
-		memset(phsrow, 0, (numclusters + 7) >> 3);
+		Z_Free(map_visslots);
 	}
 
-	else
+	if (map_visslotindex)
 	{
-		CM_DecompressVis(map_visibility +
-				LittleLong(map_vis->bitofs[cluster][DVIS_PHS]), phsrow);
+		Z_Free(map_visslotindex);
+	}
+
+	map_visrows_mem = NULL;
+	map_visrows = NULL;
+	map_visslots = NULL;
+	map_visslotindex = NULL;
+	map_numvisslots = 0;
+}
+
+/*
+ * Returns true if all rows can be expanded.
+ */
+static qboolean
+CM_VisFitsCache(void)
+{
+	int limit, rowsize;
+
+	limit = (int)(cm_viscache->value * 1024 * 1024);
+	rowsize = ((numclusters + 31) >> 5) << 2;
+
+	return (limit > 0) && (numclusters > 0) &&
+		(numclusters * 2 * rowsize <= limit);
+}
+
+/*
+ * Sets up the decompressed vis cache for a new map.
+ * Rows are padded to 32 bit, SV_FatPVS() ORs them
+ * together that way.
+ */
+static void
+CM_InitVisCache(void)
+{
+	int i, limit;
+	byte *rows;
+
+	CM_FreeVisCache();
+
+	limit = (int)(cm_viscache->value * 1024 * 1024);
+
+	if ((limit <= 0) || (numclusters <= 0))
+	{
+		return;
+	}
+
+	map_visrowsize = ((numclusters + 31) >> 5) << 2;
+
+	if (CM_VisFitsCache())
+	{
+		/* everything fits */
+		map_visrows_mem = Z_TagMalloc(numclusters * 2 * map_visrowsize,
+				Z_TAG_COLLISION);
+		map_visrows = map_visrows_mem;
+
+		for (i = 0; i < numclusters; i++)
+		{
+			CM_DecompressVis(CM_VisData(i, DVIS_PVS),
+					map_visrows + (i * 2 + DVIS_PVS) * map_visrowsize);
+			CM_DecompressVis(CM_VisData(i, DVIS_PHS),
+					map_visrows + (i * 2 + DVIS_PHS) * map_visrowsize);
+		}
+
+		return;
+	}
+
+	map_numvisslots = limit / map_visrowsize;
+
+	if (map_numvisslots < 64)
+	{
+		map_numvisslots = 64;
+	}
+
+	map_visrows_mem = Z_TagMalloc(map_numvisslots * map_visrowsize,
+			Z_TAG_COLLISION);
+	map_visslots = Z_TagMalloc(map_numvisslots * sizeof(cvisrow_t),
+			Z_TAG_COLLISION);
+	map_visslotindex = Z_TagMalloc(numclusters * 2 * sizeof(int),
+			Z_TAG_COLLISION);
+
+	rows = map_visrows_mem;
+
+	for (i = 0; i < map_numvisslots; i++)
+	{
+		map_visslots[i].key = -1;
+		map_visslots[i].bits = rows + i * map_visrowsize;
+	}
+
+	for (i = 0; i < numclusters * 2; i++)
+	{
+		map_visslotindex[i] = -1;
+	}
+}
+
+/*
+ * Starts a new server frame. Rows returned before
+ * may be reused for other clusters from now on and
+ * remembered point lookups are forgotten.
+ */
+void
+CM_NewFrame(void)
+{
+	map_visframe++;
+	map_pointframe++;
+}
+
+/*
+ * Returns a cached vis row, decompressing it when
+ * necessary, or NULL if all rows in the cache were
+ * handed out this frame.
+ */
+static const byte *
+CM_CachedVis(int cluster, int vistype)
+{
+	int i, key, slot;
+	cvisrow_t *row;
+
+	key = cluster * 2 + vistype;
+
+	if (map_visrows)
+	{
+		return map_visrows + key * map_visrowsize;
+	}
+
+	if (!map_visslots || (cluster < 0) || (cluster >= numclusters))
+	{
+		return NULL;
+	}
+
+	slot = map_visslotindex[key];
+
+	if (slot < 0)
+	{
+		/* evict the least recently used row
+		   that wasn't handed out this frame */
+		for (i = 0; i < map_numvisslots; i++)
+		{
+			row = &map_visslots[i];
+
+			if (row->key < 0)
+			{
+				slot = i;
+				break;
+			}
+
+			if ((row->frame != map_visframe) &&
+				((slot < 0) || (row->lastused < map_visslots[slot].lastused)))
+			{
+				slot = i;
+			}
+		}
+
+		if (slot < 0)
+		{
+			return NULL;
+		}
+
+		row = &map_visslots[slot];
+
+		if (row->key >= 0)
+		{
+			map_visslotindex[row->key] = -1;
+		}
+
+		row->key = key;
+		map_visslotindex[key] = slot;
+
+		CM_DecompressVis(CM_VisData(cluster, vistype), row->bits);
+	}
+
+	row = &map_visslots[slot];
+	row->lastused = ++map_visused;
+	row->frame = map_visframe;
+
+	return row->bits;
+}
+
+/*
+ * True if all vis rows are decompressed. Then
+ * CM_ClusterPVS() and CM_ClusterPHS() only read
+ * the map and may be called from other threads
+ * for clusters other than -1.
+ */
+qboolean
+CM_VisExpanded(void)
+{
+	return map_visrows != NULL;
+}
+
+/*
+ * The returned row stays valid until the next call
+ * to CM_NewFrame(), unless cm_viscache is 0 or too
+ * small for all rows used in a frame. Then it's only
+ * valid until the next call.
+ */
+const byte *
+CM_ClusterPVS(int cluster)
+{
+	const byte *row;
+
+	if ((cluster != -1) && (row = CM_CachedVis(cluster, DVIS_PVS)))
+	{
+		return row;
+	}
+
+	if (cluster == -1)
+	{
+		memset(pvsrow, 0, (numclusters + 7) >> 3);
+	}
+	else
+	{
+		CM_DecompressVis(CM_VisData(cluster, DVIS_PVS), pvsrow);
+	}
+
+	return pvsrow;
+}
+
+const byte *
+CM_ClusterPHS(int cluster)
+{
+	const byte *row;
+
+	if ((cluster != -1) && (row = CM_CachedVis(cluster, DVIS_PHS)))
+	{
+		return row;
+	}
+
+	if (cluster == -1)
+	{
+		memset(phsrow, 0, (numclusters + 7) >> 3);
+	}
+
+	else
+	{
+		CM_DecompressVis(CM_VisData(cluster, DVIS_PHS), phsrow);
 	}
 
 	return phsrow;
 }
 
+
+#ifdef CM_SIMD
+static qboolean
+CM_TracesEqual(trace_t *a, trace_t *b)
+{
+	return (a->allsolid == b->allsolid) && (a->startsolid == b->startsolid) &&
+		(a->fraction == b->fraction) && VectorCompare(a->endpos, b->endpos) &&
+		VectorCompare(a->plane.normal, b->plane.normal) &&
+		(a->plane.dist == b->plane.dist) && (a->surface == b->surface) &&
+		(a->contents == b->contents);
+}
+
+/*
+ * Traces random boxes through the world and the
+ * inline models with the vectorized and the scalar
+ * brush clipping, and complains about differences.
+ */
+static void
+CM_ClipCheck_f(void)
+{
+	static const float sizes[][6] = {
+		{0, 0, 0, 0, 0, 0},
+		{-4, -4, -4, 4, 4, 4},
+		{-16, -16, -24, 16, 16, 32},
+		{-32, -32, -24, 32, 32, 64}
+	};
+	int i, j, count, headnode, mismatches;
+	float simdvalue;
+	vec3_t start, end, mins, maxs;
+	const float *size;
+	cmodel_t *model;
+	trace_t simd, scalar;
+	long long t0, simdtime, scalartime;
+
+	if (!numcmodels || !map_brushplanes4)
+	{
+		Com_Printf("cm_clipcheck: no map loaded\n");
+		return;
+	}
+
+	count = (Cmd_Argc() > 1) ? (int)strtol(Cmd_Argv(1), NULL, 10) : 10000;
+
+	if (count <= 0)
+	{
+		Com_Printf("Usage: cm_clipcheck [count]\n");
+		return;
+	}
+
+	simdvalue = cm_simd->value;
+	simdtime = scalartime = 0;
+	mismatches = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		model = &map_cmodels[randk() % numcmodels];
+		headnode = model->headnode;
+		size = sizes[i % (sizeof(sizes) / sizeof(sizes[0]))];
+
+		for (j = 0; j < 3; j++)
+		{
+			mins[j] = size[j];
+			maxs[j] = size[j + 3];
+			start[j] = model->mins[j] - 64 +
+				frandk() * (model->maxs[j] - model->mins[j] + 128);
+
+			/* every eighth trace only tests the start position */
+			end[j] = (i & 7) ? start[j] + crandk() * 512 : start[j];
+		}
+
+		/* alternate the order, the second trace
+		   finds everything in the cache */
+		for (j = 0; j < 2; j++)
+		{
+			cm_simd->value = ((i + j) & 1);
+			t0 = Sys_Microseconds();
+
+			if (cm_simd->value)
+			{
+				simd = CM_BoxTrace(start, end, mins, maxs, headnode, MASK_ALL);
+				simdtime += Sys_Microseconds() - t0;
+			}
+
+			else
+			{
+				scalar = CM_BoxTrace(start, end, mins, maxs, headnode, MASK_ALL);
+				scalartime += Sys_Microseconds() - t0;
+			}
+		}
+
+		if (!CM_TracesEqual(&simd, &scalar))
+		{
+			if (mismatches++ < 10)
+			{
+				Com_Printf("mismatch %i: (%g %g %g) -> (%g %g %g), "
+						"fraction %g / %g\n", i, start[0], start[1],
+						start[2], end[0], end[1], end[2],
+						simd.fraction, scalar.fraction);
+			}
+		}
+	}
+
+	cm_simd->value = simdvalue;
+
+	Com_Printf("cm_clipcheck: %i traces, %i mismatches\n", count, mismatches);
+	Com_Printf("  simd: %lli usec, scalar: %lli usec\n", simdtime, scalartime);
+}
+#endif
+
+static void
+CM_PointStats_f(void)
+{
+	int total;
+
+	total = c_leafhint_hits + c_leafhint_parenthits + c_leafhint_misses;
+
+	Com_Printf("leaf hints: %i lookups, %i in the same leaf, %i in the "
+			"parent node, %i from the root\n", total, c_leafhint_hits,
+			c_leafhint_parenthits, c_leafhint_misses);
+
+	total = c_boxhint_hits + c_boxhint_parenthits + c_boxhint_misses;
+
+	Com_Printf("box hints: %i lookups, %i in the same node, %i in the "
+			"parent node, %i from the root\n", total, c_boxhint_hits,
+			c_boxhint_parenthits, c_boxhint_misses);
+
+	total = c_pointmemo_hits + c_pointmemo_misses;
+
+	Com_Printf("point memo: %i lookups, %i hits (%i%%)\n", total,
+			c_pointmemo_hits, total ? 100 * c_pointmemo_hits / total : 0);
+
+	c_leafhint_hits = c_leafhint_parenthits = c_leafhint_misses = 0;
+	c_boxhint_hits = c_boxhint_parenthits = c_boxhint_misses = 0;
+	c_pointmemo_hits = c_pointmemo_misses = 0;
+}
+
+void
+CM_Init(void)
+{
+	cm_viscache = Cvar_Get("cm_viscache", "16", 0);
+	cm_cache = Cvar_Get("cm_cache", "1", 0);
+
+	Cmd_AddCommand("cm_pointstats", CM_PointStats_f);
+
+#ifdef CM_SIMD
+	cm_simd = Cvar_Get("cm_simd", "1", 0);
+
+	Cmd_AddCommand("cm_clipcheck", CM_ClipCheck_f);
+#endif
+}
+
+/*
+ * The cache file lives next to the bsp in the game
+ * directory, maps/base1.bsp has maps/base1.cmc.
+ */
+static void
+CM_CollisionCachePath(const char *name, char *path, int size)
+{
+	char *ext;
+
+	Com_sprintf(path, size, "%s/%s", FS_Gamedir(), name);
+
+	ext = strrchr(path, '.');
+
+	if (ext && !strchr(ext, '/'))
+	{
+		*ext = '\0';
+	}
+
+	Q_strlcat(path, ".cmc", size);
+}
+
+/* sections start 16 byte aligned */
+#define CMCACHE_ALIGN(x) (((x) + 15) & ~15)
+
+static void
+CM_FreeCollisionCache(void)
+{
+	if (!map_cachemem)
+	{
+		return;
+	}
+
+	/* all of these point into the block */
+	map_regions = NULL;
+	map_regionplanes = NULL;
+	map_visrows = NULL;
+#ifdef CM_SIMD
+	map_brushplanes4 = NULL;
+#endif
+
+	Z_Free(map_cachemem);
+	map_cachemem = NULL;
+}
+
+/*
+ * Returns the header the current map would be
+ * saved with.
+ */
+static void
+CM_CollisionCacheHeader(cmcacheheader_t *h, unsigned checksum)
+{
+	int i;
+
+	memset(h, 0, sizeof(*h));
+
+	h->ident = CMCACHE_IDENT;
+	h->version = CMCACHE_VERSION;
+	h->byteorder = CMCACHE_BYTEORDER;
+	h->checksum = checksum;
+	h->numbrushes = numbrushes;
+	h->numregions = numnodes + numleafs;
+	h->numclusters = numclusters;
+	h->regionsize = sizeof(cregion_t);
+
+#ifdef CM_SIMD
+	h->planegroupsize = sizeof(cplane4_t);
+
+	for (i = 0; i < numbrushes; i++)
+	{
+		h->numplanegroups += (map_brushes[i].numsides + 3) / 4;
+	}
+#endif
+
+	if (CM_VisFitsCache())
+	{
+		h->visrowsize = ((numclusters + 31) >> 5) << 2;
+	}
+}
+
+/*
+ * The header may match while the indices in the file
+ * don't, check everything that indexes another array.
+ */
+static qboolean
+CM_CollisionCacheValid(cmcacheheader_t *h, int *brushfirst4,
+		cregion_t *regions, int *regionplanes)
+{
+	int i;
+	cregion_t *region;
+
+#ifdef CM_SIMD
+	for (i = 0; i < numbrushes; i++)
+	{
+		if ((brushfirst4[i] < 0) || (brushfirst4[i] +
+				(map_brushes[i].numsides + 3) / 4 > h->numplanegroups))
+		{
+			return false;
+		}
+	}
+#endif
+
+	if (h->numregionplanes < 0)
+	{
+		return false;
+	}
+
+	for (i = 0, region = regions; i < h->numregions; i++, region++)
+	{
+		if ((region->parent < -2) || (region->parent >= numnodes))
+		{
+			return false;
+		}
+
+		if ((region->firstplane >= 0) && ((region->numplanes < 0) ||
+				(region->firstplane + region->numplanes > h->numregionplanes)))
+		{
+			return false;
+		}
+	}
+
+	for (i = 0; i < h->numregionplanes; i++)
+	{
+		if ((regionplanes[i] < 0) || ((regionplanes[i] >> 1) >= numplanes))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Reads the precomputed data of the map. Returns false if
+ * there's no cache file or it doesn't match the map or
+ * the settings, it's rebuilt then.
+ */
+static qboolean
+CM_ReadCollisionCache(const char *name, unsigned checksum)
+{
+	char path[MAX_OSPATH];
+	cmcacheheader_t want, *h;
+	FILE *f;
+	byte *data;
+	int i, len, size;
+	float *bounds;
+	int *brushfirst4, *regionplanes;
+	cregion_t *regions;
+
+	if (!cm_cache->value)
+	{
+		return false;
+	}
+
+	CM_CollisionCachePath(name, path, sizeof(path));
+
+	if (!(f = Q_fopen(path, "rb")))
+	{
+		return false;
+	}
+
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	CM_CollisionCacheHeader(&want, checksum);
+
+	size = CMCACHE_ALIGN(sizeof(cmcacheheader_t)) +
+		CMCACHE_ALIGN(numbrushes * 6 * sizeof(float)) +
+		CMCACHE_ALIGN(want.planegroupsize ? numbrushes * sizeof(int) : 0) +
+		CMCACHE_ALIGN(want.numplanegroups * want.planegroupsize) +
+		CMCACHE_ALIGN(want.numregions * want.regionsize);
+
+	if (len < size)
+	{
+		fclose(f);
+		return false;
+	}
+
+	map_cachemem = Z_TagMalloc(len + 15, Z_TAG_COLLISION);
+	data = (byte *)(((size_t)map_cachemem + 15) & ~(size_t)15);
+
+	/* one read for everything */
+	if (fread(data, 1, len, f) != len)
+	{
+		fclose(f);
+		Z_Free(map_cachemem);
+		map_cachemem = NULL;
+		return false;
+	}
+
+	fclose(f);
+
+	h = (cmcacheheader_t *)data;
+	want.numregionplanes = h->numregionplanes;
+
+	if (memcmp(h, &want, sizeof(want)) || (h->numregionplanes < 0) ||
+		(len != size + CMCACHE_ALIGN(h->numregionplanes * sizeof(int)) +
+			numclusters * 2 * h->visrowsize))
+	{
+		Com_DPrintf("%s is stale\n", path);
+		Z_Free(map_cachemem);
+		map_cachemem = NULL;
+		return false;
+	}
+
+	brushfirst4 = (int *)(data + CMCACHE_ALIGN(sizeof(cmcacheheader_t)) +
+			CMCACHE_ALIGN(numbrushes * 6 * sizeof(float)));
+	regions = (cregion_t *)((byte *)brushfirst4 +
+			CMCACHE_ALIGN(h->planegroupsize ? numbrushes * sizeof(int) : 0) +
+			CMCACHE_ALIGN(h->numplanegroups * h->planegroupsize));
+	regionplanes = (int *)((byte *)regions +
+			CMCACHE_ALIGN(h->numregions * h->regionsize));
+
+	if (!CM_CollisionCacheValid(h, brushfirst4, regions, regionplanes))
+	{
+		Com_DPrintf("%s is corrupt\n", path);
+		Z_Free(map_cachemem);
+		map_cachemem = NULL;
+		return false;
+	}
+
+	data += CMCACHE_ALIGN(sizeof(cmcacheheader_t));
+
+	bounds = (float *)data;
+
+	for (i = 0; i < numbrushes; i++, bounds += 6)
+	{
+		VectorCopy(bounds, map_brushes[i].mins);
+		VectorCopy((bounds + 3), map_brushes[i].maxs);
+	}
+
+	data += CMCACHE_ALIGN(numbrushes * 6 * sizeof(float));
+
+#ifdef CM_SIMD
+	memcpy(map_brushfirst4, data, numbrushes * sizeof(int));
+	data += CMCACHE_ALIGN(numbrushes * sizeof(int));
+
+	if (map_brushplanes4_mem)
+	{
+		Z_Free(map_brushplanes4_mem);
+		map_brushplanes4_mem = NULL;
+	}
+
+	map_brushplanes4 = h->numplanegroups ? (cplane4_t *)data : NULL;
+#endif
+
+	data += CMCACHE_ALIGN(h->numplanegroups * h->planegroupsize);
+
+	if (map_regions)
+	{
+		Z_Free(map_regions);
+	}
+
+	if (map_regionplanes)
+	{
+		Z_Free(map_regionplanes);
+	}
+
+	map_regions = (cregion_t *)data;
+	data += CMCACHE_ALIGN(h->numregions * h->regionsize);
+
+	map_regionplanes = (int *)data;
+	data += CMCACHE_ALIGN(h->numregionplanes * sizeof(int));
+
+	if (h->visrowsize)
+	{
+		CM_FreeVisCache();
+		map_visrowsize = h->visrowsize;
+		map_visrows = data;
+	}
+
+	else
+	{
+		CM_InitVisCache();
+	}
+
+	return true;
+}
+
+static qboolean
+CM_WriteCacheSection(FILE *f, const void *data, int size)
+{
+	static const byte zeros[16];
+	int pad;
+
+	pad = CMCACHE_ALIGN(size) - size;
+
+	if (size && (fwrite(data, 1, size, f) != size))
+	{
+		return false;
+	}
+
+	return !pad || (fwrite(zeros, 1, pad, f) == pad);
+}
+
+/*
+ * Saves what CM_ReadCollisionCache() wants. The file is
+ * written under another name first, so a full disk or a
+ * crash never leaves a truncated cache behind.
+ */
+static void
+CM_WriteCollisionCache(const char *name, unsigned checksum)
+{
+	char path[MAX_OSPATH], tmppath[MAX_OSPATH];
+	cmcacheheader_t h;
+	FILE *f;
+	float *bounds;
+	int i, size;
+	qboolean ok;
+
+	if (!cm_cache->value)
+	{
+		return;
+	}
+
+	CM_CollisionCacheHeader(&h, checksum);
+
+	if ((h.visrowsize != 0) != (map_visrows != NULL))
+	{
+		return;
+	}
+
+	for (i = 0; i < h.numregions; i++)
+	{
+		if (map_regions[i].firstplane >= 0)
+		{
+			h.numregionplanes += map_regions[i].numplanes;
+		}
+	}
+
+	CM_CollisionCachePath(name, path, sizeof(path));
+	Com_sprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+	FS_CreatePath(tmppath);
+
+	if (!(f = Q_fopen(tmppath, "wb")))
+	{
+		Com_DPrintf("Couldn't write %s\n", tmppath);
+		return;
+	}
+
+	bounds = Z_TagMalloc(numbrushes * 6 * sizeof(float) + 1, Z_TAG_COLLISION);
+
+	for (i = 0; i < numbrushes; i++)
+	{
+		VectorCopy(map_brushes[i].mins, (bounds + i * 6));
+		VectorCopy(map_brushes[i].maxs, (bounds + i * 6 + 3));
+	}
+
+	ok = CM_WriteCacheSection(f, &h, sizeof(h)) &&
+		CM_WriteCacheSection(f, bounds, numbrushes * 6 * sizeof(float));
+#ifdef CM_SIMD
+	ok = ok &&
+		CM_WriteCacheSection(f, map_brushfirst4, numbrushes * sizeof(int)) &&
+		CM_WriteCacheSection(f, map_brushplanes4, h.numplanegroups * sizeof(cplane4_t));
+#endif
+	ok = ok &&
+		CM_WriteCacheSection(f, map_regions, h.numregions * sizeof(cregion_t)) &&
+		CM_WriteCacheSection(f, map_regionplanes, h.numregionplanes * sizeof(int));
+
+	size = numclusters * 2 * h.visrowsize;
+
+	if (ok && size)
+	{
+		ok = (fwrite(map_visrows, 1, size, f) == size);
+	}
+
+	Z_Free(bounds);
+
+	if (fclose(f) || !ok)
+	{
+		Com_DPrintf("Couldn't write %s\n", tmppath);
+		Sys_Remove(tmppath);
+		return;
+	}
+
+	if (Sys_Rename(tmppath, path))
+	{
+		/* rename() doesn't replace an existing file on Windows */
+		Sys_Remove(path);
+
+		if (Sys_Rename(tmppath, path))
+		{
+			Com_DPrintf("Couldn't rename %s to %s\n", tmppath, path);
+			Sys_Remove(tmppath);
+		}
+	}
+}
@@ -26,7 +26,24 @@
 
 #include "header/common.h"
 
+#define CVAR_HASH_SIZE 512 /* must be a power of two */
+#define REPLACEMENT_HASH_SIZE 128 /* must be a power of two */
+
 cvar_t *cvar_vars;
+static cvar_t *cvar_hash[CVAR_HASH_SIZE];
+
+/* Lookup statistics for cvar_stats. */
+typedef struct
+{
+	unsigned lookups;
+	unsigned replaced;
+	unsigned frameStart;
+	unsigned lastFrame;
+	unsigned peakFrame;
+	unsigned frames;
+} cvarStats_t;
+
+static cvarStats_t cvar_stats;
 
 
 typedef struct
@@ -92,6 +109,67 @@ replacement_t replacements[] = {
 	{"intensity", "gl1_intensity"}
 };
 
+#define NUM_REPLACEMENTS (sizeof(replacements) / sizeof(replacement_t))
+
+/* The deprecated names, hashed on first use. */
+static int replacement_hash[REPLACEMENT_HASH_SIZE];
+static int replacement_next[NUM_REPLACEMENTS];
+static qboolean replacement_hashed;
+
+static void
+Cvar_HashReplacements(void)
+{
+	unsigned hash;
+	int i;
+
+	for (i = 0; i < REPLACEMENT_HASH_SIZE; i++)
+	{
+		replacement_hash[i] = -1;
+	}
+
+	for (i = 0; i < NUM_REPLACEMENTS; i++)
+	{
+		hash = Q_strhash(replacements[i].old, REPLACEMENT_HASH_SIZE);
+		replacement_next[i] = replacement_hash[hash];
+		replacement_hash[hash] = i;
+	}
+
+	replacement_hashed = true;
+}
+
+/*
+ * Returns the new name of a deprecated cvar
+ * or the name itself if it isn't deprecated.
+ */
+static const char *
+Cvar_ReplaceName(const char *var_name, qboolean warn)
+{
+	int i;
+
+	if (!replacement_hashed)
+	{
+		Cvar_HashReplacements();
+	}
+
+	i = replacement_hash[Q_strhash(var_name, REPLACEMENT_HASH_SIZE)];
+
+	for ( ; i != -1; i = replacement_next[i])
+	{
+		if (!strcmp(var_name, replacements[i].old))
+		{
+			if (warn)
+			{
+				Com_Printf("cvar %s ist deprecated, use %s instead\n", replacements[i].old, replacements[i].new);
+			}
+
+			cvar_stats.replaced++;
+			return replacements[i].new;
+		}
+	}
+
+	return var_name;
+}
+
 
 static qboolean
 Cvar_InfoValidate(char *s)
@@ -118,20 +196,13 @@ static cvar_t *
 Cvar_FindVar(const char *var_name)
 {
 	cvar_t *var;
-	int i;
 
-	/* An ugly hack to rewrite changed CVARs */
-	for (i = 0; i < sizeof(replacements) / sizeof(replacement_t); i++)
-	{
-		if (!strcmp(var_name, replacements[i].old))
-		{
-			Com_Printf("cvar %s ist deprecated, use %s instead\n", replacements[i].old, replacements[i].new);
+	cvar_stats.lookups++;
 
-			var_name = replacements[i].new;
-		}
-	}
+	/* An ugly hack to rewrite changed CVARs */
+	var_name = Cvar_ReplaceName(var_name, true);
 
-	for (var = cvar_vars; var; var = var->next)
+	for (var = cvar_hash[Q_strhash(var_name, CVAR_HASH_SIZE)]; var; var = var->hashNext)
 	{
 		if (!strcmp(var_name, var->name))
 		{
@@ -214,6 +285,7 @@ Cvar_Get(char *var_name, char *var_value, int flags)
 {
 	cvar_t *var;
 	cvar_t **pos;
+	unsigned hash;
 
 	if (flags & (CVAR_USERINFO | CVAR_SERVERINFO))
 	{
@@ -282,6 +354,12 @@ Cvar_Get(char *var_name, char *var_value, int flags)
 	var->next = *pos;
 	*pos = var;
 
+	hash = Q_strhash(var->name, CVAR_HASH_SIZE);
+	var->hashNext = cvar_hash[hash];
+	cvar_hash[hash] = var;
+
+	Cmd_InvalidateCompletion();
+
 	var->flags = flags;
 
 	return var;
@@ -526,7 +604,7 @@ void
 Cvar_Set_f(void)
 {
 	char *firstarg;
-	int c, i;
+	int c;
 
 	c = Cmd_Argc();
 
@@ -539,13 +617,7 @@ Cvar_Set_f(void)
 	firstarg = Cmd_Argv(1);
 
 	/* An ugly hack to rewrite changed CVARs */
-	for (i = 0; i < sizeof(replacements) / sizeof(replacement_t); i++)
-	{
-		if (!strcmp(firstarg, replacements[i].old))
-		{
-			firstarg = replacements[i].new;
-		}
-	}
+	firstarg = (char *)Cvar_ReplaceName(firstarg, false);
 
 	if (c == 4)
 	{
@@ -850,12 +922,57 @@ void Cvar_Toggle_f(void)
     Com_Printf("\"%s\" is \"%s\", can't cycle\n", var->name, var->string);
 }
 
+/*
+ * Called once per frame, closes the
+ * lookup statistics of that frame.
+ */
+void
+Cvar_EndFrame(void)
+{
+	cvar_stats.lastFrame = cvar_stats.lookups - cvar_stats.frameStart;
+	cvar_stats.frameStart = cvar_stats.lookups;
+	cvar_stats.frames++;
+
+	if (cvar_stats.lastFrame > cvar_stats.peakFrame)
+	{
+		cvar_stats.peakFrame = cvar_stats.lastFrame;
+	}
+}
+
+/*
+ * Prints the number of cvar lookups by name, which
+ * should be close to zero while a map is running.
+ * "cvar_stats reset" clears the counters.
+ */
+static void
+Cvar_Stats_f(void)
+{
+	if ((Cmd_Argc() == 2) && (Q_stricmp(Cmd_Argv(1), "reset") == 0))
+	{
+		memset(&cvar_stats, 0, sizeof(cvar_stats));
+		return;
+	}
+
+	Com_Printf("%u lookups in the last frame, peak %u.\n",
+			cvar_stats.lastFrame, cvar_stats.peakFrame);
+
+	if (cvar_stats.frames)
+	{
+		Com_Printf("%.2f lookups per frame over %u frames.\n",
+				(float)cvar_stats.frameStart / cvar_stats.frames, cvar_stats.frames);
+	}
+
+	Com_Printf("%u lookups, %u by deprecated names.\n",
+			cvar_stats.lookups, cvar_stats.replaced);
+}
+
 /*
  * Reads in all archived cvars
  */
 void
 Cvar_Init(void)
 {
+	Cmd_AddCommand("cvar_stats", Cvar_Stats_f);
 	Cmd_AddCommand("cvarlist", Cvar_List_f);
 	Cmd_AddCommand("dec", Cvar_Inc_f);
 	Cmd_AddCommand("inc", Cvar_Inc_f);
@@ -883,6 +1000,11 @@ Cvar_Fini(void)
         var = c;
 	}
 
+	cvar_vars = NULL;
+	memset(cvar_hash, 0, sizeof(cvar_hash));
+	Cmd_InvalidateCompletion();
+
+	Cmd_RemoveCommand("cvar_stats");
 	Cmd_RemoveCommand("cvarlist");
 	Cmd_RemoveCommand("dec");
 	Cmd_RemoveCommand("inc");
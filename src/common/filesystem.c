@@ -29,6 +29,14 @@
 #include <libgen.h>
 #endif
 
+/* Neither Windows nor the PS3 have mmap(),
+   they always read pak entries with fread(). */
+#if !defined(_WIN32) && !defined(__PSL1GHT__)
+#define FS_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include "header/common.h"
 #include "header/glob.h"
 #include "unzip/unzip.h"
@@ -38,6 +46,14 @@
 #define MAX_HANDLES 512
 #define MAX_MODS 32
 #define MAX_PAKS 100
+#define MAX_MISSING 4096
+#define MISSING_HASH_SIZE 1024
+#define MAX_MAPPINGS 256
+#define MIN_MAPPING_SIZE 4096
+#define MAX_PREFETCH 1024
+#define MAX_PREFETCH_OPEN 32
+#define MAX_PREFETCH_THREADS 4
+#define PREFETCH_HASH_SIZE 512
 
 #ifdef SYSTEMWIDE
  #ifndef SYSTEMDIR
@@ -51,8 +67,22 @@ typedef struct
 	fsMode_t mode;
 	FILE *file;           /* Only one will be used. */
 	unzFile *zip;        /* (file or zip) */
+	qboolean mappable;   /* Uncompressed pack entry. */
 } fsHandle_t;
 
+/*
+ * Pack entries returned by FS_LoadFile() without copying
+ * them. The mappings are private, so the loaders may still
+ * byteswap the data in place without touching the pack or
+ * other users of the same entry.
+ */
+typedef struct
+{
+	byte *base;     /* Page aligned start of the mapping. */
+	size_t length;
+	void *data;     /* Returned by FS_LoadFile(). */
+} fsMapping_t;
+
 typedef struct fsLink_s
 {
 	char *from;
@@ -65,7 +95,10 @@ typedef struct
 {
 	char name[MAX_QPATH];
 	int size;
-	int offset;     /* Ignored in PK3 files. */
+	int offset;     /* Start of the data, -1 if not yet known (PK3). */
+	int hashNext;   /* Next file in the same hash chain or -1. */
+	uLong zipPos;   /* Central directory entry (PK3). */
+	qboolean stored; /* Uncompressed (PAK or stored PK3 entry). */
 } fsPackFile_t;
 
 typedef struct
@@ -76,6 +109,8 @@ typedef struct
 	unzFile *pk3;
 	qboolean isProtectedPak;
 	fsPackFile_t *files;
+	int hashSize;   /* Power of two. */
+	int *hashTable; /* First file of each hash chain or -1. */
 } fsPack_t;
 
 typedef struct fsSearchPath_s
@@ -97,10 +132,61 @@ typedef struct
 	fsPackFormat_t format;
 } fsPackTypes_t;
 
+/*
+ * Merged index over all packs in the search path. Every
+ * file name points to the first pack (in search order)
+ * providing it, so a lookup is a single hash probe no
+ * matter how many packs are loaded.
+ */
+typedef struct
+{
+	fsSearchPath_t *search;
+	int file;
+	int next;
+} fsIndexEntry_t;
+
+typedef struct
+{
+	qboolean valid;
+	int numEntries;
+	int hashSize;
+	int *hashTable;
+	fsIndexEntry_t *entries;
+} fsIndex_t;
+
+/*
+ * Files known to be missing from the search path. Most
+ * misses come from the renderers and the sound system
+ * probing several file formats, and each of them costs
+ * at least one fopen() per directory in the search path.
+ */
+typedef struct fsMissing_s
+{
+	char name[MAX_QPATH];
+	qboolean gamedirOnly;
+	struct fsMissing_s *next;
+} fsMissing_t;
+
+typedef struct
+{
+	unsigned lookups;  /* Calls to FS_FOpenFile(). */
+	unsigned probes;   /* Hash chain entries compared. */
+	unsigned misses;   /* Files not found anywhere. */
+	unsigned cachedMisses; /* Misses answered by the missing file cache. */
+	unsigned mapped;   /* Files loaded without a copy. */
+	unsigned copied;   /* Files loaded into a zone buffer. */
+} fsStats_t;
+
 fsHandle_t fs_handles[MAX_HANDLES];
 fsLink_t *fs_links;
 fsSearchPath_t *fs_searchPaths;
 fsSearchPath_t *fs_baseSearchPaths;
+fsIndex_t fs_index;
+fsMissing_t *fs_missing[MISSING_HASH_SIZE];
+int fs_numMissing;
+fsMapping_t fs_mappings[MAX_MAPPINGS];
+int fs_numMappings;
+fsStats_t fs_stats;
 
 /* Pack formats / suffixes. */
 fsPackTypes_t fs_packtypes[] = {
@@ -119,6 +205,9 @@ cvar_t *fs_basedir;
 cvar_t *fs_cddir;
 cvar_t *fs_gamedirvar;
 cvar_t *fs_debug;
+cvar_t *fs_mmap;
+cvar_t *fs_prefetch;
+cvar_t *fs_prefetchsize;
 
 fsHandle_t *FS_GetFileByHandle(fileHandle_t f);
 
@@ -251,6 +340,9 @@ FS_CreatePath(char *path)
 
 	FS_DPrintf("FS_CreatePath(%s)\n", path);
 
+	// Files are going to be written.
+	FS_FlushMissingCache();
+
 	if (strstr(path, "..") != NULL)
 	{
 		Com_Printf("WARNING: refusing to create relative path '%s'.\n", path);
@@ -366,6 +458,289 @@ FS_FCloseFile(fileHandle_t f)
 	memset(handle, 0, sizeof(*handle));
 }
 
+/*
+ * Returns the smallest power of two able to hold
+ * count entries without too many collisions.
+ */
+static int
+FS_HashSize(int count)
+{
+	int size = 16;
+
+	while (size < count)
+	{
+		size <<= 1;
+	}
+
+	return size;
+}
+
+/*
+ * Builds the case insensitive name index of a pack.
+ * Files are linked in reverse, so that the first of
+ * several files with the same name wins like in the
+ * old linear search.
+ */
+static void
+FS_HashPack(fsPack_t *pack)
+{
+	int i;
+	unsigned hash;
+
+	pack->hashSize = FS_HashSize(pack->numFiles);
+	pack->hashTable = Z_Malloc(pack->hashSize * sizeof(int));
+
+	for (i = 0; i < pack->hashSize; i++)
+	{
+		pack->hashTable[i] = -1;
+	}
+
+	for (i = pack->numFiles - 1; i >= 0; i--)
+	{
+		hash = Q_strhash(pack->files[i].name, pack->hashSize);
+		pack->files[i].hashNext = pack->hashTable[hash];
+		pack->hashTable[hash] = i;
+	}
+}
+
+/*
+ * Returns the index of the file inside the pack or -1.
+ */
+static int
+FS_FindInPack(fsPack_t *pack, const char *name)
+{
+	int i;
+
+	i = pack->hashTable[Q_strhash(name, pack->hashSize)];
+
+	for ( ; i != -1; i = pack->files[i].hashNext)
+	{
+		fs_stats.probes++;
+
+		if (Q_stricmp(pack->files[i].name, name) == 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Looks the file up in the merged index. Returns the
+ * search path element of the first pack providing it
+ * and the index of the file in that pack, or NULL.
+ */
+static fsSearchPath_t *
+FS_FindInIndex(const char *name, int *file)
+{
+	int i;
+	fsIndexEntry_t *entry;
+
+	i = fs_index.hashTable[Q_strhash(name, fs_index.hashSize)];
+
+	for ( ; i != -1; i = entry->next)
+	{
+		entry = &fs_index.entries[i];
+		fs_stats.probes++;
+
+		if (Q_stricmp(entry->search->pack->files[entry->file].name, name) == 0)
+		{
+			*file = entry->file;
+			return entry->search;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns true if the file was already searched for
+ * and not found since the last search path change.
+ */
+static qboolean
+FS_IsMissing(const char *name, qboolean gamedir_only)
+{
+	fsMissing_t *missing;
+
+	missing = fs_missing[Q_strhash(name, MISSING_HASH_SIZE)];
+
+	for ( ; missing; missing = missing->next)
+	{
+		if ((missing->gamedirOnly == gamedir_only) && (strcmp(missing->name, name) == 0))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void
+FS_AddMissing(const char *name, qboolean gamedir_only)
+{
+	unsigned hash;
+	fsMissing_t *missing;
+
+	if (fs_numMissing >= MAX_MISSING)
+	{
+		FS_FlushMissingCache();
+	}
+
+	hash = Q_strhash(name, MISSING_HASH_SIZE);
+
+	missing = Z_Malloc(sizeof(fsMissing_t));
+	Q_strlcpy(missing->name, name, sizeof(missing->name));
+	missing->gamedirOnly = gamedir_only;
+	missing->next = fs_missing[hash];
+	fs_missing[hash] = missing;
+
+	fs_numMissing++;
+}
+
+/*
+ * Forgets all missing files. Must be called whenever
+ * files may have been added to the search path.
+ */
+void
+FS_FlushMissingCache(void)
+{
+	int i;
+	fsMissing_t *missing, *next;
+
+	for (i = 0; i < MISSING_HASH_SIZE; i++)
+	{
+		for (missing = fs_missing[i]; missing; missing = next)
+		{
+			next = missing->next;
+			Z_Free(missing);
+		}
+
+		fs_missing[i] = NULL;
+	}
+
+	fs_numMissing = 0;
+}
+
+/*
+ * Throws the merged index away. Lookups fall back to
+ * the per pack indices until it's rebuilt.
+ */
+static void
+FS_InvalidateIndex(void)
+{
+	FS_EndPrefetch(false);
+	FS_FlushMissingCache();
+
+	if (fs_index.hashTable)
+	{
+		Z_Free(fs_index.hashTable);
+	}
+
+	if (fs_index.entries)
+	{
+		Z_Free(fs_index.entries);
+	}
+
+	memset(&fs_index, 0, sizeof(fs_index));
+}
+
+/*
+ * (Re)builds the merged index from the current search
+ * path. Must be called after each search path change.
+ */
+static void
+FS_BuildIndex(void)
+{
+	int i, file, count;
+	unsigned hash;
+	fsIndexEntry_t *entry;
+	fsSearchPath_t *search;
+	unsigned probes = fs_stats.probes;
+
+	FS_InvalidateIndex();
+
+	count = 0;
+
+	for (search = fs_searchPaths; search; search = search->next)
+	{
+		if (search->pack)
+		{
+			count += search->pack->numFiles;
+		}
+	}
+
+	fs_index.hashSize = FS_HashSize(count);
+	fs_index.hashTable = Z_Malloc(fs_index.hashSize * sizeof(int));
+	fs_index.entries = Z_Malloc((count + 1) * sizeof(fsIndexEntry_t));
+
+	for (i = 0; i < fs_index.hashSize; i++)
+	{
+		fs_index.hashTable[i] = -1;
+	}
+
+	for (search = fs_searchPaths; search; search = search->next)
+	{
+		if (!search->pack)
+		{
+			continue;
+		}
+
+		for (i = 0; i < search->pack->numFiles; i++)
+		{
+			// Shadowed by a pack earlier in the search path.
+			if (FS_FindInIndex(search->pack->files[i].name, &file) != NULL)
+			{
+				continue;
+			}
+
+			hash = Q_strhash(search->pack->files[i].name, fs_index.hashSize);
+
+			entry = &fs_index.entries[fs_index.numEntries];
+			entry->search = search;
+			entry->file = i;
+			entry->next = fs_index.hashTable[hash];
+			fs_index.hashTable[hash] = fs_index.numEntries++;
+		}
+	}
+
+	// Building the index isn't a lookup.
+	fs_stats.probes = probes;
+	fs_index.valid = true;
+}
+
+/*
+ * Returns the position of the data of a stored PK3
+ * entry. The local file header must be parsed for
+ * that, so it's done once at the first access and
+ * not for all files when the PK3 is loaded.
+ */
+static int
+FS_LocatePK3Data(fsPack_t *pack, int file)
+{
+	fsPackFile_t *entry = &pack->files[file];
+
+	if (entry->offset != -1)
+	{
+		return entry->offset;
+	}
+
+	if (unzSetOffset(pack->pk3, entry->zipPos) != UNZ_OK)
+	{
+		return -1;
+	}
+
+	if (unzOpenCurrentFile(pack->pk3) != UNZ_OK)
+	{
+		return -1;
+	}
+
+	entry->offset = (int)unzGetCurrentFileZStreamPos64(pack->pk3);
+	unzCloseCurrentFile(pack->pk3);
+
+	return entry->offset;
+}
+
 /*
  * Finds the file in the search path. Returns filesize and an open FILE *. Used
  * for streaming data out of either a pak file or a seperate file.
@@ -377,6 +752,9 @@ FS_FOpenFile(const char *rawname, fileHandle_t *f, qboolean gamedir_only)
 	fsHandle_t *handle;
 	fsPack_t *pack;
 	fsSearchPath_t *search;
+	fsSearchPath_t *indexSearch = NULL;
+	qboolean pastIndexHit = false;
+	int indexFile = -1;
 	int i;
 
 	// Remove self references and empty dirs from the requested path.
@@ -432,263 +810,894 @@ FS_FOpenFile(const char *rawname, fileHandle_t *f, qboolean gamedir_only)
 	}
 
 	file_from_protected_pak = false;
+
+	fs_stats.lookups++;
+
+	if (FS_IsMissing(name, gamedir_only))
+	{
+		if (fs_debug->value)
+		{
+			Com_Printf("FS_FOpenFile: couldn't find '%s' (cached).\n", name);
+		}
+
+		fs_stats.misses++;
+		fs_stats.cachedMisses++;
+
+		*f = 0;
+		return -1;
+	}
+
 	handle = FS_HandleForFile(name, f);
 	Q_strlcpy(handle->name, name, sizeof(handle->name));
 	handle->mode = FS_READ;
 
+	/* Ask the merged index which pack provides the file. */
+	if (fs_index.valid)
+	{
+		indexSearch = FS_FindInIndex(handle->name, &indexFile);
+	}
+
 	/* Search through the path, one element at a time. */
 	for (search = fs_searchPaths; search; search = search->next)
 	{
+		// Packs in front of the one found in the index
+		// can't provide the file. If the index hit is
+		// filtered out below, the packs behind it must
+		// be searched one by one.
+		qboolean skipPack = fs_index.valid && !pastIndexHit;
+
+		if (search == indexSearch)
+		{
+			pastIndexHit = true;
+			skipPack = false;
+		}
+
 		if (gamedir_only)
 		{
-			if (strstr(search->path, FS_Gamedir()) == NULL)
-			{
-				continue;
-			}
+			if (strstr(search->path, FS_Gamedir()) == NULL)
+			{
+				continue;
+			}
+		}
+
+		// Evil hack for maps.lst and players/
+		// TODO: A flag to ignore paks would be better
+		if ((strcmp(fs_gamedirvar->string, "") == 0) && search->pack) {
+			if ((strcmp(name, "maps.lst") == 0)|| (strncmp(name, "players/", 8) == 0)) {
+				continue;
+			}
+		}
+
+		/* Search inside a pack file. */
+		if (search->pack)
+		{
+			pack = search->pack;
+
+			if (skipPack)
+			{
+				continue;
+			}
+
+			i = (search == indexSearch) ? indexFile : FS_FindInPack(pack, handle->name);
+
+			if (i == -1)
+			{
+				continue;
+			}
+
+			/* Found it! */
+			if (fs_debug->value)
+			{
+				Com_Printf("FS_FOpenFile: '%s' (found in '%s').\n",
+				           handle->name, pack->name);
+			}
+
+			// save the name with *correct case* in the handle
+			// (relevant for savegames, when starting map with wrong case but it's still found
+			//  because it's from pak, but save/bla/MAPname.sav/sv2 will have wrong case and can't be found then)
+			Q_strlcpy(handle->name, pack->files[i].name, sizeof(handle->name));
+
+			if (pack->pak)
+			{
+				/* PAK */
+				if (pack->isProtectedPak)
+				{
+					file_from_protected_pak = true;
+				}
+
+				handle->file = Q_fopen(pack->name, "rb");
+
+				if (handle->file)
+				{
+					fseek(handle->file, pack->files[i].offset, SEEK_SET);
+					handle->mappable = true;
+					return pack->files[i].size;
+				}
+			}
+			else if (pack->pk3)
+			{
+				/* PK3 */
+				if (pack->isProtectedPak)
+				{
+					file_from_protected_pak = true;
+				}
+
+				/* Stored entries are read like PAK entries,
+				   only compressed ones go through the unzip
+				   code. */
+				if (pack->files[i].stored && (FS_LocatePK3Data(pack, i) != -1))
+				{
+					handle->file = Q_fopen(pack->name, "rb");
+
+					if (handle->file)
+					{
+						fseek(handle->file, pack->files[i].offset, SEEK_SET);
+						handle->mappable = true;
+						return pack->files[i].size;
+					}
+				}
+
+#ifdef _WIN32
+				handle->zip = unzOpen2(pack->name, &zlib_file_api);
+#else
+				handle->zip = unzOpen(pack->name);
+#endif
+
+				if (handle->zip)
+				{
+					if (unzSetOffset(handle->zip, pack->files[i].zipPos) == UNZ_OK)
+					{
+						if (unzOpenCurrentFile(handle->zip) == UNZ_OK)
+						{
+							return pack->files[i].size;
+						}
+					}
+
+					unzClose(handle->zip);
+				}
+			}
+
+			Com_Error(ERR_FATAL, "Couldn't reopen '%s'", pack->name);
+		}
+		else
+		{
+			/* Search in a directory tree. */
+			Com_sprintf(path, sizeof(path), "%s/%s", search->path, handle->name);
+
+			handle->file = Q_fopen(path, "rb");
+
+			if (!handle->file)
+			{
+				Com_sprintf(lwrName, sizeof(lwrName), "%s", handle->name);
+				Q_strlwr(lwrName);
+				Com_sprintf(path, sizeof(path), "%s/%s", search->path, lwrName);
+				handle->file = Q_fopen(path, "rb");
+			}
+
+			if (handle->file)
+			{
+				if (fs_debug->value)
+				{
+					Com_Printf("FS_FOpenFile: '%s' (found in '%s').\n",
+							   handle->name, search->path);
+				}
+
+				return FS_FileLength(handle->file);
+			}
+		}
+	}
+	if (fs_debug->value)
+	{
+		Com_Printf("FS_FOpenFile: couldn't find '%s'.\n", handle->name);
+	}
+
+	fs_stats.misses++;
+	FS_AddMissing(name, gamedir_only);
+
+	/* Couldn't open, so free the handle. */
+	memset(handle, 0, sizeof(*handle));
+	*f = 0;
+	return -1;
+}
+
+/*
+ * Properly handles partial reads.
+ */
+int
+FS_Read(void *buffer, int size, fileHandle_t f)
+{
+	qboolean tried = false;    /* Tried to read from a CD. */
+	byte *buf;        /* Buffer. */
+	int r;         /* Number of bytes read. */
+	int remaining;        /* Remaining bytes. */
+	fsHandle_t *handle;  /* File handle. */
+
+	handle = FS_GetFileByHandle(f);
+
+	/* Read. */
+	remaining = size;
+	buf = (byte *)buffer;
+
+	while (remaining)
+	{
+		if (handle->file)
+		{
+			r = fread(buf, 1, remaining, handle->file);
+		}
+		else if (handle->zip)
+		{
+			r = unzReadCurrentFile(handle->zip, buf, remaining);
+		}
+		else
+		{
+			return 0;
+		}
+
+		if (r == 0)
+		{
+			if (!tried)
+			{
+				/* Might tried to read from a CD. */
+				tried = true;
+			}
+			else
+			{
+				/* Already tried once. */
+				Com_Error(ERR_FATAL, "FS_Read: 0 bytes read from '%s'", handle->name);
+				return size - remaining;
+			}
+		}
+		else if (r == -1)
+		{
+			Com_Error(ERR_FATAL, "FS_Read: -1 bytes read from '%s'", handle->name);
+		}
+
+		remaining -= r;
+		buf += r;
+	}
+
+	return size;
+}
+
+/*
+ * Properly handles partial reads of size up to count times. No error if it
+ * can't read.
+ */
+int
+FS_FRead(void *buffer, int size, int count, fileHandle_t f)
+{
+	qboolean tried = false;    /* Tried to read from a CD. */
+	byte *buf;        /* Buffer. */
+	int loops;         /* Loop indicator. */
+	int r;         /* Number of bytes read. */
+	int remaining;         /* Remaining bytes. */
+	fsHandle_t *handle;  /* File handle. */
+
+	handle = FS_GetFileByHandle(f);
+
+	/* Read. */
+	loops = count;
+	buf = (byte *)buffer;
+
+	while (loops)
+	{
+		/* Read in chunks. */
+		remaining = size;
+
+		while (remaining)
+		{
+			if (handle->file)
+			{
+				r = fread(buf, 1, remaining, handle->file);
+			}
+			else if (handle->zip)
+			{
+				r = unzReadCurrentFile(handle->zip, buf, remaining);
+			}
+			else
+			{
+				return 0;
+			}
+
+			if (r == 0)
+			{
+				if (!tried)
+				{
+					/* Might tried to read from a CD. */
+					tried = true;
+				}
+				else
+				{
+					/* Already tried once. */
+					return size - remaining;
+				}
+			}
+			else if (r == -1)
+			{
+				Com_Error(ERR_FATAL,
+						"FS_FRead: -1 bytes read from '%s'",
+						handle->name);
+			}
+
+			remaining -= r;
+			buf += r;
+		}
+
+		loops--;
+	}
+
+	return size;
+}
+
+#ifdef FS_MMAP
+/*
+ * Maps an uncompressed pack entry into memory. Returns
+ * NULL if the entry can't be mapped, the caller must
+ * read it the traditional way.
+ */
+static void *
+FS_MapFile(fsHandle_t *handle, int size)
+{
+	byte *base;
+	long offset;
+	size_t pageofs;
+	fsMapping_t *mapping;
+
+
+	if (!fs_mmap->value || !handle->mappable || (size < MIN_MAPPING_SIZE))
+	{
+		return NULL;
+	}
+
+	if (fs_numMappings == MAX_MAPPINGS)
+	{
+		return NULL;
+	}
+
+	offset = ftell(handle->file);
+
+	// The loaders cast the buffer to structs of ints
+	// and floats. Z_Malloc() guarantees alignment,
+	// the offset of the entry in the pack doesn't.
+	if ((offset < 0) || (offset & 3))
+	{
+		return NULL;
+	}
+
+	pageofs = offset % sysconf(_SC_PAGESIZE);
+
+	base = mmap(NULL, size + pageofs, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+			fileno(handle->file), offset - pageofs);
+
+	if (base == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	mapping = &fs_mappings[fs_numMappings++];
+	mapping->base = base;
+	mapping->length = size + pageofs;
+	mapping->data = base + pageofs;
+
+	return mapping->data;
+}
+
+/*
+ * Unmaps a buffer returned by FS_MapFile(). Returns
+ * false if the buffer isn't mapped.
+ */
+static qboolean
+FS_UnmapFile(void *buffer)
+{
+	int i;
+
+	for (i = 0; i < fs_numMappings; i++)
+	{
+		if (fs_mappings[i].data == buffer)
+		{
+			munmap(fs_mappings[i].base, fs_mappings[i].length);
+			fs_mappings[i] = fs_mappings[--fs_numMappings];
+
+			return true;
+		}
+	}
+
+	return false;
+}
+#endif
+
+/*
+ * Prefetching. When a level is loaded the client knows
+ * all models, images, sounds and textures from the config
+ * strings before the first of them is registered. They're
+ * queued with FS_Prefetch() and read by worker threads
+ * while the main thread parses the BSP, FS_LoadFile()
+ * hands the buffers out as they're requested.
+ *
+ * Only the main thread touches the search path and the
+ * zone: Files are opened and their buffers allocated in
+ * FS_PumpPrefetch(), the workers just read into them.
+ */
+typedef enum
+{
+	PREFETCH_QUEUED,    /* Not yet opened. */
+	PREFETCH_OPEN,      /* Waiting for a worker. */
+	PREFETCH_READING,   /* A worker reads it. */
+	PREFETCH_DONE,      /* Buffer is ready. */
+	PREFETCH_FAILED,    /* Not found or read error. */
+	PREFETCH_TAKEN      /* Handed to the main thread. */
+} fsPrefetchState_t;
+
+typedef struct
+{
+	char name[MAX_QPATH];
+	fsPrefetchState_t state;
+	int size;
+	byte *buffer;
+	FILE *file;
+	unzFile *zip;
+	qboolean protectedPak;
+	long long readTime;  /* Microseconds spent in the worker. */
+	int hashNext;
+} fsPrefetch_t;
+
+typedef struct
+{
+	qboolean active;
+	qboolean quit;
+	qmutex_t *mutex;
+	qcond_t *cond;
+	qthread_t *threads[MAX_PREFETCH_THREADS];
+	int numThreads;
+
+	fsPrefetch_t jobs[MAX_PREFETCH];
+	int hashTable[PREFETCH_HASH_SIZE];
+	int numJobs;
+	int nextOpen;        /* First job not yet opened. */
+	int numOpen;         /* Jobs holding a file. */
+	int bytes;           /* Allocated for jobs not taken. */
+
+	int hits;
+	int hitBytes;
+	long long savedTime; /* Worker time of files handed out. */
+	long long waitTime;  /* Main thread waiting for workers. */
+} fsPrefetchQueue_t;
+
+static fsPrefetchQueue_t fs_prefetchQueue;
+
+/*
+ * Reads the whole file of a job and closes it. Called
+ * without holding the mutex, so it must not touch
+ * anything but the job itself. Returns the new state
+ * of the job, the caller sets it under the mutex.
+ */
+static fsPrefetchState_t
+FS_ReadPrefetch(fsPrefetch_t *job)
+{
+	int r, remaining;
+	long long start;
+	byte *buf;
+
+	start = Sys_Microseconds();
+
+	buf = job->buffer;
+	remaining = job->size;
+
+	while (remaining > 0)
+	{
+		if (job->file)
+		{
+			r = fread(buf, 1, remaining, job->file);
+		}
+		else
+		{
+			r = unzReadCurrentFile(job->zip, buf, remaining);
+		}
+
+		if (r <= 0)
+		{
+			break;
+		}
+
+		remaining -= r;
+		buf += r;
+	}
+
+	if (job->file)
+	{
+		fclose(job->file);
+		job->file = NULL;
+	}
+	else
+	{
+		unzCloseCurrentFile(job->zip);
+		unzClose(job->zip);
+		job->zip = NULL;
+	}
+
+	job->readTime = Sys_Microseconds() - start;
+
+	return (remaining > 0) ? PREFETCH_FAILED : PREFETCH_DONE;
+}
+
+static void
+FS_PrefetchThread(void *data)
+{
+	int i;
+	fsPrefetch_t *job;
+	fsPrefetchState_t state;
+	fsPrefetchQueue_t *queue = data;
+
+	Sys_LockMutex(queue->mutex);
+
+	while (!queue->quit)
+	{
+		job = NULL;
+
+		for (i = 0; i < queue->nextOpen; i++)
+		{
+			if (queue->jobs[i].state == PREFETCH_OPEN)
+			{
+				job = &queue->jobs[i];
+				break;
+			}
+		}
+
+		if (!job)
+		{
+			Sys_WaitCond(queue->cond);
+			continue;
+		}
+
+		job->state = PREFETCH_READING;
+		Sys_UnlockMutex(queue->mutex);
+
+		state = FS_ReadPrefetch(job);
+
+		Sys_LockMutex(queue->mutex);
+		job->state = state;
+		queue->numOpen--;
+		Sys_BroadcastCond(queue->cond);
+	}
+
+	Sys_UnlockMutex(queue->mutex);
+}
+
+/*
+ * Opens queued files until MAX_PREFETCH_OPEN files are
+ * waiting for the workers or the memory limit is hit.
+ * The file handle is taken over by the job, so the
+ * prefetcher doesn't eat up fs_handles.
+ */
+static void
+FS_PumpPrefetch(void)
+{
+	int limit;
+	fileHandle_t f;
+	fsHandle_t *handle;
+	fsPrefetch_t *job;
+	fsPrefetchQueue_t *queue = &fs_prefetchQueue;
+
+	limit = fs_prefetchsize->value * 1024 * 1024;
+
+	while (queue->nextOpen < queue->numJobs)
+	{
+		job = &queue->jobs[queue->nextOpen];
+
+		// Only the main thread changes jobs past nextOpen.
+		if (job->state != PREFETCH_QUEUED)
+		{
+			// Already requested by the main thread.
+			queue->nextOpen++;
+			continue;
+		}
+
+		if (queue->numOpen >= MAX_PREFETCH_OPEN)
+		{
+			break;
+		}
+
+		job->size = FS_FOpenFile(job->name, &f, false);
+
+		if (job->size <= 0)
+		{
+			if (f)
+			{
+				FS_FCloseFile(f);
+			}
+
+			Sys_LockMutex(queue->mutex);
+			job->state = PREFETCH_FAILED;
+			queue->nextOpen++;
+			Sys_UnlockMutex(queue->mutex);
+			continue;
+		}
+
+		if (queue->bytes + job->size > limit)
+		{
+			// Leave the rest to FS_LoadFile().
+			FS_FCloseFile(f);
+			queue->nextOpen = queue->numJobs;
+			break;
+		}
+
+		handle = FS_GetFileByHandle(f);
+
+		job->protectedPak = file_from_protected_pak;
+		job->buffer = Z_Malloc(job->size);
+		job->file = handle->file;
+		job->zip = handle->zip;
+
+		// The job owns the file now.
+		memset(handle, 0, sizeof(*handle));
+
+		queue->bytes += job->size;
+
+		Sys_LockMutex(queue->mutex);
+		job->state = PREFETCH_OPEN;
+		queue->numOpen++;
+		queue->nextOpen++;
+		Sys_BroadcastCond(queue->cond);
+		Sys_UnlockMutex(queue->mutex);
+	}
+}
+
+static fsPrefetch_t *
+FS_FindPrefetch(const char *name)
+{
+	int i;
+	fsPrefetchQueue_t *queue = &fs_prefetchQueue;
+
+	i = queue->hashTable[Q_strhash(name, PREFETCH_HASH_SIZE)];
+
+	for ( ; i != -1; i = queue->jobs[i].hashNext)
+	{
+		if (Q_stricmp(queue->jobs[i].name, name) == 0)
+		{
+			return &queue->jobs[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns the prefetched file or -1, if the file
+ * wasn't prefetched. In that case the caller must
+ * load it itself.
+ */
+static int
+FS_TakePrefetch(const char *name, void **buffer)
+{
+	long long start;
+	fsPrefetch_t *job;
+	fsPrefetchState_t state;
+	fsPrefetchQueue_t *queue = &fs_prefetchQueue;
+
+	if ((job = FS_FindPrefetch(name)) == NULL)
+	{
+		return -1;
+	}
+
+	Sys_LockMutex(queue->mutex);
+
+	if (job->state == PREFETCH_OPEN)
+	{
+		// No worker got to it yet, read it ourself.
+		job->state = PREFETCH_READING;
+		Sys_UnlockMutex(queue->mutex);
+
+		state = FS_ReadPrefetch(job);
+		job->readTime = 0;
+
+		Sys_LockMutex(queue->mutex);
+		job->state = state;
+		queue->numOpen--;
+	}
+	else if (job->state == PREFETCH_READING)
+	{
+		start = Sys_Microseconds();
+
+		while (job->state == PREFETCH_READING)
+		{
+			Sys_WaitCond(queue->cond);
+		}
+
+		queue->waitTime += Sys_Microseconds() - start;
+	}
+
+	state = job->state;
+	job->state = PREFETCH_TAKEN;
+
+	Sys_UnlockMutex(queue->mutex);
+
+	if (state == PREFETCH_QUEUED)
+	{
+		return -1;
+	}
+
+	if (state != PREFETCH_DONE)
+	{
+		if (job->buffer)
+		{
+			queue->bytes -= job->size;
+			Z_Free(job->buffer);
+			job->buffer = NULL;
 		}
 
-		// Evil hack for maps.lst and players/
-		// TODO: A flag to ignore paks would be better
-		if ((strcmp(fs_gamedirvar->string, "") == 0) && search->pack) {
-			if ((strcmp(name, "maps.lst") == 0)|| (strncmp(name, "players/", 8) == 0)) {
-				continue;
-			}
-		}
+		return -1;
+	}
 
-		/* Search inside a pack file. */
-		if (search->pack)
-		{
-			pack = search->pack;
+	*buffer = job->buffer;
+	file_from_protected_pak = job->protectedPak;
 
-			for (i = 0; i < pack->numFiles; i++)
-			{
-				if (Q_stricmp(pack->files[i].name, handle->name) == 0)
-				{
-					/* Found it! */
-					if (fs_debug->value)
-					{
-						Com_Printf("FS_FOpenFile: '%s' (found in '%s').\n",
-						           handle->name, pack->name);
-					}
+	queue->bytes -= job->size;
+	queue->hits++;
+	queue->hitBytes += job->size;
+	queue->savedTime += job->readTime;
 
-					// save the name with *correct case* in the handle
-					// (relevant for savegames, when starting map with wrong case but it's still found
-					//  because it's from pak, but save/bla/MAPname.sav/sv2 will have wrong case and can't be found then)
-					Q_strlcpy(handle->name, pack->files[i].name, sizeof(handle->name));
+	job->buffer = NULL;
 
-					if (pack->pak)
-					{
-						/* PAK */
-						if (pack->isProtectedPak)
-						{
-							file_from_protected_pak = true;
-						}
+	return job->size;
+}
 
-						handle->file = Q_fopen(pack->name, "rb");
+/*
+ * Starts a new prefetch round, discarding what's
+ * left of the last one.
+ */
+void
+FS_BeginPrefetch(void)
+{
+	int i;
+	fsPrefetchQueue_t *queue = &fs_prefetchQueue;
 
-						if (handle->file)
-						{
-							fseek(handle->file, pack->files[i].offset, SEEK_SET);
-							return pack->files[i].size;
-						}
-					}
-					else if (pack->pk3)
-					{
-						/* PK3 */
-						if (pack->isProtectedPak)
-						{
-							file_from_protected_pak = true;
-						}
+	FS_EndPrefetch(false);
 
-#ifdef _WIN32
-						handle->zip = unzOpen2(pack->name, &zlib_file_api);
-#else
-						handle->zip = unzOpen(pack->name);
-#endif
+	if (!fs_prefetch->value)
+	{
+		return;
+	}
 
-						if (handle->zip)
-						{
-							if (unzLocateFile(handle->zip, handle->name, 2) == UNZ_OK)
-							{
-								if (unzOpenCurrentFile(handle->zip) == UNZ_OK)
-								{
-									return pack->files[i].size;
-								}
-							}
+	memset(queue, 0, sizeof(*queue));
 
-							unzClose(handle->zip);
-						}
-					}
+	for (i = 0; i < PREFETCH_HASH_SIZE; i++)
+	{
+		queue->hashTable[i] = -1;
+	}
 
-					Com_Error(ERR_FATAL, "Couldn't reopen '%s'", pack->name);
-				}
-			}
-		}
-		else
-		{
-			/* Search in a directory tree. */
-			Com_sprintf(path, sizeof(path), "%s/%s", search->path, handle->name);
+	// Leave one core to the main thread.
+	queue->numThreads = Sys_GetNumCPUs() - 1;
 
-			handle->file = Q_fopen(path, "rb");
+	if (queue->numThreads < 1)
+	{
+		queue->numThreads = 1;
+	}
+	else if (queue->numThreads > MAX_PREFETCH_THREADS)
+	{
+		queue->numThreads = MAX_PREFETCH_THREADS;
+	}
 
-			if (!handle->file)
-			{
-				Com_sprintf(lwrName, sizeof(lwrName), "%s", handle->name);
-				Q_strlwr(lwrName);
-				Com_sprintf(path, sizeof(path), "%s/%s", search->path, lwrName);
-				handle->file = Q_fopen(path, "rb");
-			}
+	queue->mutex = Sys_CreateMutex();
+	queue->cond = Sys_CreateCond(queue->mutex);
 
-			if (handle->file)
-			{
-				if (fs_debug->value)
-				{
-					Com_Printf("FS_FOpenFile: '%s' (found in '%s').\n",
-							   handle->name, search->path);
-				}
+	for (i = 0; i < queue->numThreads; i++)
+	{
+		queue->threads[i] = Sys_CreateThread(FS_PrefetchThread, queue, "FS Prefetch");
 
-				return FS_FileLength(handle->file);
-			}
+		if (!queue->threads[i])
+		{
+			break;
 		}
 	}
-	if (fs_debug->value)
+
+	queue->numThreads = i;
+
+	if (!queue->numThreads)
 	{
-		Com_Printf("FS_FOpenFile: couldn't find '%s'.\n", handle->name);
+		// Everything is loaded on demand then.
+		Sys_DestroyCond(queue->cond);
+		Sys_DestroyMutex(queue->mutex);
+		return;
 	}
 
-	/* Couldn't open, so free the handle. */
-	memset(handle, 0, sizeof(*handle));
-	*f = 0;
-	return -1;
+	queue->active = true;
 }
 
 /*
- * Properly handles partial reads.
+ * Queues a file for prefetching.
  */
-int
-FS_Read(void *buffer, int size, fileHandle_t f)
+void
+FS_Prefetch(const char *name)
 {
-	qboolean tried = false;    /* Tried to read from a CD. */
-	byte *buf;        /* Buffer. */
-	int r;         /* Number of bytes read. */
-	int remaining;        /* Remaining bytes. */
-	fsHandle_t *handle;  /* File handle. */
-
-	handle = FS_GetFileByHandle(f);
+	unsigned hash;
+	fsPrefetch_t *job;
+	fsPrefetchQueue_t *queue = &fs_prefetchQueue;
 
-	/* Read. */
-	remaining = size;
-	buf = (byte *)buffer;
+	if (!queue->active || (queue->numJobs == MAX_PREFETCH) || !name[0])
+	{
+		return;
+	}
 
-	while (remaining)
+	if (FS_FindPrefetch(name) != NULL)
 	{
-		if (handle->file)
-		{
-			r = fread(buf, 1, remaining, handle->file);
-		}
-		else if (handle->zip)
-		{
-			r = unzReadCurrentFile(handle->zip, buf, remaining);
-		}
-		else
-		{
-			return 0;
-		}
+		return;
+	}
 
-		if (r == 0)
-		{
-			if (!tried)
-			{
-				/* Might tried to read from a CD. */
-				tried = true;
-			}
-			else
-			{
-				/* Already tried once. */
-				Com_Error(ERR_FATAL, "FS_Read: 0 bytes read from '%s'", handle->name);
-				return size - remaining;
-			}
-		}
-		else if (r == -1)
-		{
-			Com_Error(ERR_FATAL, "FS_Read: -1 bytes read from '%s'", handle->name);
-		}
+	hash = Q_strhash(name, PREFETCH_HASH_SIZE);
 
-		remaining -= r;
-		buf += r;
-	}
+	job = &queue->jobs[queue->numJobs];
+	Q_strlcpy(job->name, name, sizeof(job->name));
+	job->hashNext = queue->hashTable[hash];
 
-	return size;
+	Sys_LockMutex(queue->mutex);
+	job->state = PREFETCH_QUEUED;
+	Sys_UnlockMutex(queue->mutex);
+
+	queue->hashTable[hash] = queue->numJobs++;
+
+	FS_PumpPrefetch();
 }
 
 /*
- * Properly handles partial reads of size up to count times. No error if it
- * can't read.
+ * Stops the workers and throws all unused buffers
+ * away. If report is set, the time saved is printed.
  */
-int
-FS_FRead(void *buffer, int size, int count, fileHandle_t f)
+void
+FS_EndPrefetch(qboolean report)
 {
-	qboolean tried = false;    /* Tried to read from a CD. */
-	byte *buf;        /* Buffer. */
-	int loops;         /* Loop indicator. */
-	int r;         /* Number of bytes read. */
-	int remaining;         /* Remaining bytes. */
-	fsHandle_t *handle;  /* File handle. */
+	int i;
+	int unused = 0;
+	fsPrefetch_t *job;
+	fsPrefetchQueue_t *queue = &fs_prefetchQueue;
 
-	handle = FS_GetFileByHandle(f);
+	if (!queue->active)
+	{
+		return;
+	}
 
-	/* Read. */
-	loops = count;
-	buf = (byte *)buffer;
+	Sys_LockMutex(queue->mutex);
+	queue->quit = true;
+	Sys_BroadcastCond(queue->cond);
+	Sys_UnlockMutex(queue->mutex);
 
-	while (loops)
+	for (i = 0; i < queue->numThreads; i++)
 	{
-		/* Read in chunks. */
-		remaining = size;
+		Sys_JoinThread(queue->threads[i]);
+	}
 
-		while (remaining)
-		{
-			if (handle->file)
-			{
-				r = fread(buf, 1, remaining, handle->file);
-			}
-			else if (handle->zip)
-			{
-				r = unzReadCurrentFile(handle->zip, buf, remaining);
-			}
-			else
-			{
-				return 0;
-			}
+	Sys_DestroyCond(queue->cond);
+	Sys_DestroyMutex(queue->mutex);
 
-			if (r == 0)
-			{
-				if (!tried)
-				{
-					/* Might tried to read from a CD. */
-					tried = true;
-				}
-				else
-				{
-					/* Already tried once. */
-					return size - remaining;
-				}
-			}
-			else if (r == -1)
-			{
-				Com_Error(ERR_FATAL,
-						"FS_FRead: -1 bytes read from '%s'",
-						handle->name);
-			}
+	for (i = 0; i < queue->numJobs; i++)
+	{
+		job = &queue->jobs[i];
 
-			remaining -= r;
-			buf += r;
+		if (job->file)
+		{
+			fclose(job->file);
+		}
+		else if (job->zip)
+		{
+			unzCloseCurrentFile(job->zip);
+			unzClose(job->zip);
 		}
 
-		loops--;
+		if (job->buffer)
+		{
+			Z_Free(job->buffer);
+			unused++;
+		}
 	}
 
-	return size;
+	if (report)
+	{
+		Com_Printf("Prefetched %i files (%i KB), %i unused. Saved ~%i ms, waited %i ms.\n",
+				queue->hits, queue->hitBytes / 1024, unused,
+				(int)((queue->savedTime - queue->waitTime) / 1000),
+				(int)(queue->waitTime / 1000));
+	}
+
+	queue->active = false;
 }
 
 /*
@@ -703,6 +1712,18 @@ FS_LoadFile(char *path, void **buffer)
 	fileHandle_t f; /* File handle. */
 
 	buf = NULL;
+
+	if (fs_prefetchQueue.active && buffer)
+	{
+		size = FS_TakePrefetch(path, buffer);
+		FS_PumpPrefetch();
+
+		if (size != -1)
+		{
+			return size;
+		}
+	}
+
 	size = FS_FOpenFile(path, &f, false);
 
 	if (size <= 0)
@@ -721,11 +1742,24 @@ FS_LoadFile(char *path, void **buffer)
 		return size;
 	}
 
+#ifdef FS_MMAP
+	if ((buf = FS_MapFile(FS_GetFileByHandle(f), size)) != NULL)
+	{
+		*buffer = buf;
+
+		FS_FCloseFile(f);
+		fs_stats.mapped++;
+
+		return size;
+	}
+#endif
+
 	buf = Z_Malloc(size);
 	*buffer = buf;
 
 	FS_Read(buf, size, f);
 	FS_FCloseFile(f);
+	fs_stats.copied++;
 
 	return size;
 }
@@ -739,6 +1773,13 @@ FS_FreeFile(void *buffer)
 		return;
 	}
 
+#ifdef FS_MMAP
+	if (FS_UnmapFile(buffer))
+	{
+		return;
+	}
+#endif
+
 	Z_Free(buffer);
 }
 
@@ -762,6 +1803,8 @@ fsSearchPath_t *FS_FreeSearchPaths(fsSearchPath_t *start, fsSearchPath_t *end)
 	fsSearchPath_t *cur = start;
 	fsSearchPath_t *next;
 
+	FS_InvalidateIndex();
+
 	while (cur != end)
 	{
 		if (cur->pack)
@@ -776,6 +1819,7 @@ fsSearchPath_t *FS_FreeSearchPaths(fsSearchPath_t *start, fsSearchPath_t *end)
 				unzClose(cur->pack->pk3);
 			}
 
+			Z_Free(cur->pack->hashTable);
 			Z_Free(cur->pack->files);
 			Z_Free(cur->pack);
 		}
@@ -856,6 +1900,7 @@ FS_LoadPAK(const char *packPath)
 		Q_strlcpy(files[i].name, info[i].name, sizeof(files[i].name));
 		files[i].offset = LittleLong(info[i].filepos);
 		files[i].size = LittleLong(info[i].filelen);
+		files[i].stored = true;
 	}
 	free(info);
 
@@ -866,6 +1911,8 @@ FS_LoadPAK(const char *packPath)
 	pack->numFiles = numFiles;
 	pack->files = files;
 
+	FS_HashPack(pack);
+
 	Com_Printf("Added packfile '%s' (%i files).\n", pack->name, numFiles);
 
 	return pack;
@@ -927,8 +1974,14 @@ FS_LoadPK3(const char *packPath)
 		unzGetCurrentFileInfo(handle, &info, fileName, MAX_QPATH,
 				NULL, 0, NULL, 0);
 		Q_strlcpy(files[i].name, fileName, sizeof(files[i].name));
-		files[i].offset = -1; /* Not used in ZIP files */
+		files[i].offset = -1; /* Located at first access. */
 		files[i].size = info.uncompressed_size;
+		files[i].zipPos = unzGetOffset(handle);
+
+		/* Method 0 is stored, bit 0 of the flags marks
+		   encrypted entries. */
+		files[i].stored = (info.compression_method == 0) && !(info.flag & 1) &&
+			(info.compressed_size == info.uncompressed_size);
 		i++;
 		status = unzGoToNextFile(handle);
 	}
@@ -940,6 +1993,8 @@ FS_LoadPK3(const char *packPath)
 	pack->numFiles = numFiles;
 	pack->files = files;
 
+	FS_HashPack(pack);
+
 	Com_Printf("Added packfile '%s' (%i files).\n", pack->name, numFiles);
 
 	return pack;
@@ -1024,6 +2079,38 @@ FS_Path_f(void)
 	Com_Printf("%i files in PAK/PK2/PK3/ZIP files.\n", totalFiles);
 }
 
+/*
+ * Prints lookup statistics, "fs_stats reset" clears them.
+ */
+void
+FS_Stats_f(void)
+{
+	if ((Cmd_Argc() == 2) && (Q_stricmp(Cmd_Argv(1), "reset") == 0))
+	{
+		memset(&fs_stats, 0, sizeof(fs_stats));
+		return;
+	}
+
+	Com_Printf("%u lookups, %u hash probes, %u misses (%u cached).\n",
+			fs_stats.lookups, fs_stats.probes, fs_stats.misses,
+			fs_stats.cachedMisses);
+
+	if (fs_stats.lookups)
+	{
+		Com_Printf("%.2f probes per lookup.\n",
+				(float)fs_stats.probes / fs_stats.lookups);
+	}
+
+	Com_Printf("%u files loaded from mapped packs, %u copied.\n",
+			fs_stats.mapped, fs_stats.copied);
+	Com_Printf("%i files in the merged pack index.\n", fs_index.numEntries);
+	Com_Printf("%i files in the missing file cache.\n", fs_numMissing);
+	Com_Printf("%i files prefetched (%i KB), saved ~%i ms, waited %i ms.\n",
+			fs_prefetchQueue.hits, fs_prefetchQueue.hitBytes / 1024,
+			(int)((fs_prefetchQueue.savedTime - fs_prefetchQueue.waitTime) / 1000),
+			(int)(fs_prefetchQueue.waitTime / 1000));
+}
+
 /*
  * Creates a filelink_t.
  */
@@ -1587,6 +2674,8 @@ FS_AddPAKFromGamedir(const char *pak)
 			search->next = fs_searchPaths;
 			fs_searchPaths = search;
 
+			FS_BuildIndex();
+
 			return true;
 		}
 	}
@@ -1655,6 +2744,10 @@ FS_AddDirToSearchPath(char *dir, qboolean create) {
 		dir[len - 1] = '\0';
 	}
 
+	// The merged index is rebuilt once the
+	// search path is complete.
+	FS_InvalidateIndex();
+
 	// Set the current directory as game directory. This
 	// is somewhat fragile since the game directory MUST
 	// be the last directory added to the search path.
@@ -1809,6 +2902,8 @@ void FS_BuildGenericSearchPath(void) {
 	// distinguish generic and specialized directories.
 	fs_baseSearchPaths = fs_searchPaths;
 
+	FS_BuildIndex();
+
 	// We need to create the game directory.
 	Sys_Mkdir(fs_gamedir);
 
@@ -1903,6 +2998,8 @@ FS_BuildGameSpecificSearchPath(char *dir)
 		}
 	}
 
+	FS_BuildIndex();
+
 	// Create the game directory.
 	Sys_Mkdir(fs_gamedir);
 
@@ -2069,12 +3166,16 @@ FS_InitFilesystem(void)
 	Cmd_AddCommand("path", FS_Path_f);
 	Cmd_AddCommand("link", FS_Link_f);
 	Cmd_AddCommand("dir", FS_Dir_f);
+	Cmd_AddCommand("fs_stats", FS_Stats_f);
 
 	// Register cvars
 	fs_basedir = Cvar_Get("basedir", ".", CVAR_NOSET);
 	fs_cddir = Cvar_Get("cddir", "", CVAR_NOSET);
 	fs_gamedirvar = Cvar_Get("game", "", CVAR_LATCH | CVAR_SERVERINFO);
 	fs_debug = Cvar_Get("fs_debug", "0", 0);
+	fs_mmap = Cvar_Get("fs_mmap", "1", 0);
+	fs_prefetch = Cvar_Get("fs_prefetch", "1", CVAR_ARCHIVE);
+	fs_prefetchsize = Cvar_Get("fs_prefetchsize", "64", CVAR_ARCHIVE);
 
 	// Deprecation warning, can be removed at a later time.
 	if (strcmp(fs_basedir->string, ".") != 0)
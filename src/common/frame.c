@@ -37,7 +37,6 @@ cvar_t *dedicated;
 
 extern cvar_t *logfile_active;
 extern jmp_buf abortframe; /* an ERR_DROP occured, exit the entire frame */
-extern zhead_t z_chain;
 
 #ifndef DEDICATED_ONLY
 FILE *log_stats_file;
@@ -297,9 +296,6 @@ Qcommon_Init(int argc, char **argv)
 	// Seed PRNG
 	randk_seed();
 
-	// Initialize zone malloc().
-	z_chain.next = z_chain.prev = &z_chain;
-
 	// Start early subsystems.
 	COM_InitArgv(argc, argv);
 	Swap_Init();
@@ -339,6 +335,9 @@ Qcommon_Init(int argc, char **argv)
 
 	// Zone malloc statistics.
 	Cmd_AddCommand("z_stats", Z_Stats_f);
+	Cmd_AddCommand("memstats", Mem_Stats_f);
+
+	CM_Init();
 
 	// cvars
 
@@ -519,12 +518,16 @@ Qcommon_Frame(int usec)
 
 	if (showtrace->value)
 	{
-		extern int c_traces, c_brush_traces;
+		extern int c_traces, c_brush_traces, c_brush_rejects;
 		extern int c_pointcontents;
 
-		Com_Printf("%4i traces  %4i points\n", c_traces, c_pointcontents);
+		Com_Printf("%4i traces  %4i points  %4i brushes  %3i%% rejected\n",
+				c_traces, c_pointcontents, c_brush_traces,
+				(c_brush_traces + c_brush_rejects) ?
+				100 * c_brush_rejects / (c_brush_traces + c_brush_rejects) : 0);
 		c_traces = 0;
 		c_brush_traces = 0;
+		c_brush_rejects = 0;
 		c_pointcontents = 0;
 	}
 
@@ -702,6 +705,10 @@ Qcommon_Frame(int usec)
 
 
 	// Reset deltas and mark frame.
+	if (packetframe || renderframe) {
+		Cvar_EndFrame();
+	}
+
 	if (packetframe) {
 		packetdelta = 0;
 	}
@@ -797,6 +804,8 @@ Qcommon_Frame(int usec)
 
 		// Reset deltas if necessary.
 		packetdelta = 0;
+
+		Cvar_EndFrame();
 	}
 }
 #endif
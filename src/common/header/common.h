@@ -63,10 +63,12 @@ typedef struct sizebuf_s
 {
 	qboolean allowoverflow;     /* if false, do a Com_Error */
 	qboolean overflowed;        /* set to true if the buffer size failed */
+	qboolean quietoverflow;     /* the owner reports the overflow */
 	byte *data;
 	int maxsize;
 	int cursize;
 	int readcount;
+	int bitpos; /* next bit for MSG_WriteBits() or MSG_ReadBits() */
 } sizebuf_t;
 
 void SZ_Init(sizebuf_t *buf, byte *data, int length);
@@ -96,6 +98,12 @@ void MSG_WriteDeltaEntity(struct entity_state_s *from,
 		struct entity_state_s *to, sizebuf_t *msg,
 		qboolean force, qboolean newentity);
 void MSG_WriteDir(sizebuf_t *sb, vec3_t vector);
+void MSG_WriteBits(sizebuf_t *sb, int value, int bits);
+int MSG_WritePackedDeltaEntity(struct entity_state_s *from,
+		struct entity_state_s *to, sizebuf_t *msg,
+		qboolean force, qboolean newentity, int lastnumber);
+void MSG_WritePackedRemove(sizebuf_t *msg, int number, int lastnumber);
+void MSG_WritePackedEnd(sizebuf_t *msg);
 
 void MSG_BeginReading(sizebuf_t *sb);
 
@@ -118,6 +126,13 @@ void MSG_ReadDeltaUsercmd(sizebuf_t *sb,
 void MSG_ReadDir(sizebuf_t *sb, vec3_t vector);
 
 void MSG_ReadData(sizebuf_t *sb, void *buffer, int size);
+int MSG_ReadBits(sizebuf_t *sb, int bits);
+int MSG_ReadEntityBits(sizebuf_t *sb, unsigned *bits);
+void MSG_ReadDeltaEntity(sizebuf_t *sb, struct entity_state_s *from,
+		struct entity_state_s *to, int number, unsigned bits);
+int MSG_ReadPackedEntityBits(sizebuf_t *sb, unsigned *bits, int lastnumber);
+void MSG_ReadPackedDeltaEntity(sizebuf_t *sb, struct entity_state_s *from,
+		struct entity_state_s *to, int number, unsigned bits);
 
 /* ================================================================== */
 
@@ -189,7 +204,8 @@ enum svc_ops_e
 	svc_playerinfo,             /* variable */
 	svc_packetentities,         /* [...] */
 	svc_deltapacketentities,    /* [...] */
-	svc_frame
+	svc_frame,
+	svc_packedentities          /* bit packed, if the client asked for it */
 };
 
 /* ============================================== */
@@ -372,6 +388,10 @@ void Cmd_RemoveCommand(char *cmd_name);
 
 qboolean Cmd_Exists(char *cmd_name);
 
+/* drops the sorted completion index after a command, alias or cvar
+   was added or removed */
+void Cmd_InvalidateCompletion(void);
+
 /* used by the cvar code to check for cvar / command name overlap */
 
 char *Cmd_CompleteCommand(char *partial);
@@ -474,6 +494,9 @@ void Cvar_Init(void);
 
 void Cvar_Fini(void);
 
+/* closes the lookup statistics of a frame */
+void Cvar_EndFrame(void);
+
 char *Cvar_Userinfo(void);
 
 /* returns an info string containing all the CVAR_USERINFO cvars */
@@ -589,12 +612,17 @@ qboolean Netchan_CanReliable(netchan_t *chan);
 
 #include "files.h"
 
+/* registers the collision cvars and commands */
+void CM_Init(void);
+
 cmodel_t *CM_LoadMap(char *name, qboolean clientload, unsigned *checksum);
 cmodel_t *CM_InlineModel(char *name);       /* *1, *2, etc */
 
 int CM_NumClusters(void);
 int CM_NumInlineModels(void);
 char *CM_EntityString(void);
+int CM_NumTexinfo(void);
+const char *CM_TexinfoName(int i);
 
 /* creates a clipping hull for an arbitrary box */
 int CM_HeadnodeForBox(vec3_t mins, vec3_t maxs);
@@ -610,16 +638,38 @@ trace_t CM_TransformedBoxTrace(vec3_t start, vec3_t end,
 		vec3_t mins, vec3_t maxs, int headnode,
 		int brushmask, vec3_t origin, vec3_t angles);
 
-byte *CM_ClusterPVS(int cluster);
-byte *CM_ClusterPHS(int cluster);
+/* per thread trace state, for tracing outside the main
+   thread. NULL selects the context of the main thread */
+typedef struct cmtrace_s cmtrace_t;
+
+cmtrace_t *CM_CreateTraceContext(void);
+void CM_FreeTraceContext(cmtrace_t *tc);
+int CM_HeadnodeForBoxContext(cmtrace_t *tc, vec3_t mins, vec3_t maxs);
+trace_t CM_BoxTraceContext(cmtrace_t *tc, vec3_t start, vec3_t end,
+		vec3_t mins, vec3_t maxs, int headnode, int brushmask);
+trace_t CM_TransformedBoxTraceContext(cmtrace_t *tc, vec3_t start,
+		vec3_t end, vec3_t mins, vec3_t maxs, int headnode,
+		int brushmask, vec3_t origin, vec3_t angles);
+
+const byte *CM_ClusterPVS(int cluster);
+const byte *CM_ClusterPHS(int cluster);
+qboolean CM_VisExpanded(void); /* rows are safe to read from threads */
+
+/* vis rows and point lookups returned before
+   may be reused after this */
+void CM_NewFrame(void);
 
 int CM_PointLeafnum(vec3_t p);
+int CM_PointLeafnumHint(vec3_t p, int hint); /* hint: last leaf */
 
 /* call with topnode set to the headnode, returns with topnode */
 /* set to the first node that splits the box */
 int CM_BoxLeafnums(vec3_t mins, vec3_t maxs, int *list,
 		int listsize, int *topnode);
 
+int CM_BoxLeafnumsHint(vec3_t mins, vec3_t maxs, int *list,
+		int listsize, int *topnode, int hint); /* hint: last topnode */
+
 int CM_LeafContents(int leafnum);
 int CM_LeafCluster(int leafnum);
 int CM_LeafArea(int leafnum);
@@ -699,6 +749,10 @@ char **FS_ListMods(int *nummods);
 
 void FS_FreeFile(void *buffer);
 void FS_CreatePath(char *path);
+void FS_FlushMissingCache(void);
+void FS_BeginPrefetch(void);
+void FS_Prefetch(const char *name);
+void FS_EndPrefetch(qboolean report);
 
 /* MISC */
 
@@ -781,6 +835,26 @@ void *Z_Malloc(int size);           /* returns 0 filled memory */
 void *Z_TagMalloc(int size, int tag);
 void Z_FreeTags(int tag);
 
+#define Z_TAG_SOUND 1  /* sound cache, accounted as MEM_SOUND */
+#define Z_TAG_COLLISION 2  /* collision model, accounted as MEM_COLLISION */
+
+/* Memory accounting, see "memstats". */
+typedef enum
+{
+	MEM_ZONE,
+	MEM_SOUND,
+	MEM_HUNK,
+	MEM_IMAGES,
+	MEM_SURFCACHE,
+	MEM_CLIENT,
+	MEM_COLLISION,
+
+	MEM_NUM_SUBSYSTEMS
+} memsubsystem_t;
+
+void Mem_Account(memsubsystem_t subsystem, int bytes);
+void Mem_Stats_f(void);
+
 void Qcommon_Init(int argc, char **argv);
 void Qcommon_ExecConfigs(qboolean addEarlyCmds);
 const char* Qcommon_GetInitialGame(void);
@@ -830,6 +904,27 @@ void Sys_GetWorkDir(char *buffer, size_t len);
 qboolean Sys_SetWorkDir(char *path);
 qboolean Sys_Realpath(const char *in, char *out, size_t size);
 
+// Threads, mutexes and condition variables (system.c).
+// A condition variable is bound to the mutex given at
+// creation, Sys_WaitCond() must be called with that
+// mutex locked. Sys_CreateThread() returns NULL if the
+// thread couldn't be created.
+typedef struct qthread_s qthread_t;
+typedef struct qmutex_s qmutex_t;
+typedef struct qcond_s qcond_t;
+
+qthread_t *Sys_CreateThread(void (*func)(void *), void *data, const char *name);
+void Sys_JoinThread(qthread_t *thread);
+qmutex_t *Sys_CreateMutex(void);
+void Sys_DestroyMutex(qmutex_t *mutex);
+void Sys_LockMutex(qmutex_t *mutex);
+void Sys_UnlockMutex(qmutex_t *mutex);
+qcond_t *Sys_CreateCond(qmutex_t *mutex);
+void Sys_DestroyCond(qcond_t *cond);
+void Sys_WaitCond(qcond_t *cond);
+void Sys_BroadcastCond(qcond_t *cond);
+int Sys_GetNumCPUs(void);
+
 // Windows only (system.c)
 #ifdef _WIN32
 void Sys_RedirectStdout(void);
@@ -313,6 +313,9 @@ int Q_stricmp(const char *s1, const char *s2);
 int Q_strcasecmp(char *s1, char *s2);
 int Q_strncasecmp(char *s1, char *s2, int n);
 
+/* case insensitive hash, size must be a power of two */
+unsigned Q_strhash(const char *s, unsigned size);
+
 /* portable string lowercase */
 char *Q_strlwr(char *s);
 
@@ -428,6 +431,7 @@ typedef struct cvar_s
 
 	/* Added by YQ2. Must be at the end to preserve ABI. */
 	char *default_string;
+	struct cvar_s *hashNext;
 } cvar_t;
 
 #endif /* CVAR */
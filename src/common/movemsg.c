@@ -425,14 +425,11 @@ MSG_ReadDir(sizebuf_t *sb, vec3_t dir)
 }
 
 /*
- * Writes part of a packetentities message.
- * Can delta from either a baseline or a previous packet_entity
+ * Returns the U_* bits of the fields that
+ * differ, without the U_MOREBITS* bits
  */
-void
-MSG_WriteDeltaEntity(entity_state_t *from,
-		entity_state_t *to,
-		sizebuf_t *msg,
-		qboolean force,
+static int
+MSG_DeltaEntityBits(entity_state_t *from, entity_state_t *to,
 		qboolean newentity)
 {
 	int bits;
@@ -593,6 +590,24 @@ MSG_WriteDeltaEntity(entity_state_t *from,
 		bits |= U_OLDORIGIN;
 	}
 
+	return bits;
+}
+
+/*
+ * Writes part of a packetentities message.
+ * Can delta from either a baseline or a previous packet_entity
+ */
+void
+MSG_WriteDeltaEntity(entity_state_t *from,
+		entity_state_t *to,
+		sizebuf_t *msg,
+		qboolean force,
+		qboolean newentity)
+{
+	int bits;
+
+	bits = MSG_DeltaEntityBits(from, to, newentity);
+
 	/* write the message */
 	if (!bits && !force)
 	{
@@ -772,10 +787,376 @@ MSG_WriteDeltaEntity(entity_state_t *from,
 	}
 }
 
+/*
+ * Appends the low bits of value to the message, least
+ * significant bit first. Bytes written in between start
+ * a new byte, the next MSG_WriteBits() call as well.
+ */
+void
+MSG_WriteBits(sizebuf_t *sb, int value, int bits)
+{
+	unsigned v = value;
+	int pos, n;
+	byte *b;
+
+	pos = sb->bitpos;
+
+	/* continue in the last byte only if it's partial */
+	if (((pos + 7) >> 3) != sb->cursize)
+	{
+		pos = sb->cursize << 3;
+	}
+
+	while (bits > 0)
+	{
+		if (!(pos & 7))
+		{
+			b = SZ_GetSpace(sb, 1);
+			*b = 0;
+			pos = (sb->cursize - 1) << 3;
+		}
+
+		n = 8 - (pos & 7);
+
+		if (n > bits)
+		{
+			n = bits;
+		}
+
+		sb->data[pos >> 3] |= (v & ((1 << n) - 1)) << (pos & 7);
+
+		v >>= n;
+		pos += n;
+		bits -= n;
+	}
+
+	sb->bitpos = pos;
+}
+
+/*
+ * The bit packed entity format, used instead of the byte
+ * aligned one for clients that asked for it:
+ *
+ * number:  1                 next entity after the last one
+ *          01 + 4 bits       2 to 17 entities after the last one
+ *          00 + 10 bits      absolute, 0 ends the list
+ * remove:  1 bit
+ * fields:  6 bits of common fields, 1 bit if rare fields follow,
+ *          12 bits of rare fields, in the order of packedbits
+ *
+ * Coordinates are deltas from the old value in 1/8 units, 5, 8 or
+ * 11 bits with a 2 bit size, or an absolute 16 bit value. The old
+ * origin is relative to the new origin. Frames are 1 bit if they
+ * advanced by one, skin, effects and renderfx have a 2 bit size.
+ */
+#define PACKED_NUMBER_BITS 10
+#define PACKED_COMMON_BITS 6
+
+static const int packedbits[] = {
+	U_ORIGIN1, U_ORIGIN2, U_ORIGIN3, U_ANGLE2, U_FRAME8, U_EVENT,
+	U_ANGLE1, U_ANGLE3, U_MODEL, U_MODEL2, U_MODEL3, U_MODEL4,
+	U_SKIN8, U_EFFECTS8, U_RENDERFX8, U_OLDORIGIN, U_SOUND, U_SOLID
+};
+
+/* coordinate in 1/8 units, as MSG_WriteCoord() sends it */
+static int
+MSG_PackedCoord(float f)
+{
+	return (short)(int)(f * 8);
+}
+
+static void
+MSG_WritePackedNumber(sizebuf_t *sb, int number, int lastnumber)
+{
+	int gap;
+
+	gap = number - lastnumber;
+
+	if (gap == 1)
+	{
+		MSG_WriteBits(sb, 1, 1);
+	}
+	else if ((gap >= 2) && (gap < 18))
+	{
+		MSG_WriteBits(sb, 2, 2);
+		MSG_WriteBits(sb, gap - 2, 4);
+	}
+	else
+	{
+		MSG_WriteBits(sb, 0, 2);
+		MSG_WriteBits(sb, number, PACKED_NUMBER_BITS);
+	}
+}
+
+static void
+MSG_WritePackedDelta(sizebuf_t *sb, int from, int to)
+{
+	int delta;
+
+	delta = (short)(to - from);
+
+	if ((delta >= -16) && (delta < 16))
+	{
+		MSG_WriteBits(sb, 0, 2);
+		MSG_WriteBits(sb, delta, 5);
+	}
+	else if ((delta >= -128) && (delta < 128))
+	{
+		MSG_WriteBits(sb, 1, 2);
+		MSG_WriteBits(sb, delta, 8);
+	}
+	else if ((delta >= -1024) && (delta < 1024))
+	{
+		MSG_WriteBits(sb, 2, 2);
+		MSG_WriteBits(sb, delta, 11);
+	}
+	else
+	{
+		MSG_WriteBits(sb, 3, 2);
+		MSG_WriteBits(sb, to, 16);
+	}
+}
+
+/*
+ * Returns the size MSG_WriteDeltaEntity() would send a skin,
+ * effects or renderfx value with: 1 for a byte, 2 for a short
+ * and 3 for a long.
+ */
+static int
+MSG_PackedValueSize(int bits, int bit8, int bit16)
+{
+	return ((bits & bit8) ? 1 : 0) | ((bits & bit16) ? 2 : 0);
+}
+
+/*
+ * The value is truncated to the given size, so it decodes
+ * to the same as the byte aligned one.
+ */
+static void
+MSG_WritePackedValue(sizebuf_t *sb, unsigned value, int size)
+{
+	if (!value)
+	{
+		MSG_WriteBits(sb, 0, 2);
+	}
+	else if (size == 1)
+	{
+		MSG_WriteBits(sb, 1, 2);
+		MSG_WriteBits(sb, value, 8);
+	}
+	else if (size == 2)
+	{
+		MSG_WriteBits(sb, 2, 2);
+		MSG_WriteBits(sb, value, 16);
+	}
+	else
+	{
+		MSG_WriteBits(sb, 3, 2);
+		MSG_WriteBits(sb, value, 32);
+	}
+}
+
+/*
+ * The bit packed version of MSG_WriteDeltaEntity().
+ * Returns to->number if anything was written and
+ * lastnumber otherwise.
+ */
+int
+MSG_WritePackedDeltaEntity(entity_state_t *from, entity_state_t *to,
+		sizebuf_t *msg, qboolean force, qboolean newentity, int lastnumber)
+{
+	int bits, i, numbits;
+	int skinsize, effectssize, renderfxsize;
+
+	bits = MSG_DeltaEntityBits(from, to, newentity) & ~U_NUMBER16;
+
+	if (!bits && !force)
+	{
+		return lastnumber; /* nothing to send! */
+	}
+
+	skinsize = MSG_PackedValueSize(bits, U_SKIN8, U_SKIN16);
+	effectssize = MSG_PackedValueSize(bits, U_EFFECTS8, U_EFFECTS16);
+	renderfxsize = MSG_PackedValueSize(bits, U_RENDERFX8, U_RENDERFX16);
+
+	MSG_WritePackedNumber(msg, to->number, lastnumber);
+	MSG_WriteBits(msg, 0, 1); /* not removed */
+
+	/* the size of frame, skin, effects
+	   and renderfx is sent with the value */
+	if (bits & U_FRAME16)
+	{
+		bits |= U_FRAME8;
+	}
+
+	if (bits & U_SKIN16)
+	{
+		bits |= U_SKIN8;
+	}
+
+	if (bits & U_EFFECTS16)
+	{
+		bits |= U_EFFECTS8;
+	}
+
+	if (bits & U_RENDERFX16)
+	{
+		bits |= U_RENDERFX8;
+	}
+
+	numbits = sizeof(packedbits) / sizeof(packedbits[0]);
+
+	for (i = 0; i < numbits; i++)
+	{
+		if (i == PACKED_COMMON_BITS)
+		{
+			if (!(bits & ~(U_ORIGIN1 | U_ORIGIN2 | U_ORIGIN3 |
+						   U_ANGLE2 | U_FRAME8 | U_FRAME16 | U_EVENT)))
+			{
+				MSG_WriteBits(msg, 0, 1);
+				break;
+			}
+
+			MSG_WriteBits(msg, 1, 1);
+		}
+
+		MSG_WriteBits(msg, (bits & packedbits[i]) != 0, 1);
+	}
+
+	for (i = 0; i < 3; i++)
+	{
+		if (bits & packedbits[i])
+		{
+			MSG_WritePackedDelta(msg, MSG_PackedCoord(from->origin[i]),
+					MSG_PackedCoord(to->origin[i]));
+		}
+	}
+
+	if (bits & U_ANGLE1)
+	{
+		MSG_WriteBits(msg, (int)(to->angles[0] * 256 / 360), 8);
+	}
+
+	if (bits & U_ANGLE2)
+	{
+		MSG_WriteBits(msg, (int)(to->angles[1] * 256 / 360), 8);
+	}
+
+	if (bits & U_ANGLE3)
+	{
+		MSG_WriteBits(msg, (int)(to->angles[2] * 256 / 360), 8);
+	}
+
+	if (bits & U_FRAME8)
+	{
+		if (to->frame == from->frame + 1)
+		{
+			MSG_WriteBits(msg, 1, 1);
+		}
+		else if (to->frame < 256)
+		{
+			MSG_WriteBits(msg, 0, 2);
+			MSG_WriteBits(msg, to->frame, 8);
+		}
+		else
+		{
+			MSG_WriteBits(msg, 2, 2);
+			MSG_WriteBits(msg, to->frame, 16);
+		}
+	}
+
+	if (bits & U_EVENT)
+	{
+		if (to->event < 7)
+		{
+			MSG_WriteBits(msg, to->event, 3);
+		}
+		else
+		{
+			MSG_WriteBits(msg, 7, 3);
+			MSG_WriteBits(msg, to->event, 8);
+		}
+	}
+
+	if (bits & U_MODEL)
+	{
+		MSG_WriteBits(msg, to->modelindex, 8);
+	}
+
+	if (bits & U_MODEL2)
+	{
+		MSG_WriteBits(msg, to->modelindex2, 8);
+	}
+
+	if (bits & U_MODEL3)
+	{
+		MSG_WriteBits(msg, to->modelindex3, 8);
+	}
+
+	if (bits & U_MODEL4)
+	{
+		MSG_WriteBits(msg, to->modelindex4, 8);
+	}
+
+	if (bits & U_SKIN8)
+	{
+		MSG_WritePackedValue(msg, to->skinnum, skinsize);
+	}
+
+	if (bits & U_EFFECTS8)
+	{
+		MSG_WritePackedValue(msg, to->effects, effectssize);
+	}
+
+	if (bits & U_RENDERFX8)
+	{
+		MSG_WritePackedValue(msg, to->renderfx, renderfxsize);
+	}
+
+	if (bits & U_OLDORIGIN)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			MSG_WritePackedDelta(msg, MSG_PackedCoord(to->origin[i]),
+					MSG_PackedCoord(to->old_origin[i]));
+		}
+	}
+
+	if (bits & U_SOUND)
+	{
+		MSG_WriteBits(msg, to->sound, 8);
+	}
+
+	if (bits & U_SOLID)
+	{
+		MSG_WriteBits(msg, to->solid, 16);
+	}
+
+	return to->number;
+}
+
+/*
+ * Tells the client that the entity
+ * isn't present in the new frame
+ */
+void
+MSG_WritePackedRemove(sizebuf_t *msg, int number, int lastnumber)
+{
+	MSG_WritePackedNumber(msg, number, lastnumber);
+	MSG_WriteBits(msg, 1, 1);
+}
+
+void
+MSG_WritePackedEnd(sizebuf_t *msg)
+{
+	MSG_WritePackedNumber(msg, 0, 0);
+}
+
 void
 MSG_BeginReading(sizebuf_t *msg)
 {
 	msg->readcount = 0;
+	msg->bitpos = 0;
 }
 
 int
@@ -1042,3 +1423,450 @@ MSG_ReadData(sizebuf_t *msg_read, void *data, int len)
 	}
 }
 
+/*
+ * Reads bits written by MSG_WriteBits(). Bytes read
+ * in between start a new byte, the next call as well.
+ */
+int
+MSG_ReadBits(sizebuf_t *msg_read, int bits)
+{
+	unsigned value;
+	int pos, n, shift;
+
+	pos = msg_read->bitpos;
+
+	/* continue in the last byte only if it's partial */
+	if (((pos + 7) >> 3) != msg_read->readcount)
+	{
+		pos = msg_read->readcount << 3;
+	}
+
+	value = 0;
+	shift = 0;
+
+	while (bits > 0)
+	{
+		if (!(pos & 7))
+		{
+			if (msg_read->readcount + 1 > msg_read->cursize)
+			{
+				msg_read->readcount++;
+				return -1;
+			}
+
+			msg_read->readcount++;
+		}
+
+		n = 8 - (pos & 7);
+
+		if (n > bits)
+		{
+			n = bits;
+		}
+
+		value |= ((msg_read->data[pos >> 3] >> (pos & 7)) &
+				((1 << n) - 1)) << shift;
+
+		shift += n;
+		pos += n;
+		bits -= n;
+	}
+
+	msg_read->bitpos = pos;
+
+	return value;
+}
+
+/*
+ * Returns the entity number and the header
+ * bits of an entity in a packetentities message
+ */
+int
+MSG_ReadEntityBits(sizebuf_t *msg_read, unsigned *bits)
+{
+	unsigned b, total;
+
+	total = MSG_ReadByte(msg_read);
+
+	if (total & U_MOREBITS1)
+	{
+		b = MSG_ReadByte(msg_read);
+		total |= b << 8;
+	}
+
+	if (total & U_MOREBITS2)
+	{
+		b = MSG_ReadByte(msg_read);
+		total |= b << 16;
+	}
+
+	if (total & U_MOREBITS3)
+	{
+		b = MSG_ReadByte(msg_read);
+		total |= b << 24;
+	}
+
+	*bits = total;
+
+	if (total & U_NUMBER16)
+	{
+		return MSG_ReadShort(msg_read);
+	}
+
+	return MSG_ReadByte(msg_read);
+}
+
+/*
+ * Can go from either a baseline or a previous packet_entity
+ */
+void
+MSG_ReadDeltaEntity(sizebuf_t *msg_read, entity_state_t *from,
+		entity_state_t *to, int number, unsigned bits)
+{
+	/* set everything to the state we are delta'ing from */
+	*to = *from;
+
+	VectorCopy(from->origin, to->old_origin);
+	to->number = number;
+
+	if (bits & U_MODEL)
+	{
+		to->modelindex = MSG_ReadByte(msg_read);
+	}
+
+	if (bits & U_MODEL2)
+	{
+		to->modelindex2 = MSG_ReadByte(msg_read);
+	}
+
+	if (bits & U_MODEL3)
+	{
+		to->modelindex3 = MSG_ReadByte(msg_read);
+	}
+
+	if (bits & U_MODEL4)
+	{
+		to->modelindex4 = MSG_ReadByte(msg_read);
+	}
+
+	if (bits & U_FRAME8)
+	{
+		to->frame = MSG_ReadByte(msg_read);
+	}
+
+	if (bits & U_FRAME16)
+	{
+		to->frame = MSG_ReadShort(msg_read);
+	}
+
+	/* used for laser colors */
+	if ((bits & U_SKIN8) && (bits & U_SKIN16))
+	{
+		to->skinnum = MSG_ReadLong(msg_read);
+	}
+	else if (bits & U_SKIN8)
+	{
+		to->skinnum = MSG_ReadByte(msg_read);
+	}
+	else if (bits & U_SKIN16)
+	{
+		to->skinnum = MSG_ReadShort(msg_read);
+	}
+
+	if ((bits & (U_EFFECTS8 | U_EFFECTS16)) == (U_EFFECTS8 | U_EFFECTS16))
+	{
+		to->effects = MSG_ReadLong(msg_read);
+	}
+	else if (bits & U_EFFECTS8)
+	{
+		to->effects = MSG_ReadByte(msg_read);
+	}
+	else if (bits & U_EFFECTS16)
+	{
+		to->effects = MSG_ReadShort(msg_read);
+	}
+
+	if ((bits & (U_RENDERFX8 | U_RENDERFX16)) == (U_RENDERFX8 | U_RENDERFX16))
+	{
+		to->renderfx = MSG_ReadLong(msg_read);
+	}
+	else if (bits & U_RENDERFX8)
+	{
+		to->renderfx = MSG_ReadByte(msg_read);
+	}
+	else if (bits & U_RENDERFX16)
+	{
+		to->renderfx = MSG_ReadShort(msg_read);
+	}
+
+	if (bits & U_ORIGIN1)
+	{
+		to->origin[0] = MSG_ReadCoord(msg_read);
+	}
+
+	if (bits & U_ORIGIN2)
+	{
+		to->origin[1] = MSG_ReadCoord(msg_read);
+	}
+
+	if (bits & U_ORIGIN3)
+	{
+		to->origin[2] = MSG_ReadCoord(msg_read);
+	}
+
+	if (bits & U_ANGLE1)
+	{
+		to->angles[0] = MSG_ReadAngle(msg_read);
+	}
+
+	if (bits & U_ANGLE2)
+	{
+		to->angles[1] = MSG_ReadAngle(msg_read);
+	}
+
+	if (bits & U_ANGLE3)
+	{
+		to->angles[2] = MSG_ReadAngle(msg_read);
+	}
+
+	if (bits & U_OLDORIGIN)
+	{
+		MSG_ReadPos(msg_read, to->old_origin);
+	}
+
+	if (bits & U_SOUND)
+	{
+		to->sound = MSG_ReadByte(msg_read);
+	}
+
+	if (bits & U_EVENT)
+	{
+		to->event = MSG_ReadByte(msg_read);
+	}
+	else
+	{
+		to->event = 0;
+	}
+
+	if (bits & U_SOLID)
+	{
+		to->solid = MSG_ReadShort(msg_read);
+	}
+}
+
+/* sign extends a value of the given number of bits */
+static int
+MSG_SignExtend(int value, int bits)
+{
+	return (value ^ (1 << (bits - 1))) - (1 << (bits - 1));
+}
+
+static int
+MSG_ReadPackedDelta(sizebuf_t *msg_read, int from)
+{
+	switch (MSG_ReadBits(msg_read, 2))
+	{
+		case 0:
+			return (short)(from + MSG_SignExtend(MSG_ReadBits(msg_read, 5), 5));
+		case 1:
+			return (short)(from + MSG_SignExtend(MSG_ReadBits(msg_read, 8), 8));
+		case 2:
+			return (short)(from + MSG_SignExtend(MSG_ReadBits(msg_read, 11), 11));
+		default:
+			return (short)MSG_ReadBits(msg_read, 16);
+	}
+}
+
+/* a short is sign extended, as by MSG_ReadShort() */
+static int
+MSG_ReadPackedValue(sizebuf_t *msg_read)
+{
+	switch (MSG_ReadBits(msg_read, 2))
+	{
+		case 0:
+			return 0;
+		case 1:
+			return MSG_ReadBits(msg_read, 8);
+		case 2:
+			return MSG_SignExtend(MSG_ReadBits(msg_read, 16), 16);
+		default:
+			return MSG_ReadBits(msg_read, 32);
+	}
+}
+
+/*
+ * Returns the entity number and the U_* bits of an entity
+ * written by MSG_WritePackedDeltaEntity(). 0 ends the list.
+ */
+int
+MSG_ReadPackedEntityBits(sizebuf_t *msg_read, unsigned *bits, int lastnumber)
+{
+	int i, number, numbits;
+
+	*bits = 0;
+
+	if (MSG_ReadBits(msg_read, 1))
+	{
+		number = lastnumber + 1;
+	}
+	else if (MSG_ReadBits(msg_read, 1))
+	{
+		number = lastnumber + 2 + MSG_ReadBits(msg_read, 4);
+	}
+	else
+	{
+		number = MSG_ReadBits(msg_read, PACKED_NUMBER_BITS);
+	}
+
+	if (!number)
+	{
+		return 0;
+	}
+
+	if (MSG_ReadBits(msg_read, 1))
+	{
+		*bits = U_REMOVE;
+		return number;
+	}
+
+	numbits = sizeof(packedbits) / sizeof(packedbits[0]);
+
+	for (i = 0; i < numbits; i++)
+	{
+		if ((i == PACKED_COMMON_BITS) && !MSG_ReadBits(msg_read, 1))
+		{
+			break;
+		}
+
+		if (MSG_ReadBits(msg_read, 1))
+		{
+			*bits |= packedbits[i];
+		}
+	}
+
+	return number;
+}
+
+/*
+ * The bit packed version of MSG_ReadDeltaEntity()
+ */
+void
+MSG_ReadPackedDeltaEntity(sizebuf_t *msg_read, entity_state_t *from,
+		entity_state_t *to, int number, unsigned bits)
+{
+	int i, base;
+
+	/* set everything to the state we are delta'ing from */
+	*to = *from;
+
+	VectorCopy(from->origin, to->old_origin);
+	to->number = number;
+
+	for (i = 0; i < 3; i++)
+	{
+		if (bits & packedbits[i])
+		{
+			to->origin[i] = MSG_ReadPackedDelta(msg_read,
+					MSG_PackedCoord(from->origin[i])) * 0.125f;
+		}
+	}
+
+	if (bits & U_ANGLE1)
+	{
+		to->angles[0] = (signed char)MSG_ReadBits(msg_read, 8) * 1.40625f;
+	}
+
+	if (bits & U_ANGLE2)
+	{
+		to->angles[1] = (signed char)MSG_ReadBits(msg_read, 8) * 1.40625f;
+	}
+
+	if (bits & U_ANGLE3)
+	{
+		to->angles[2] = (signed char)MSG_ReadBits(msg_read, 8) * 1.40625f;
+	}
+
+	if (bits & U_FRAME8)
+	{
+		if (MSG_ReadBits(msg_read, 1))
+		{
+			to->frame = from->frame + 1;
+		}
+		else if (!MSG_ReadBits(msg_read, 1))
+		{
+			to->frame = MSG_ReadBits(msg_read, 8);
+		}
+		else
+		{
+			to->frame = MSG_SignExtend(MSG_ReadBits(msg_read, 16), 16);
+		}
+	}
+
+	if (bits & U_EVENT)
+	{
+		to->event = MSG_ReadBits(msg_read, 3);
+
+		if (to->event == 7)
+		{
+			to->event = MSG_ReadBits(msg_read, 8);
+		}
+	}
+	else
+	{
+		to->event = 0;
+	}
+
+	if (bits & U_MODEL)
+	{
+		to->modelindex = MSG_ReadBits(msg_read, 8);
+	}
+
+	if (bits & U_MODEL2)
+	{
+		to->modelindex2 = MSG_ReadBits(msg_read, 8);
+	}
+
+	if (bits & U_MODEL3)
+	{
+		to->modelindex3 = MSG_ReadBits(msg_read, 8);
+	}
+
+	if (bits & U_MODEL4)
+	{
+		to->modelindex4 = MSG_ReadBits(msg_read, 8);
+	}
+
+	if (bits & U_SKIN8)
+	{
+		to->skinnum = MSG_ReadPackedValue(msg_read);
+	}
+
+	if (bits & U_EFFECTS8)
+	{
+		to->effects = MSG_ReadPackedValue(msg_read);
+	}
+
+	if (bits & U_RENDERFX8)
+	{
+		to->renderfx = MSG_ReadPackedValue(msg_read);
+	}
+
+	if (bits & U_OLDORIGIN)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			base = MSG_PackedCoord(to->origin[i]);
+			to->old_origin[i] = MSG_ReadPackedDelta(msg_read, base) * 0.125f;
+		}
+	}
+
+	if (bits & U_SOUND)
+	{
+		to->sound = MSG_ReadBits(msg_read, 8);
+	}
+
+	if (bits & U_SOLID)
+	{
+		to->solid = MSG_SignExtend(MSG_ReadBits(msg_read, 16), 16);
+	}
+}
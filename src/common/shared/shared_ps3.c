@@ -1092,6 +1092,30 @@ Q_strcasecmp(char *s1, char *s2)
 	return Q_strncasecmp(s1, s2, 99999);
 }
 
+/*
+ * Case insensitive string hash. Names that compare
+ * equal with Q_stricmp() always hash to the same
+ * bucket. size must be a power of two.
+ */
+unsigned
+Q_strhash(const char *s, unsigned size)
+{
+	unsigned hash = 0;
+	int c;
+
+	while ((c = *s++) != '\0')
+	{
+		if ((c >= 'A') && (c <= 'Z'))
+		{
+			c += ('a' - 'A');
+		}
+
+		hash = hash * 33 + c;
+	}
+
+	return (hash ^ (hash >> 16)) & (size - 1);
+}
+
 void
 Com_sprintf(char *dest, int size, char *fmt, ...)
 {
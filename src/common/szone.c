@@ -38,6 +38,7 @@ void
 SZ_Clear(sizebuf_t *buf)
 {
 	buf->cursize = 0;
+	buf->bitpos = 0;
 	buf->overflowed = false;
 }
 
@@ -61,7 +62,11 @@ SZ_GetSpace(sizebuf_t *buf, int length)
 
 		SZ_Clear(buf);
 		buf->overflowed = true;
-		Com_Printf("SZ_GetSpace: overflow\n");
+
+		if (!buf->quietoverflow)
+		{
+			Com_Printf("SZ_GetSpace: overflow\n");
+		}
 	}
 
 	data = buf->data + buf->cursize;
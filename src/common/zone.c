@@ -19,7 +19,10 @@
  *
  * =======================================================================
  *
- * Zone malloc. It's just a normal malloc with tags.
+ * Zone malloc. Each tag owns an arena: Small blocks are cut from
+ * chunks with a bump pointer and recycled through per size class
+ * free lists, large blocks are malloc()ed directly. Z_FreeTags()
+ * releases a whole arena without looking at the other tags.
  *
  * =======================================================================
  */
@@ -28,14 +31,213 @@
 #include "header/zone.h"
 
 #define Z_MAGIC 0x1d1d
+#define Z_FREEMAGIC 0x1d1e
+
+#define Z_ALIGN 16
+#define Z_CHUNK_SIZE (64 * 1024)
+#define Z_MAX_SMALL 2048  /* incl. header, larger blocks aren't pooled */
+#define Z_NUM_CLASSES (Z_MAX_SMALL / Z_ALIGN)
+#define Z_MAX_TAGS 64
+
+#define Z_ROUND(x) (((x) + Z_ALIGN - 1) & ~(Z_ALIGN - 1))
+#define Z_CHUNK_HEADER Z_ROUND(sizeof(zchunk_t))
+
+typedef struct zchunk_s
+{
+	struct zchunk_s *next;
+	int used;
+} zchunk_t;
+
+typedef struct
+{
+	int tag;
+	memsubsystem_t subsystem;
+	zchunk_t *chunks;               /* the first one is bumped */
+	zhead_t large;                  /* chain of malloc()ed blocks */
+	zhead_t *free[Z_NUM_CLASSES];   /* freed small blocks */
+
+	int bytes, blocks;              /* live blocks */
+	int numChunks;
+	int numLarge, largeBytes;
+	int freeBytes, freeBlocks;
+} zarena_t;
+
+static zarena_t z_arenas[Z_MAX_TAGS];
+static int z_numArenas;
+static zarena_t *z_lastArena;
 
-zhead_t z_chain;
 int z_count, z_bytes;
 
+typedef struct
+{
+	int bytes, peak;
+	int blocks;
+} memaccount_t;
+
+static memaccount_t mem_accounts[MEM_NUM_SUBSYSTEMS];
+
+static const char *mem_names[MEM_NUM_SUBSYSTEMS] = {
+	"zone",
+	"sound",
+	"hunk",
+	"images",
+	"surfcache",
+	"client",
+	"collision"
+};
+
+/*
+ * Every allocator reports its blocks here, negative
+ * sizes for frees. Called by the refresh as well.
+ */
+void
+Mem_Account(memsubsystem_t subsystem, int bytes)
+{
+	memaccount_t *account = &mem_accounts[subsystem];
+
+	account->bytes += bytes;
+
+	if (bytes > 0)
+	{
+		account->blocks++;
+
+		if (account->bytes > account->peak)
+		{
+			account->peak = account->bytes;
+		}
+	}
+	else if (bytes < 0)
+	{
+		account->blocks--;
+	}
+}
+
+/*
+ * Writes the accounting as CSV, one subsystem per line.
+ */
+static void
+Mem_Dump(const char *filename)
+{
+	char name[MAX_OSPATH];
+	FILE *f;
+	int i;
+
+	Com_sprintf(name, sizeof(name), "%s/%s.csv", FS_Gamedir(), filename);
+
+	FS_CreatePath(name);
+	f = Q_fopen(name, "w");
+
+	if (!f)
+	{
+		Com_Printf("ERROR: couldn't open %s.\n", name);
+		return;
+	}
+
+	fprintf(f, "subsystem,bytes,peak,blocks\n");
+
+	for (i = 0; i < MEM_NUM_SUBSYSTEMS; i++)
+	{
+		fprintf(f, "%s,%i,%i,%i\n", mem_names[i], mem_accounts[i].bytes,
+				mem_accounts[i].peak, mem_accounts[i].blocks);
+	}
+
+	fclose(f);
+
+	Com_Printf("Dumped memory statistics to %s.\n", name);
+}
+
+/*
+ * Prints the memory held by each subsystem.
+ * "memstats dump [name]" writes name.csv
+ * into the game directory instead.
+ */
+void
+Mem_Stats_f(void)
+{
+	int i, bytes = 0, peak = 0;
+
+	if ((Cmd_Argc() >= 2) && (Q_stricmp(Cmd_Argv(1), "dump") == 0))
+	{
+		Mem_Dump((Cmd_Argc() == 3) ? Cmd_Argv(2) : "memstats");
+		return;
+	}
+
+	Com_Printf("subsystem        KB  peak KB  blocks\n");
+
+	for (i = 0; i < MEM_NUM_SUBSYSTEMS; i++)
+	{
+		Com_Printf("%-10s %8i %8i %7i\n", mem_names[i],
+				mem_accounts[i].bytes / 1024, mem_accounts[i].peak / 1024,
+				mem_accounts[i].blocks);
+
+		bytes += mem_accounts[i].bytes;
+		peak += mem_accounts[i].peak;
+	}
+
+	Com_Printf("total      %8i %8i\n", bytes / 1024, peak / 1024);
+}
+
+static memsubsystem_t
+Z_TagSubsystem(int tag)
+{
+	switch (tag)
+	{
+		case Z_TAG_SOUND:
+			return MEM_SOUND;
+		case Z_TAG_COLLISION:
+			return MEM_COLLISION;
+		default:
+			return MEM_ZONE;
+	}
+}
+
+static zarena_t *
+Z_GetArena(int tag, qboolean create)
+{
+	zarena_t *arena;
+	int i;
+
+	if (z_lastArena && (z_lastArena->tag == tag))
+	{
+		return z_lastArena;
+	}
+
+	for (i = 0; i < z_numArenas; i++)
+	{
+		if (z_arenas[i].tag == tag)
+		{
+			z_lastArena = &z_arenas[i];
+			return z_lastArena;
+		}
+	}
+
+	if (!create)
+	{
+		return NULL;
+	}
+
+	if (z_numArenas == Z_MAX_TAGS)
+	{
+		Com_Error(ERR_FATAL, "Z_TagMalloc: more than %i tags", Z_MAX_TAGS);
+	}
+
+	arena = &z_arenas[z_numArenas++];
+	memset(arena, 0, sizeof(*arena));
+	arena->tag = tag;
+	arena->subsystem = Z_TagSubsystem(tag);
+	arena->large.next = arena->large.prev = &arena->large;
+
+	z_lastArena = arena;
+
+	return arena;
+}
+
 void
 Z_Free(void *ptr)
 {
+	zarena_t *arena;
 	zhead_t *z;
+	int class;
 
 	z = ((zhead_t *)ptr) - 1;
 
@@ -45,61 +247,202 @@ Z_Free(void *ptr)
 		abort();
 	}
 
-	z->prev->next = z->next;
-	z->next->prev = z->prev;
+	arena = Z_GetArena(z->tag, false);
+
+	if (!arena)
+	{
+		Com_Printf("ERROR: Z_free(%p) failed: bad tag %i\n", ptr, z->tag);
+		abort();
+	}
 
 	z_count--;
 	z_bytes -= z->size;
-	free(z);
+	Mem_Account(arena->subsystem, -z->size);
+	arena->blocks--;
+	arena->bytes -= z->size;
+
+	if (z->size > Z_MAX_SMALL)
+	{
+		z->prev->next = z->next;
+		z->next->prev = z->prev;
+
+		arena->numLarge--;
+		arena->largeBytes -= z->size;
+		free(z);
+
+		return;
+	}
+
+	/* keep it for the next block of this size */
+	class = z->size / Z_ALIGN - 1;
+
+	z->magic = Z_FREEMAGIC;
+	z->next = arena->free[class];
+	arena->free[class] = z;
+
+	arena->freeBlocks++;
+	arena->freeBytes += z->size;
 }
 
+/*
+ * Prints the memory held by each tag. Fragmentation
+ * is the part of the chunks not used by live blocks,
+ * either sitting in the free lists or never handed out.
+ */
 void
 Z_Stats_f(void)
 {
+	zarena_t *arena;
+	int i, chunkBytes, smallBytes;
+
+	Com_Printf("  tag      bytes blocks chunks  large  free KB  frag\n");
+
+	for (i = 0; i < z_numArenas; i++)
+	{
+		arena = &z_arenas[i];
+
+		if (!arena->blocks && !arena->numChunks)
+		{
+			continue;
+		}
+
+		chunkBytes = arena->numChunks * (Z_CHUNK_SIZE - Z_CHUNK_HEADER);
+		smallBytes = arena->bytes - arena->largeBytes;
+
+		Com_Printf("%5i %10i %6i %6i %6i %8i %4i%%\n", arena->tag,
+				arena->bytes, arena->blocks, arena->numChunks,
+				arena->numLarge, arena->freeBytes / 1024,
+				chunkBytes ? (int)(100.0f * (chunkBytes - smallBytes) / chunkBytes) : 0);
+	}
+
 	Com_Printf("%i bytes in %i blocks\n", z_bytes, z_count);
 }
 
 void
 Z_FreeTags(int tag)
 {
+	zarena_t *arena;
+	zchunk_t *chunk, *nextChunk;
 	zhead_t *z, *next;
 
-	for (z = z_chain.next; z != &z_chain; z = next)
+	if ((arena = Z_GetArena(tag, false)) == NULL)
+	{
+		return;
+	}
+
+	for (z = arena->large.next; z != &arena->large; z = next)
 	{
 		next = z->next;
+		free(z);
+	}
+
+	for (chunk = arena->chunks; chunk; chunk = nextChunk)
+	{
+		nextChunk = chunk->next;
+		free(chunk);
+	}
+
+	z_count -= arena->blocks;
+	z_bytes -= arena->bytes;
+
+	mem_accounts[arena->subsystem].bytes -= arena->bytes;
+	mem_accounts[arena->subsystem].blocks -= arena->blocks;
+
+	memset(arena, 0, sizeof(*arena));
+	arena->tag = tag;
+	arena->subsystem = Z_TagSubsystem(tag);
+	arena->large.next = arena->large.prev = &arena->large;
+}
+
+/*
+ * Cuts a small block from the arena, either
+ * from the free list or from the current chunk.
+ */
+static zhead_t *
+Z_SmallAlloc(zarena_t *arena, int size)
+{
+	zchunk_t *chunk;
+	zhead_t *z;
+	int class;
+
+	class = size / Z_ALIGN - 1;
+
+	if ((z = arena->free[class]) != NULL)
+	{
+		arena->free[class] = z->next;
+		arena->freeBlocks--;
+		arena->freeBytes -= size;
+
+		memset(z, 0, size);
 
-		if (z->tag == tag)
+		return z;
+	}
+
+	chunk = arena->chunks;
+
+	if (!chunk || (chunk->used + size > Z_CHUNK_SIZE))
+	{
+		/* fresh memory from calloc() needs no memset() */
+		chunk = calloc(1, Z_CHUNK_SIZE);
+
+		if (!chunk)
 		{
-			Z_Free((void *)(z + 1));
+			Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes", Z_CHUNK_SIZE);
 		}
+
+		chunk->used = Z_CHUNK_HEADER;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+		arena->numChunks++;
 	}
+
+	z = (zhead_t *)((byte *)chunk + chunk->used);
+	chunk->used += size;
+
+	return z;
 }
 
 void *
 Z_TagMalloc(int size, int tag)
 {
+	zarena_t *arena;
 	zhead_t *z;
 
-	size = size + sizeof(zhead_t);
-	z = malloc(size);
+	arena = Z_GetArena(tag, true);
+	size = Z_ROUND(size + sizeof(zhead_t));
 
-	if (!z)
+	if (size <= Z_MAX_SMALL)
+	{
+		z = Z_SmallAlloc(arena, size);
+	}
+	else
 	{
-		Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes", size);
+		z = calloc(1, size);
+
+		if (!z)
+		{
+			Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes", size);
+		}
+
+		z->next = arena->large.next;
+		z->prev = &arena->large;
+		arena->large.next->prev = z;
+		arena->large.next = z;
+
+		arena->numLarge++;
+		arena->largeBytes += size;
 	}
 
-	memset(z, 0, size);
 	z_count++;
 	z_bytes += size;
+	Mem_Account(arena->subsystem, size);
+	arena->blocks++;
+	arena->bytes += size;
+
 	z->magic = Z_MAGIC;
 	z->tag = tag;
 	z->size = size;
 
-	z->next = z_chain.next;
-	z->prev = &z_chain;
-	z_chain.next->prev = z;
-	z_chain.next = z;
-
 	return (void *)(z + 1);
 }
 
@@ -108,4 +451,3 @@ Z_Malloc(int size)
 {
 	return Z_TagMalloc(size, 0);
 }
-
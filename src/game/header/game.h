@@ -34,7 +34,11 @@
  * !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
  */
 
-#define GAME_API_VERSION 3
+/* 4 added trace_batch to game_import_t. Servers still load
+   version 3 games, which don't know about it. A version 4
+   game is refused by servers that don't provide it. */
+#define GAME_API_VERSION 4
+#define GAME_API_VERSION_ORIGINAL 3
 
 #define SVF_NOCLIENT 0x00000001 /* don't send entity to clients, even if it has effects */
 #define SVF_DEADMONSTER 0x00000002 /* treat as CONTENTS_DEADMONSTER for collision */
@@ -101,6 +105,17 @@ struct edict_s
 
 /* =============================================================== */
 
+/* one entry of a trace_batch() call, same
+   arguments as trace() but without pointers */
+typedef struct
+{
+	vec3_t start;
+	vec3_t mins, maxs;
+	vec3_t end;
+	edict_t *passent;
+	int contentmask;
+} tracerequest_t;
+
 /* functions provided by the main engine */
 typedef struct
 {
@@ -181,6 +196,12 @@ typedef struct
 	void (*AddCommandString)(char *text);
 
 	void (*DebugGraph)(float value, int color);
+
+	/* runs count traces at once, maybe spread over several threads.
+	   Results are the same as calling trace() for each request.
+	   Added in GAME_API_VERSION 4, new functions go below. */
+	void (*trace_batch)(tracerequest_t *requests, trace_t *results,
+			int count);
 } game_import_t;
 
 /* functions exported by the game subsystem */
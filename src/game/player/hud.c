@@ -566,8 +566,14 @@ G_SetStats(edict_t *ent)
 			  (ent->client->ps.fov > 91)) &&
 			 ent->client->pers.weapon)
 	{
-		cvar_t *gun;
-		gun = gi.cvar("cl_gun", "2", 0);
+		/* cvars live as long as the engine, looking
+		   it up once per game is enough */
+		static cvar_t *gun;
+
+		if (!gun)
+		{
+			gun = gi.cvar("cl_gun", "2", 0);
+		}
 
 		if (gun->value != 2)
 		{
@@ -112,6 +112,7 @@ typedef struct client_s
 	char userinfo[MAX_INFO_STRING];     /* name, etc */
 
 	int lastframe;                      /* for delta compression */
+	int leafnum;                        /* view leaf in the last frame */
 	usercmd_t lastcmd;                  /* for filling in big drops */
 
 	int commandMsec;                    /* every seconds this is reset, if user */
@@ -143,6 +144,7 @@ typedef struct client_s
 	int lastconnect;
 
 	int challenge;                      /* challenge of this user, randomly generated */
+	qboolean packedentities;            /* send svc_packedentities instead of svc_packetentities */
 
 	netchan_t netchan;
 } client_t;
@@ -174,9 +176,10 @@ typedef struct
 	challenge_t challenges[MAX_CHALLENGES];    /* to prevent invalid IPs from connecting */
 
 	/* serverrecord values */
-	FILE *demofile;
+	FILE *demofile;                     /* written by the thread in sv_demo.c */
 	sizebuf_t demo_multicast;
 	byte demo_multicast_buf[MAX_MSGLEN];
+	qboolean demo_multicast_reliable;   /* must not be dropped */
 } server_static_t;
 
 extern netadr_t net_from;
@@ -194,6 +197,8 @@ extern cvar_t *sv_airaccelerate;            /* don't reload level state when ree
 											/* development tool */
 extern cvar_t *sv_enforcetime;
 extern cvar_t *sv_downloadserver;			/* Download server. */
+extern cvar_t *sv_broadphase;
+extern cvar_t *sv_packedentities;
 
 extern client_t *sv_client;
 extern edict_t *sv_player;
@@ -246,7 +251,10 @@ void SV_Status_f(void);
 
 void SV_WriteFrameToClient(client_t *client, sizebuf_t *msg);
 void SV_RecordDemoMessage(void);
-void SV_BuildClientFrame(client_t *client);
+void SV_FatPVS(const int *clusters, int numclusters, byte *fatpvs);
+void SV_BuildClientFrames(client_t **clients, sizebuf_t **msgs, int count);
+void SV_FrameStats_f(void);
+void SV_EntityBench_f(void);
 
 extern game_export_t *ge;
 
@@ -284,5 +292,34 @@ int SV_PointContents(vec3_t p);
 trace_t SV_Trace(vec3_t start, vec3_t mins, vec3_t maxs,
 		vec3_t end, edict_t *passedict, int contentmask);
 
+/* traces all requests, using the worker pool if there is one */
+void SV_TraceBatch(tracerequest_t *requests, trace_t *results, int count);
+void SV_TraceRecord_f(void);
+void SV_TraceBench_f(void);
+void SV_RecordAreaFrame(void);
+void SV_AreaRecord_f(void);
+void SV_AreaBench_f(void);
+void SV_LinkStats_f(void);
+
+/* worker pool for independent jobs, worker 0 is the caller */
+#define MAX_JOB_THREADS 8
+
+typedef void (*svjob_t)(void *data, int job, int worker);
+
+extern cvar_t *sv_threads;
+
+void SV_InitJobs(void);
+void SV_ShutdownJobs(void);
+int SV_NumWorkers(void);
+void SV_RunJobs(svjob_t func, void *data, int numjobs, int maxworkers);
+
+/* serverrecord writer thread */
+extern cvar_t *sv_demo_drop;
+
+void SV_StartDemo(void);
+void SV_WriteDemo(byte *data, int len, qboolean reliable);
+void SV_StopDemo(void);
+void SV_DemoStats_f(void);
+
 #endif
 
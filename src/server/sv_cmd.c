@@ -543,7 +543,6 @@ SV_ServerRecord_f(void)
 	char name[MAX_OSPATH];
 	byte buf_data[32768];
 	sizebuf_t buf;
-	int len;
 	int i;
 
 	if (Cmd_Argc() != 2)
@@ -588,6 +587,7 @@ SV_ServerRecord_f(void)
 	/* setup a buffer to catch all multicasts */
 	SZ_Init(&svs.demo_multicast, svs.demo_multicast_buf,
 			sizeof(svs.demo_multicast_buf));
+	svs.demo_multicast_reliable = false;
 
 	/* write a single giant fake message with all the startup info */
 	SZ_Init(&buf, buf_data, sizeof(buf_data));
@@ -626,9 +626,8 @@ SV_ServerRecord_f(void)
 
 	/* write it to the demo file */
 	Com_DPrintf("signon message length: %i\n", buf.cursize);
-	len = LittleLong(buf.cursize);
-	fwrite(&len, 4, 1, svs.demofile);
-	fwrite(buf.data, buf.cursize, 1, svs.demofile);
+	SV_StartDemo();
+	SV_WriteDemo(buf.data, buf.cursize, true);
 }
 
 /*
@@ -643,8 +642,7 @@ SV_ServerStop_f(void)
 		return;
 	}
 
-	fclose(svs.demofile);
-	svs.demofile = NULL;
+	SV_StopDemo();
 	Com_Printf("Recording completed.\n");
 }
 
@@ -774,6 +772,15 @@ SV_InitOperatorCommands(void)
 
 	Cmd_AddCommand("serverrecord", SV_ServerRecord_f);
 	Cmd_AddCommand("serverstop", SV_ServerStop_f);
+	Cmd_AddCommand("demostats", SV_DemoStats_f);
+
+	Cmd_AddCommand("tracerecord", SV_TraceRecord_f);
+	Cmd_AddCommand("tracebench", SV_TraceBench_f);
+	Cmd_AddCommand("arearecord", SV_AreaRecord_f);
+	Cmd_AddCommand("areabench", SV_AreaBench_f);
+	Cmd_AddCommand("linkstats", SV_LinkStats_f);
+	Cmd_AddCommand("framestats", SV_FrameStats_f);
+	Cmd_AddCommand("entitybench", SV_EntityBench_f);
 
 	Cmd_AddCommand("save", SV_Savegame_f);
 	Cmd_AddCommand("load", SV_Loadgame_f);
@@ -278,6 +278,15 @@ gotnewcl:
 	newcl->edict = ent;
 	newcl->challenge = challenge; /* save challenge for checksumming */
 
+	/* the client can parse bit packed entities */
+	for (i = 5; i < Cmd_Argc(); i++)
+	{
+		if (!strcmp(Cmd_Argv(i), "packedents=1"))
+		{
+			newcl->packedentities = (sv_packedentities->value != 0);
+		}
+	}
+
 	/* get the game a chance to reject this connection or modify the userinfo */
 	if (!(ge->ClientConnect(ent, userinfo)))
 	{
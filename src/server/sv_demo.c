@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 1997-2001 Id Software, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * Writes server demos (serverrecord) on a thread of their own, so a
+ * slow disk doesn't stall the server frame. The messages are collected
+ * in a block while the thread writes the previously filled ones. If all
+ * blocks are waiting for the disk, sv_demo_drop decides whether the
+ * server drops the message or waits. Messages with reliable data are
+ * never dropped. Without a thread the server writes the demo itself.
+ *
+ * =======================================================================
+ */
+
+#include "header/server.h"
+
+#define DEMO_BLOCKS 4
+#define DEMO_BLOCK_SIZE 0x10000 /* fits the largest message */
+
+typedef struct
+{
+	byte data[DEMO_BLOCK_SIZE];
+	int cursize;
+} demoblock_t;
+
+typedef struct
+{
+	qmutex_t *mutex;
+	qcond_t *queued; /* signaled when a block is queued */
+	qcond_t *written; /* signaled when a block was written */
+	qthread_t *thread;
+
+	demoblock_t *blocks; /* [DEMO_BLOCKS] */
+	int head; /* next block to write */
+	int numqueued; /* blocks from head on, the one after them is filled */
+
+	qboolean quit;
+	qboolean failed; /* fwrite() failed, the rest is discarded */
+
+	/* statistics */
+	int maxqueued;
+	int messages;
+	int dropped;
+	long long bytes;
+	long long waittime;
+} demowriter_t;
+
+static demowriter_t sv_demowriter;
+
+static void
+SV_DemoThread(void *data)
+{
+	demoblock_t *block;
+	demowriter_t *writer = data;
+
+	Sys_LockMutex(writer->mutex);
+
+	while (1)
+	{
+		if (!writer->numqueued)
+		{
+			if (writer->quit)
+			{
+				break;
+			}
+
+			Sys_WaitCond(writer->queued);
+			continue;
+		}
+
+		block = &writer->blocks[writer->head];
+		Sys_UnlockMutex(writer->mutex);
+
+		if (!writer->failed &&
+			(fwrite(block->data, block->cursize, 1, svs.demofile) != 1))
+		{
+			writer->failed = true;
+		}
+
+		Sys_LockMutex(writer->mutex);
+
+		writer->bytes += block->cursize;
+		writer->head = (writer->head + 1) % DEMO_BLOCKS;
+		writer->numqueued--;
+
+		Sys_BroadcastCond(writer->written);
+	}
+
+	Sys_UnlockMutex(writer->mutex);
+}
+
+/*
+ * Hands svs.demofile over to the writer thread
+ */
+void
+SV_StartDemo(void)
+{
+	demowriter_t *writer = &sv_demowriter;
+
+	memset(writer, 0, sizeof(*writer));
+
+	writer->blocks = Z_Malloc(DEMO_BLOCKS * sizeof(demoblock_t));
+	writer->mutex = Sys_CreateMutex();
+	writer->queued = Sys_CreateCond(writer->mutex);
+	writer->written = Sys_CreateCond(writer->mutex);
+
+	/* NULL makes SV_WriteDemo() write right away */
+	writer->thread = Sys_CreateThread(SV_DemoThread, writer, "Demo Writer");
+}
+
+/*
+ * Appends a message to the demo, prefixed by the length. When
+ * the current block is full it's queued for writing. If no other
+ * block is free, the message is dropped or the server waits until
+ * one is written, depending on sv_demo_drop. Reliable messages
+ * always wait.
+ */
+void
+SV_WriteDemo(byte *data, int len, qboolean reliable)
+{
+	int size;
+	long long start;
+	demoblock_t *block;
+	demowriter_t *writer = &sv_demowriter;
+
+	if (!svs.demofile)
+	{
+		return;
+	}
+
+	size = LittleLong(len);
+
+	if (!writer->thread)
+	{
+		if (!writer->failed &&
+			((fwrite(&size, 4, 1, svs.demofile) != 1) ||
+			 (fwrite(data, len, 1, svs.demofile) != 1)))
+		{
+			writer->failed = true;
+		}
+
+		writer->messages++;
+		writer->bytes += 4 + len;
+		return;
+	}
+
+	Sys_LockMutex(writer->mutex);
+
+	block = &writer->blocks[(writer->head + writer->numqueued) % DEMO_BLOCKS];
+
+	if (block->cursize + 4 + len > DEMO_BLOCK_SIZE)
+	{
+		/* one block must be left for filling */
+		if ((writer->numqueued == DEMO_BLOCKS - 1) &&
+			(reliable || !sv_demo_drop->value))
+		{
+			start = Sys_Microseconds();
+
+			while (writer->numqueued == DEMO_BLOCKS - 1)
+			{
+				Sys_WaitCond(writer->written);
+			}
+
+			writer->waittime += Sys_Microseconds() - start;
+		}
+
+		if (writer->numqueued == DEMO_BLOCKS - 1)
+		{
+			writer->dropped++;
+			Sys_UnlockMutex(writer->mutex);
+			return;
+		}
+
+		writer->numqueued++;
+
+		if (writer->numqueued > writer->maxqueued)
+		{
+			writer->maxqueued = writer->numqueued;
+		}
+
+		Sys_BroadcastCond(writer->queued);
+
+		block = &writer->blocks[(writer->head + writer->numqueued) % DEMO_BLOCKS];
+		block->cursize = 0;
+	}
+
+	writer->messages++;
+
+	Sys_UnlockMutex(writer->mutex);
+
+	/* the thread doesn't touch the block being filled */
+	memcpy(block->data + block->cursize, &size, 4);
+	memcpy(block->data + block->cursize + 4, data, len);
+	block->cursize += 4 + len;
+}
+
+/*
+ * Writes the rest of the demo and closes it
+ */
+void
+SV_StopDemo(void)
+{
+	demoblock_t *block;
+	demowriter_t *writer = &sv_demowriter;
+
+	if (!svs.demofile)
+	{
+		return;
+	}
+
+	if (writer->thread)
+	{
+		Sys_LockMutex(writer->mutex);
+
+		block = &writer->blocks[(writer->head + writer->numqueued) %
+			DEMO_BLOCKS];
+
+		if (block->cursize)
+		{
+			writer->numqueued++;
+		}
+
+		writer->quit = true;
+		Sys_BroadcastCond(writer->queued);
+		Sys_UnlockMutex(writer->mutex);
+
+		Sys_JoinThread(writer->thread);
+	}
+
+	Sys_DestroyCond(writer->queued);
+	Sys_DestroyCond(writer->written);
+	Sys_DestroyMutex(writer->mutex);
+	Z_Free(writer->blocks);
+
+	if (writer->failed)
+	{
+		Com_Printf("ERROR: couldn't write the demo.\n");
+	}
+
+	if (writer->dropped)
+	{
+		Com_Printf("%i of %i demo messages were dropped.\n", writer->dropped,
+				writer->dropped + writer->messages);
+	}
+
+	fclose(svs.demofile);
+	svs.demofile = NULL;
+}
+
+/*
+ * demostats
+ * Prints how far the demo writer is behind
+ */
+void
+SV_DemoStats_f(void)
+{
+	demowriter_t *writer = &sv_demowriter;
+
+	if (!svs.demofile)
+	{
+		Com_Printf("Not doing a serverrecord.\n");
+		return;
+	}
+
+	Sys_LockMutex(writer->mutex);
+
+	Com_Printf("%i of %i blocks queued, %i at most\n", writer->numqueued,
+			DEMO_BLOCKS - 1, writer->maxqueued);
+	Com_Printf("%i messages, %i dropped, %i KB written\n", writer->messages,
+			writer->dropped, (int)(writer->bytes / 1024));
+	Com_Printf("%.1f ms waited for the disk\n", writer->waittime / 1000.0);
+
+	Sys_UnlockMutex(writer->mutex);
+}
@@ -31,21 +31,189 @@
 #include "header/server.h"
 
 // DG: is casted to int32_t* in SV_FatPVS() so align accordingly
-static YQ2_ALIGNAS_TYPE(int32_t) byte fatpvs[65536 / 8];
+static YQ2_ALIGNAS_TYPE(int32_t) byte fatpvs[MAX_JOB_THREADS][65536 / 8];
+
+/* scratch and statistics for building the
+   frame of a client, indexed by client number */
+typedef struct
+{
+	qboolean ingame;
+	vec3_t org; /* view position */
+	int area;
+	int vis; /* in sv_clustervis */
+
+	short visible[MAX_EDICTS]; /* edict numbers */
+	int numvisible;
+	int first; /* in svs.client_entities */
+
+	sizebuf_t msg;
+	byte msgbuf[MAX_MSGLEN];
+
+	long long buildtime; /* this frame */
+	long long totaltime;
+	long long maxtime;
+	int frames;
+
+	/* entity deltas copied from sv_deltacache
+	   and the ones encoded for this client only */
+	int deltahits;
+	int deltamisses;
+	int deltabytes; /* copied */
+} clientbuild_t;
+
+/* the entities in the PVS and PHS of a view, culled
+   once a frame for all clients that share the view */
+typedef struct
+{
+	unsigned hash;
+	int clusters[64]; /* of the fat PVS, sorted */
+	int numclusters;
+	int phscluster;
+
+	short visible[MAX_EDICTS]; /* edict numbers */
+	int numvisible;
+
+	clientbuild_t *owner; /* gets the time for culling */
+} clustervis_t;
+
+/* the delta of an entity from the previous server
+   frame to the current one, as MSG_WriteDeltaEntity()
+   writes it in SV_EmitPacketEntities() */
+typedef struct
+{
+	int framenum; /* data is valid for */
+	int length;
+	byte data[64];
+} entitydelta_t;
+
+/* encoded once a frame and copied into the messages
+   of all clients that have the previous state */
+typedef struct
+{
+	int framenum; /* of the current states */
+	qboolean valid; /* previous states are from framenum - 1 */
+	int current; /* index into states */
+	entity_state_t states[2][MAX_EDICTS];
+	entitydelta_t deltas[MAX_EDICTS];
+} deltacache_t;
+
+typedef enum
+{
+	FRAMEJOB_VIEWS, /* cull the shared views */
+	FRAMEJOB_CLIENTS, /* cull per client */
+	FRAMEJOB_DELTAS, /* fill the delta cache */
+	FRAMEJOB_ENCODE /* store and encode per client */
+} framejob_t;
+
+typedef struct
+{
+	client_t **clients;
+	framejob_t phase;
+	int numjobs;
+	int deltaworkers[MAX_JOB_THREADS]; /* that ran each delta job */
+} framejobs_t;
+
+static clientbuild_t *sv_clientbuilds;
+static clustervis_t *sv_clustervis;
+static deltacache_t *sv_deltacache;
+static int sv_numclientbuilds;
+static int sv_numclustervis;
+
+static struct
+{
+	int frames;
+	int clients;
+	int views; /* culled */
+	int deltas; /* encoded into the cache */
+	int deltabytes;
+	int deltajobs;
+	int deltathreads; /* that ran the delta jobs */
+	long long walltime;
+} sv_framestats;
+
+/*
+ * Copies the entity's delta from the previous frame out
+ * of the cache, if from and to are the states it was
+ * encoded for. Otherwise the client still has an older
+ * frame or sees the entity differently.
+ */
+static qboolean
+SV_WriteCachedDelta(entity_state_t *from, entity_state_t *to, sizebuf_t *msg)
+{
+	entitydelta_t *delta;
+	deltacache_t *cache = sv_deltacache;
+
+	if (!cache || !cache->valid || (cache->framenum != sv.framenum))
+	{
+		return false;
+	}
+
+	delta = &cache->deltas[to->number];
+
+	if ((delta->framenum != sv.framenum) ||
+		memcmp(to, &cache->states[cache->current][to->number], sizeof(*to)) ||
+		memcmp(from, &cache->states[cache->current ^ 1][to->number],
+			sizeof(*from)))
+	{
+		return false;
+	}
+
+	SZ_Write(msg, delta->data, delta->length);
+
+	return true;
+}
+
+/*
+ * Tells the client that the entity
+ * isn't present in the new frame
+ */
+static void
+SV_WriteRemoveEntity(sizebuf_t *msg, int number)
+{
+	int bits;
+
+	bits = U_REMOVE;
+
+	if (number >= 256)
+	{
+		bits |= U_NUMBER16 | U_MOREBITS1;
+	}
+
+	MSG_WriteByte(msg, bits & 255);
+
+	if (bits & 0x0000ff00)
+	{
+		MSG_WriteByte(msg, (bits >> 8) & 255);
+	}
+
+	if (bits & U_NUMBER16)
+	{
+		MSG_WriteShort(msg, number);
+	}
+	else
+	{
+		MSG_WriteByte(msg, number);
+	}
+}
 
 /*
  * Writes a delta update of an entity_state_t list to the message.
+ * Deltas from the previous frame are taken from the cache for
+ * frames built by SV_BuildClientFrames(). Clients that asked
+ * for it get the bit packed svc_packedentities instead, which
+ * isn't cached.
  */
-void
-SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
+static void
+SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg,
+		clientbuild_t *build, qboolean packed)
 {
 	entity_state_t *oldent, *newent;
 	int oldindex, newindex;
 	int oldnum, newnum;
 	int from_num_entities;
-	int bits;
+	int lastnum;
 
-	MSG_WriteByte(msg, svc_packetentities);
+	MSG_WriteByte(msg, packed ? svc_packedentities : svc_packetentities);
 
 	if (!from)
 	{
@@ -60,6 +228,7 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 	oldindex = 0;
 	newent = NULL;
 	oldent = NULL;
+	lastnum = 0;
 
 	while (newindex < to->num_entities || oldindex < from_num_entities)
 	{
@@ -97,8 +266,29 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 			   being emited if the entity has not changed at all
 			   note that players are always 'newentities', this
 			   updates their oldorigin always and prevents warping */
-			MSG_WriteDeltaEntity(oldent, newent, msg,
-					false, newent->number <= maxclients->value);
+			if (packed)
+			{
+				lastnum = MSG_WritePackedDeltaEntity(oldent, newent, msg,
+						false, newent->number <= maxclients->value, lastnum);
+			}
+			else if (!build)
+			{
+				MSG_WriteDeltaEntity(oldent, newent, msg,
+						false, newent->number <= maxclients->value);
+			}
+			else if (SV_WriteCachedDelta(oldent, newent, msg))
+			{
+				build->deltahits++;
+				build->deltabytes +=
+					sv_deltacache->deltas[newent->number].length;
+			}
+			else
+			{
+				MSG_WriteDeltaEntity(oldent, newent, msg,
+						false, newent->number <= maxclients->value);
+				build->deltamisses++;
+			}
+
 			oldindex++;
 			newindex++;
 			continue;
@@ -107,7 +297,17 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 		if (newnum < oldnum)
 		{
 			/* this is a new entity, send it from the baseline */
-			MSG_WriteDeltaEntity(&sv.baselines[newnum], newent, msg, true, true);
+			if (packed)
+			{
+				lastnum = MSG_WritePackedDeltaEntity(&sv.baselines[newnum],
+						newent, msg, true, true, lastnum);
+			}
+			else
+			{
+				MSG_WriteDeltaEntity(&sv.baselines[newnum], newent, msg,
+						true, true);
+			}
+
 			newindex++;
 			continue;
 		}
@@ -115,35 +315,28 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 		if (newnum > oldnum)
 		{
 			/* the old entity isn't present in the new message */
-			bits = U_REMOVE;
-
-			if (oldnum >= 256)
-			{
-				bits |= U_NUMBER16 | U_MOREBITS1;
-			}
-
-			MSG_WriteByte(msg, bits & 255);
-
-			if (bits & 0x0000ff00)
-			{
-				MSG_WriteByte(msg, (bits >> 8) & 255);
-			}
-
-			if (bits & U_NUMBER16)
+			if (packed)
 			{
-				MSG_WriteShort(msg, oldnum);
-			}
-			else
-			{
-				MSG_WriteByte(msg, oldnum);
+				MSG_WritePackedRemove(msg, oldnum, lastnum);
+				lastnum = oldnum;
+				oldindex++;
+				continue;
 			}
 
+			SV_WriteRemoveEntity(msg, oldnum);
 			oldindex++;
 			continue;
 		}
 	}
 
-	MSG_WriteShort(msg, 0);
+	if (packed)
+	{
+		MSG_WritePackedEnd(msg);
+	}
+	else
+	{
+		MSG_WriteShort(msg, 0);
+	}
 }
 
 void
@@ -432,21 +625,24 @@ SV_WriteFrameToClient(client_t *client, sizebuf_t *msg)
 	SV_WritePlayerstateToClient(oldframe, frame, msg);
 
 	/* delta encode the entities */
-	SV_EmitPacketEntities(oldframe, frame, msg);
+	SV_EmitPacketEntities(oldframe, frame, msg,
+			sv_clientbuilds ? &sv_clientbuilds[client - svs.clients] : NULL,
+			client->packedentities);
 }
 
 /*
  * The client will interpolate the view position,
- * so we can't use a single PVS point
+ * so we can't use a single PVS point. Returns the
+ * clusters around it, sorted and without duplicates.
+ * Leafs outside of any cluster see nothing and are
+ * left out.
  */
-void
-SV_FatPVS(vec3_t org)
+static int
+SV_FatClusters(vec3_t org, int *clusters)
 {
 	int leafs[64];
-	int i, j, count;
-	// DG: used to be called "longs" and long was used which isn't really correct on 64bit
-	int32_t numInt32s;
-	byte *src;
+	int i, j, count, numclusters;
+	int cluster;
 	vec3_t mins, maxs;
 
 	for (i = 0; i < 3; i++)
@@ -459,67 +655,128 @@ SV_FatPVS(vec3_t org)
 
 	if (count < 1)
 	{
-		Com_Error(ERR_FATAL, "SV_FatPVS: count < 1");
+		Com_Error(ERR_FATAL, "SV_FatClusters: count < 1");
 	}
 
-	numInt32s = (CM_NumClusters() + 31) >> 5;
+	numclusters = 0;
 
-	/* convert leafs to clusters */
 	for (i = 0; i < count; i++)
 	{
-		leafs[i] = CM_LeafCluster(leafs[i]);
-	}
+		cluster = CM_LeafCluster(leafs[i]);
+
+		if (cluster == -1)
+		{
+			continue;
+		}
 
-	memcpy(fatpvs, CM_ClusterPVS(leafs[0]), numInt32s << 2);
+		j = numclusters;
 
-	/* or in all the other leaf bits */
-	for (i = 1; i < count; i++)
-	{
-		for (j = 0; j < i; j++)
+		while ((j > 0) && (clusters[j - 1] > cluster))
 		{
-			if (leafs[i] == leafs[j])
-			{
-				break;
-			}
+			j--;
 		}
 
-		if (j != i)
+		if ((j > 0) && (clusters[j - 1] == cluster))
 		{
 			continue; /* already have the cluster we want */
 		}
 
-		src = CM_ClusterPVS(leafs[i]);
+		memmove(&clusters[j + 1], &clusters[j],
+				(numclusters - j) * sizeof(int));
+		clusters[j] = cluster;
+		numclusters++;
+	}
+
+	return numclusters;
+}
+
+/*
+ * ORs the PVS rows of the clusters together
+ */
+void
+SV_FatPVS(const int *clusters, int numclusters, byte *fatpvs)
+{
+	int i, j;
+	// DG: used to be called "longs" and long was used which isn't really correct on 64bit
+	int32_t numInt32s;
+	const byte *src;
+
+	numInt32s = (CM_NumClusters() + 31) >> 5;
+
+	memset(fatpvs, 0, numInt32s << 2);
+
+	for (i = 0; i < numclusters; i++)
+	{
+		src = CM_ClusterPVS(clusters[i]);
 
 		for (j = 0; j < numInt32s; j++)
 		{
-			((int32_t *)fatpvs)[j] |= ((int32_t *)src)[j];
+			((int32_t *)fatpvs)[j] |= ((const int32_t *)src)[j];
 		}
 	}
 }
 
 /*
- * Decides which entities are going to be visible to the client, and
- * copies off the playerstat and areabits.
+ * Returns the culled view with the given clusters,
+ * adding it if no client had it this frame yet.
  */
-void
-SV_BuildClientFrame(client_t *client)
+static int
+SV_FindClusterVis(const int *clusters, int numclusters, int phscluster,
+		clientbuild_t *build)
 {
-	int e, i;
-	vec3_t org;
-	edict_t *ent;
+	int i;
+	unsigned hash;
+	clustervis_t *vis;
+
+	hash = phscluster;
+
+	for (i = 0; i < numclusters; i++)
+	{
+		hash = hash * 31 + clusters[i];
+	}
+
+	for (i = 0; i < sv_numclustervis; i++)
+	{
+		vis = &sv_clustervis[i];
+
+		if ((vis->hash == hash) && (vis->phscluster == phscluster) &&
+			(vis->numclusters == numclusters) &&
+			!memcmp(vis->clusters, clusters, numclusters * sizeof(int)))
+		{
+			return i;
+		}
+	}
+
+	vis = &sv_clustervis[sv_numclustervis];
+	vis->hash = hash;
+	memcpy(vis->clusters, clusters, numclusters * sizeof(int));
+	vis->numclusters = numclusters;
+	vis->phscluster = phscluster;
+	vis->numvisible = 0;
+	vis->owner = build;
+
+	return sv_numclustervis++;
+}
+
+/*
+ * Copies off the playerstate and areabits and finds
+ * the client's view clusters. Runs on the main thread,
+ * the leaf lookup isn't thread safe.
+ */
+static void
+SV_SetupClientFrame(client_t *client, clientbuild_t *build)
+{
+	int i;
+	int leafnum;
+	int clusters[64], numclusters;
 	edict_t *clent;
 	client_frame_t *frame;
-	entity_state_t *state;
-	int l;
-	int clientarea, clientcluster;
-	int leafnum;
-	int c_fullsend;
-	byte *clientphs;
-	byte *bitvector;
 
 	clent = client->edict;
+	build->ingame = (clent->client != NULL);
+	build->numvisible = 0;
 
-	if (!clent->client)
+	if (!build->ingame)
 	{
 		return; /* not in game yet */
 	}
@@ -532,132 +789,209 @@ SV_BuildClientFrame(client_t *client)
 	/* find the client's PVS */
 	for (i = 0; i < 3; i++)
 	{
-		org[i] = clent->client->ps.pmove.origin[i] * 0.125 +
+		build->org[i] = clent->client->ps.pmove.origin[i] * 0.125 +
 				 clent->client->ps.viewoffset[i];
 	}
 
-	leafnum = CM_PointLeafnum(org);
-	clientarea = CM_LeafArea(leafnum);
-	clientcluster = CM_LeafCluster(leafnum);
+	leafnum = CM_PointLeafnumHint(build->org, client->leafnum);
+	client->leafnum = leafnum;
+	build->area = CM_LeafArea(leafnum);
+
+	numclusters = SV_FatClusters(build->org, clusters);
+	build->vis = SV_FindClusterVis(clusters, numclusters,
+			CM_LeafCluster(leafnum), build);
 
 	/* calculate the visible areas */
-	frame->areabytes = CM_WriteAreaBits(frame->areabits, clientarea);
+	frame->areabytes = CM_WriteAreaBits(frame->areabits, build->area);
 
 	/* grab the current player_state_t */
 	frame->ps = clent->client->ps;
+}
+
+/*
+ * Entities without visible models are
+ * only sent if they have an effect
+ */
+static qboolean
+SV_EntityIsSent(edict_t *ent)
+{
+	if (ent->svflags & SVF_NOCLIENT)
+	{
+		return false;
+	}
+
+	return ent->s.modelindex || ent->s.effects ||
+		   ent->s.sound || ent->s.event;
+}
 
-	SV_FatPVS(org);
-	clientphs = CM_ClusterPHS(clientcluster);
+/*
+ * Finds the entities touching a PV leaf of the view.
+ * Only reads the world, so any worker can do it as
+ * long as CM_VisExpanded() is true.
+ */
+static void
+SV_CullClusterEntities(clustervis_t *vis, byte *fatpvs)
+{
+	int e, i;
+	edict_t *ent;
+	int l;
+	const byte *clientphs;
 
-	/* build up the list of visible entities */
-	frame->num_entities = 0;
-	frame->first_entity = svs.next_client_entities;
+	SV_FatPVS(vis->clusters, vis->numclusters, fatpvs);
 
-	c_fullsend = 0;
+	/* outside of any cluster nothing can be heard */
+	clientphs = (vis->phscluster != -1) ?
+		CM_ClusterPHS(vis->phscluster) : NULL;
 
 	for (e = 1; e < ge->num_edicts; e++)
 	{
 		ent = EDICT_NUM(e);
 
-		/* ignore ents without visible models */
-		if (ent->svflags & SVF_NOCLIENT)
+		if (!SV_EntityIsSent(ent))
 		{
 			continue;
 		}
 
-		/* ignore ents without visible models unless they have an effect */
-		if (!ent->s.modelindex && !ent->s.effects && 
-			!ent->s.sound && !ent->s.event)
+		/* beams just check one point for PHS */
+		if (ent->s.renderfx & RF_BEAM)
 		{
-			continue;
-		}
+			l = ent->clusternums[0];
 
-		/* ignore if not touching a PV leaf */
-		if (ent != clent)
+			if (!clientphs || !(clientphs[l >> 3] & (1 << (l & 7))))
+			{
+				continue;
+			}
+		}
+		else if (ent->num_clusters == -1)
 		{
-			/* check area */
-			if (!CM_AreasConnected(clientarea, ent->areanum))
+			/* too many leafs for individual check, go by headnode */
+			if (!CM_HeadnodeVisible(ent->headnode, fatpvs))
 			{
-				/* doors can legally straddle two areas,
-				   so we may need to check another one */
-				if (!ent->areanum2 ||
-					!CM_AreasConnected(clientarea, ent->areanum2))
-				{
-					continue; /* blocked by a door */
-				}
+				continue;
 			}
-
-			/* beams just check one point for PHS */
-			if (ent->s.renderfx & RF_BEAM)
+		}
+		else
+		{
+			/* check individual leafs */
+			for (i = 0; i < ent->num_clusters; i++)
 			{
-				l = ent->clusternums[0];
+				l = ent->clusternums[i];
 
-				if (!(clientphs[l >> 3] & (1 << (l & 7))))
+				if (fatpvs[l >> 3] & (1 << (l & 7)))
 				{
-					continue;
+					break;
 				}
 			}
-			else
-			{
-				bitvector = fatpvs;
 
-				if (ent->num_clusters == -1)
-				{
-					/* too many leafs for individual check, go by headnode */
-					if (!CM_HeadnodeVisible(ent->headnode, bitvector))
-					{
-						continue;
-					}
+			if (i == ent->num_clusters)
+			{
+				continue; /* not visible */
+			}
+		}
 
-					c_fullsend++;
-				}
-				else
-				{
-					/* check individual leafs */
-					for (i = 0; i < ent->num_clusters; i++)
-					{
-						l = ent->clusternums[i];
+		vis->visible[vis->numvisible++] = e;
+	}
+}
 
-						if (bitvector[l >> 3] & (1 << (l & 7)))
-						{
-							break;
-						}
-					}
+/*
+ * Decides which entities of the client's view are
+ * going to be visible to the client. The client's
+ * own entity is always sent.
+ */
+static void
+SV_CullClientEntities(client_t *client, clientbuild_t *build)
+{
+	int e, i, clentnum;
+	edict_t *ent;
+	edict_t *clent;
+	clustervis_t *vis;
+	qboolean addclent;
 
-					if (i == ent->num_clusters)
-					{
-						continue; /* not visible */
-					}
-				}
+	clent = client->edict;
+	clentnum = NUM_FOR_EDICT(clent);
+	addclent = SV_EntityIsSent(clent);
+	vis = &sv_clustervis[build->vis];
 
-				if (!ent->s.modelindex)
-				{
-					/* don't send sounds if they 
-					   will be attenuated away */
-					vec3_t delta;
-					float len;
+	for (i = 0; i < vis->numvisible; i++)
+	{
+		e = vis->visible[i];
 
-					VectorSubtract(org, ent->s.origin, delta);
-					len = VectorLength(delta);
+		if (addclent && (e >= clentnum))
+		{
+			build->visible[build->numvisible++] = clentnum;
+			addclent = false;
 
-					if (len > 400)
-					{
-						continue;
-					}
-				}
+			if (e == clentnum)
+			{
+				continue;
 			}
 		}
+		else if (e == clentnum)
+		{
+			continue;
+		}
 
-		/* add it to the circular client_entities array */
-		state = &svs.client_entities[svs.next_client_entities %
-				svs.num_client_entities];
+		ent = EDICT_NUM(e);
 
-		if (ent->s.number != e)
+		/* check area */
+		if (!CM_AreasConnected(build->area, ent->areanum))
 		{
-			Com_DPrintf("FIXING ENT->S.NUMBER!!!\n");
-			ent->s.number = e;
+			/* doors can legally straddle two areas,
+			   so we may need to check another one */
+			if (!ent->areanum2 ||
+				!CM_AreasConnected(build->area, ent->areanum2))
+			{
+				continue; /* blocked by a door */
+			}
+		}
+
+		if (!ent->s.modelindex && !(ent->s.renderfx & RF_BEAM))
+		{
+			/* don't send sounds if they 
+			   will be attenuated away */
+			vec3_t delta;
+			float len;
+
+			VectorSubtract(build->org, ent->s.origin, delta);
+			len = VectorLength(delta);
+
+			if (len > 400)
+			{
+				continue;
+			}
 		}
 
+		build->visible[build->numvisible++] = e;
+	}
+
+	if (addclent)
+	{
+		build->visible[build->numvisible++] = clentnum;
+	}
+}
+
+/*
+ * Copies the visible entities into the client's part
+ * of the circular client_entities array.
+ */
+static void
+SV_StoreClientEntities(client_t *client, clientbuild_t *build)
+{
+	int i;
+	edict_t *ent;
+	client_frame_t *frame;
+	entity_state_t *state;
+
+	frame = &client->frames[sv.framenum & UPDATE_MASK];
+	frame->first_entity = build->first;
+	frame->num_entities = build->numvisible;
+
+	for (i = 0; i < build->numvisible; i++)
+	{
+		ent = EDICT_NUM(build->visible[i]);
+		state = &svs.client_entities[(build->first + i) %
+				svs.num_client_entities];
+
 		*state = ent->s;
 
 		/* don't mark players missiles as solid */
@@ -665,40 +999,385 @@ SV_BuildClientFrame(client_t *client)
 		{
 			state->solid = 0;
 		}
-
-		svs.next_client_entities++;
-		frame->num_entities++;
 	}
 }
 
 /*
- * Save everything in the world out without deltas.
- * Used for recording footage for merged or assembled demos
+ * Takes the current entity states and marks the ones
+ * any view can see for encoding. Their deltas are only
+ * valid if the previous frame was taken as well.
  */
-void
-SV_RecordDemoMessage(void)
+static qboolean
+SV_PrepareDeltaCache(void)
 {
-	int e;
-	edict_t *ent;
-	entity_state_t nostate;
-	sizebuf_t buf;
-	byte buf_data[32768];
-	int len;
+	int e, i, j;
+	deltacache_t *cache = sv_deltacache;
 
-	if (!svs.demofile)
+	cache->valid = (cache->framenum == sv.framenum - 1);
+	cache->framenum = sv.framenum;
+	cache->current ^= 1;
+
+	for (e = 1; e < ge->num_edicts; e++)
 	{
-		return;
+		cache->states[cache->current][e] = EDICT_NUM(e)->s;
 	}
 
-	memset(&nostate, 0, sizeof(nostate));
-	SZ_Init(&buf, buf_data, sizeof(buf_data));
+	if (!cache->valid)
+	{
+		return false;
+	}
 
-	/* write a frame message that doesn't
-	   contain a player_state_t */
-	MSG_WriteByte(&buf, svc_frame);
-	MSG_WriteLong(&buf, sv.framenum);
+	for (i = 0; i < sv_numclustervis; i++)
+	{
+		for (j = 0; j < sv_clustervis[i].numvisible; j++)
+		{
+			cache->deltas[sv_clustervis[i].visible[j]].framenum = sv.framenum;
+		}
+	}
 
-	MSG_WriteByte(&buf, svc_packetentities);
+	return true;
+}
+
+/*
+ * Encodes the marked deltas of every numjobs'th entity
+ */
+static void
+SV_EncodeDeltas(int job, int numjobs)
+{
+	int e;
+	sizebuf_t msg;
+	entitydelta_t *delta;
+	deltacache_t *cache = sv_deltacache;
+
+	for (e = 1 + job; e < ge->num_edicts; e += numjobs)
+	{
+		delta = &cache->deltas[e];
+
+		if (delta->framenum != sv.framenum)
+		{
+			continue;
+		}
+
+		SZ_Init(&msg, delta->data, sizeof(delta->data));
+
+		/* the same call as in SV_EmitPacketEntities() */
+		MSG_WriteDeltaEntity(&cache->states[cache->current ^ 1][e],
+				&cache->states[cache->current][e], &msg,
+				false, e <= maxclients->value);
+
+		delta->length = msg.cursize;
+	}
+}
+
+static void
+SV_ClientFrameJob(void *data, int job, int worker)
+{
+	framejobs_t *jobs = data;
+	client_t *client;
+	clientbuild_t *build;
+	clustervis_t *vis;
+	long long start;
+
+	start = Sys_Microseconds();
+
+	if (jobs->phase == FRAMEJOB_VIEWS)
+	{
+		vis = &sv_clustervis[job];
+		SV_CullClusterEntities(vis, fatpvs[worker]);
+		vis->owner->buildtime += Sys_Microseconds() - start;
+		return;
+	}
+
+	if (jobs->phase == FRAMEJOB_DELTAS)
+	{
+		SV_EncodeDeltas(job, jobs->numjobs);
+		jobs->deltaworkers[job] = worker;
+		return;
+	}
+
+	client = jobs->clients[job];
+	build = &sv_clientbuilds[client - svs.clients];
+
+	if (jobs->phase == FRAMEJOB_CLIENTS)
+	{
+		if (build->ingame)
+		{
+			SV_CullClientEntities(client, build);
+		}
+	}
+	else
+	{
+		if (build->ingame)
+		{
+			SV_StoreClientEntities(client, build);
+		}
+
+		SZ_Init(&build->msg, build->msgbuf, sizeof(build->msgbuf));
+		build->msg.allowoverflow = true;
+		build->msg.quietoverflow = true; /* no printing on workers */
+
+		/* send over all the relevant entity_state_t
+		   and the player_state_t */
+		SV_WriteFrameToClient(client, &build->msg);
+	}
+
+	build->buildtime += Sys_Microseconds() - start;
+}
+
+/*
+ * Builds and encodes the frames of the given clients,
+ * msgs[i] is set to the message for clients[i]. Clients
+ * with the same view share the PVS culling. The entity
+ * lists and messages are built by the worker pool, the
+ * entities are put into the circular client_entities
+ * array in client order.
+ */
+void
+SV_BuildClientFrames(client_t **clients, sizebuf_t **msgs, int count)
+{
+	int i, e, workers;
+	long long start, setup;
+	edict_t *ent;
+	clientbuild_t *build;
+	framejobs_t jobs;
+
+	start = Sys_Microseconds();
+
+	if (sv_numclientbuilds != (int)maxclients->value)
+	{
+		if (sv_clientbuilds)
+		{
+			Z_Free(sv_clientbuilds);
+			Z_Free(sv_clustervis);
+			Z_Free(sv_deltacache);
+		}
+
+		sv_numclientbuilds = (int)maxclients->value;
+		sv_clientbuilds = Z_Malloc(sv_numclientbuilds * sizeof(clientbuild_t));
+		sv_clustervis = Z_Malloc(sv_numclientbuilds * sizeof(clustervis_t));
+		sv_deltacache = Z_Malloc(sizeof(deltacache_t));
+		sv_deltacache->framenum = -1;
+		memset(&sv_framestats, 0, sizeof(sv_framestats));
+	}
+
+	/* the workers copy the states as they are */
+	for (e = 1; e < ge->num_edicts; e++)
+	{
+		ent = EDICT_NUM(e);
+
+		if (ent->s.number != e)
+		{
+			Com_DPrintf("FIXING ENT->S.NUMBER!!!\n");
+			ent->s.number = e;
+		}
+	}
+
+	sv_numclustervis = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		build = &sv_clientbuilds[clients[i] - svs.clients];
+		build->buildtime = 0;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		build = &sv_clientbuilds[clients[i] - svs.clients];
+		setup = Sys_Microseconds();
+		SV_SetupClientFrame(clients[i], build);
+		build->buildtime += Sys_Microseconds() - setup;
+	}
+
+	/* a partially decompressed vis cache
+	   can only be used by the main thread */
+	workers = CM_VisExpanded() ? 0 : 1;
+
+	jobs.clients = clients;
+	jobs.phase = FRAMEJOB_VIEWS;
+	SV_RunJobs(SV_ClientFrameJob, &jobs, sv_numclustervis, workers);
+
+	jobs.phase = FRAMEJOB_CLIENTS;
+	SV_RunJobs(SV_ClientFrameJob, &jobs, count, workers);
+
+	/* a single client gains nothing from the cache,
+	   bit packed entities don't use it */
+	for (i = 0, e = 0; i < count; i++)
+	{
+		if (!clients[i]->packedentities)
+		{
+			e++;
+		}
+	}
+
+	if ((e > 1) && SV_PrepareDeltaCache())
+	{
+		/* split over all workers if they may run */
+		jobs.phase = FRAMEJOB_DELTAS;
+		jobs.numjobs = workers ? 1 : SV_NumWorkers();
+		SV_RunJobs(SV_ClientFrameJob, &jobs, jobs.numjobs, workers);
+
+		sv_framestats.deltajobs += jobs.numjobs;
+
+		for (i = 0, e = 0; i < jobs.numjobs; i++)
+		{
+			e |= 1 << jobs.deltaworkers[i];
+		}
+
+		for (i = 0; i < MAX_JOB_THREADS; i++)
+		{
+			if (e & (1 << i))
+			{
+				sv_framestats.deltathreads++;
+			}
+		}
+
+		for (e = 1; e < ge->num_edicts; e++)
+		{
+			if (sv_deltacache->deltas[e].framenum == sv.framenum)
+			{
+				sv_framestats.deltas++;
+				sv_framestats.deltabytes += sv_deltacache->deltas[e].length;
+			}
+		}
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		build = &sv_clientbuilds[clients[i] - svs.clients];
+		build->first = svs.next_client_entities;
+		svs.next_client_entities += build->numvisible;
+	}
+
+	jobs.phase = FRAMEJOB_ENCODE;
+	SV_RunJobs(SV_ClientFrameJob, &jobs, count, workers);
+
+	for (i = 0; i < count; i++)
+	{
+		build = &sv_clientbuilds[clients[i] - svs.clients];
+		build->frames++;
+		build->totaltime += build->buildtime;
+
+		if (build->buildtime > build->maxtime)
+		{
+			build->maxtime = build->buildtime;
+		}
+
+		/* what SZ_GetSpace() would have printed */
+		if (build->msg.overflowed)
+		{
+			Com_Printf("SZ_GetSpace: overflow\n");
+		}
+
+		msgs[i] = &build->msg;
+	}
+
+	sv_framestats.frames++;
+	sv_framestats.clients += count;
+	sv_framestats.views += sv_numclustervis;
+	sv_framestats.walltime += Sys_Microseconds() - start;
+}
+
+/*
+ * framestats
+ * Prints the average and worst time it took to build
+ * each client's frame and the wall clock time of all
+ * frames since the last call, then resets them.
+ */
+void
+SV_FrameStats_f(void)
+{
+	int i;
+	long long total;
+	int hits, misses, bytes;
+	client_t *cl;
+	clientbuild_t *build;
+
+	if (!sv_clientbuilds || !sv_framestats.frames)
+	{
+		Com_Printf("No client frames built.\n");
+		return;
+	}
+
+	Com_Printf("num name            frames  avg usec  max usec\n");
+	Com_Printf("--- --------------- ------ --------- ---------\n");
+
+	total = 0;
+	hits = misses = bytes = 0;
+
+	for (i = 0; i < sv_numclientbuilds; i++)
+	{
+		cl = &svs.clients[i];
+		build = &sv_clientbuilds[i];
+
+		if (build->frames)
+		{
+			Com_Printf("%3i %-15.15s %6i %9.1f %9i\n", i, cl->name,
+					build->frames, (double)build->totaltime / build->frames,
+					(int)build->maxtime);
+			total += build->totaltime;
+		}
+
+		hits += build->deltahits;
+		misses += build->deltamisses;
+		bytes += build->deltabytes;
+
+		build->frames = 0;
+		build->totaltime = 0;
+		build->maxtime = 0;
+		build->deltahits = 0;
+		build->deltamisses = 0;
+		build->deltabytes = 0;
+	}
+
+	Com_Printf("%i server frames with %.1f clients, %.1f usec per frame "
+			"for %.1f usec of work on %i workers\n", sv_framestats.frames,
+			(double)sv_framestats.clients / sv_framestats.frames,
+			(double)sv_framestats.walltime / sv_framestats.frames,
+			(double)total / sv_framestats.frames,
+			CM_VisExpanded() ? SV_NumWorkers() : 1);
+	Com_Printf("%.1f views culled per frame, %.1f%% of the clients "
+			"reused the view of another one\n",
+			(double)sv_framestats.views / sv_framestats.frames,
+			sv_framestats.clients ? 100.0 * (sv_framestats.clients -
+				sv_framestats.views) / sv_framestats.clients : 0.0);
+	Com_Printf("%i entity deltas with %i bytes encoded into the cache, "
+			"%i copied from it with %i bytes, %i encoded per client\n",
+			sv_framestats.deltas, sv_framestats.deltabytes, hits, bytes,
+			misses);
+	Com_Printf("%.1f delta cache jobs on %.1f threads per frame\n",
+			(double)sv_framestats.deltajobs / sv_framestats.frames,
+			(double)sv_framestats.deltathreads / sv_framestats.frames);
+
+	memset(&sv_framestats, 0, sizeof(sv_framestats));
+}
+
+/*
+ * Save everything in the world out without deltas.
+ * Used for recording footage for merged or assembled demos
+ */
+void
+SV_RecordDemoMessage(void)
+{
+	int e;
+	edict_t *ent;
+	entity_state_t nostate;
+	sizebuf_t buf;
+	byte buf_data[32768];
+
+	if (!svs.demofile)
+	{
+		return;
+	}
+
+	memset(&nostate, 0, sizeof(nostate));
+	SZ_Init(&buf, buf_data, sizeof(buf_data));
+
+	/* write a frame message that doesn't
+	   contain a player_state_t */
+	MSG_WriteByte(&buf, svc_frame);
+	MSG_WriteLong(&buf, sv.framenum);
+
+	MSG_WriteByte(&buf, svc_packetentities);
 
 	e = 1;
 	ent = EDICT_NUM(e);
@@ -723,9 +1402,513 @@ SV_RecordDemoMessage(void)
 	SZ_Write(&buf, svs.demo_multicast.data, svs.demo_multicast.cursize);
 	SZ_Clear(&svs.demo_multicast);
 
-	/* now write the entire message to the file, prefixed by the length */
-	len = LittleLong(buf.cursize);
-	fwrite(&len, 4, 1, svs.demofile);
-	fwrite(buf.data, buf.cursize, 1, svs.demofile);
+	/* now queue the entire message for the writer thread */
+	SV_WriteDemo(buf.data, buf.cursize, svs.demo_multicast_reliable);
+	svs.demo_multicast_reliable = false;
 }
 
+/* entity states of a server demo, and as
+   the two encodings decode them again */
+typedef struct
+{
+	entity_state_t baselines[MAX_EDICTS];
+	entity_state_t states[2][MAX_EDICTS];
+	qboolean present[2][MAX_EDICTS];
+
+	entity_state_t decoded[2][2][MAX_EDICTS]; /* [packed][current] */
+	qboolean decodedpresent[2][2][MAX_EDICTS];
+
+	byte msgbuf[0x10000];
+} entitybench_t;
+
+/*
+ * Encodes the entities of the current frame as a delta from the
+ * previous one, the same way SV_EmitPacketEntities() does it.
+ */
+static void
+SV_BenchEncode(entitybench_t *bench, int current, int maxclients,
+		qboolean packed, sizebuf_t *msg)
+{
+	entity_state_t *from, *to;
+	int e, lastnum;
+
+	SZ_Init(msg, bench->msgbuf, sizeof(bench->msgbuf));
+	lastnum = 0;
+
+	for (e = 1; e < MAX_EDICTS; e++)
+	{
+		from = &bench->states[current ^ 1][e];
+		to = &bench->states[current][e];
+
+		if (bench->present[current][e])
+		{
+			if (!bench->present[current ^ 1][e])
+			{
+				/* a new entity, sent from the baseline */
+				from = &bench->baselines[e];
+			}
+
+			if (packed)
+			{
+				lastnum = MSG_WritePackedDeltaEntity(from, to, msg,
+						from == &bench->baselines[e],
+						(from == &bench->baselines[e]) || (e <= maxclients),
+						lastnum);
+			}
+			else
+			{
+				MSG_WriteDeltaEntity(from, to, msg,
+						from == &bench->baselines[e],
+						(from == &bench->baselines[e]) || (e <= maxclients));
+			}
+		}
+		else if (bench->present[current ^ 1][e])
+		{
+			if (packed)
+			{
+				MSG_WritePackedRemove(msg, e, lastnum);
+				lastnum = e;
+			}
+			else
+			{
+				SV_WriteRemoveEntity(msg, e);
+			}
+		}
+	}
+
+	if (packed)
+	{
+		MSG_WritePackedEnd(msg);
+	}
+	else
+	{
+		MSG_WriteShort(msg, 0);
+	}
+}
+
+/*
+ * Applies an encoded frame to the previously decoded one,
+ * with the same results as CL_ParsePacketEntities().
+ * Returns false if the message is broken.
+ */
+static qboolean
+SV_BenchDecode(entitybench_t *bench, int current, qboolean packed,
+		sizebuf_t *msg)
+{
+	entity_state_t *old, *cur, *from;
+	qboolean *oldpresent, *curpresent;
+	unsigned bits;
+	int e, number, lastnum;
+
+	old = bench->decoded[packed][current ^ 1];
+	cur = bench->decoded[packed][current];
+	oldpresent = bench->decodedpresent[packed][current ^ 1];
+	curpresent = bench->decodedpresent[packed][current];
+
+	/* entities that aren't in the message are unchanged */
+	for (e = 1; e < MAX_EDICTS; e++)
+	{
+		curpresent[e] = oldpresent[e];
+
+		if (oldpresent[e])
+		{
+			MSG_ReadDeltaEntity(msg, &old[e], &cur[e], e, 0);
+		}
+	}
+
+	MSG_BeginReading(msg);
+	lastnum = 0;
+
+	while (1)
+	{
+		if (packed)
+		{
+			number = MSG_ReadPackedEntityBits(msg, &bits, lastnum);
+			lastnum = number;
+		}
+		else
+		{
+			number = MSG_ReadEntityBits(msg, &bits);
+		}
+
+		if ((number < 0) || (number >= MAX_EDICTS) ||
+			(msg->readcount > msg->cursize))
+		{
+			return false;
+		}
+
+		if (!number)
+		{
+			break;
+		}
+
+		if (bits & U_REMOVE)
+		{
+			curpresent[number] = false;
+			continue;
+		}
+
+		from = oldpresent[number] ? &old[number] : &bench->baselines[number];
+
+		if (packed)
+		{
+			MSG_ReadPackedDeltaEntity(msg, from, &cur[number], number, bits);
+		}
+		else
+		{
+			MSG_ReadDeltaEntity(msg, from, &cur[number], number, bits);
+		}
+
+		curpresent[number] = true;
+	}
+
+	return msg->readcount == msg->cursize;
+}
+
+/*
+ * Encodes a skin, effects and renderfx at the edges of the
+ * sizes MSG_WriteDeltaEntity() picks, where it truncates or
+ * sign extends. Returns how many of them the bit packed
+ * entities decode to something else.
+ */
+static int
+SV_BenchEdgeValues(int *count)
+{
+	static const int values[] = {
+		1, 255, 256, 0x7fff, 0x8000, 0xffff, 0x10000, 0x7fffffff,
+		-1, -255, -256, -0x7fff, -0x8000, -0x8001, (int)0x80000000
+	};
+	entity_state_t from, to, decoded[2];
+	sizebuf_t msg;
+	byte buf[128];
+	unsigned bits;
+	int i, field, packed, number, mismatches;
+
+	memset(&from, 0, sizeof(from));
+	from.number = 1;
+	mismatches = 0;
+	*count = 0;
+
+	for (i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+	{
+		for (field = 0; field < 3; field++)
+		{
+			to = from;
+
+			if (field == 0)
+			{
+				to.skinnum = values[i];
+			}
+			else if (field == 1)
+			{
+				to.effects = values[i];
+			}
+			else
+			{
+				to.renderfx = values[i];
+			}
+
+			for (packed = 0; packed < 2; packed++)
+			{
+				SZ_Init(&msg, buf, sizeof(buf));
+
+				if (packed)
+				{
+					MSG_WritePackedDeltaEntity(&from, &to, &msg, true, false, 0);
+					MSG_BeginReading(&msg);
+					number = MSG_ReadPackedEntityBits(&msg, &bits, 0);
+					MSG_ReadPackedDeltaEntity(&msg, &from, &decoded[packed],
+							number, bits);
+				}
+				else
+				{
+					MSG_WriteDeltaEntity(&from, &to, &msg, true, false);
+					MSG_BeginReading(&msg);
+					number = MSG_ReadEntityBits(&msg, &bits);
+					MSG_ReadDeltaEntity(&msg, &from, &decoded[packed],
+							number, bits);
+				}
+			}
+
+			if (memcmp(&decoded[0], &decoded[1], sizeof(entity_state_t)))
+			{
+				mismatches++;
+			}
+
+			(*count)++;
+		}
+	}
+
+	return mismatches;
+}
+
+/*
+ * entitybench <demo>
+ * Encodes each frame of a server demo as a delta from the previous
+ * one, as for a client that sees all entities and acknowledged every
+ * frame, with both the byte aligned and the bit packed entities.
+ * Prints the bytes per frame of both. Entities that decode to
+ * different states are reported, as are skins, effects and
+ * renderfx at the edges of the value sizes.
+ */
+void
+SV_EntityBench_f(void)
+{
+	static const char *names[2] = {"byte aligned", "bit packed"};
+	char name[MAX_QPATH];
+	byte *buffer, *p, *end;
+	entitybench_t *bench;
+	entity_state_t nostate;
+	sizebuf_t demo, msg;
+	unsigned bits;
+	int len, cmd, index, number, current, packed, e;
+	int frames, entities, maxclients, mismatches;
+	int edgevalues, edgemismatches;
+	int minbytes[2], maxbytes[2];
+	long long totalbytes[2], encodetime[2], start;
+	qboolean broken;
+
+	if (Cmd_Argc() != 2)
+	{
+		Com_Printf("entitybench <demo>\n");
+		return;
+	}
+
+	Com_sprintf(name, sizeof(name), "demos/%s.dm2", Cmd_Argv(1));
+	len = FS_LoadFile(name, (void **)&buffer);
+
+	if (!buffer)
+	{
+		Com_Printf("Couldn't load %s.\n", name);
+		return;
+	}
+
+	bench = Z_Malloc(sizeof(entitybench_t));
+	memset(&nostate, 0, sizeof(nostate));
+
+	for (packed = 0; packed < 2; packed++)
+	{
+		minbytes[packed] = 0x7fffffff;
+		maxbytes[packed] = 0;
+		totalbytes[packed] = 0;
+		encodetime[packed] = 0;
+	}
+
+	frames = entities = mismatches = 0;
+	maxclients = 1;
+	current = 0;
+	broken = false;
+
+	p = buffer;
+	end = buffer + len;
+
+	while (!broken && (p + 4 <= end))
+	{
+		len = LittleLong(*(int *)p);
+		p += 4;
+
+		/* -1 ends the demo */
+		if ((len < 0) || (len > end - p))
+		{
+			break;
+		}
+
+		SZ_Init(&demo, p, len);
+		demo.cursize = len;
+		MSG_BeginReading(&demo);
+		p += len;
+
+		cmd = MSG_ReadByte(&demo);
+
+		if (cmd == svc_serverdata)
+		{
+			/* the signon, the level's configstrings
+			   and maybe baselines follow */
+			MSG_ReadLong(&demo);
+			MSG_ReadLong(&demo);
+			MSG_ReadByte(&demo);
+			MSG_ReadString(&demo);
+			MSG_ReadShort(&demo);
+			MSG_ReadString(&demo);
+
+			while (demo.readcount < demo.cursize)
+			{
+				cmd = MSG_ReadByte(&demo);
+
+				if (cmd == svc_configstring)
+				{
+					index = MSG_ReadShort(&demo);
+
+					if (index == CS_MAXCLIENTS)
+					{
+						maxclients = (int)strtol(MSG_ReadString(&demo),
+								(char **)NULL, 10);
+					}
+					else
+					{
+						MSG_ReadString(&demo);
+					}
+				}
+				else if (cmd == svc_spawnbaseline)
+				{
+					number = MSG_ReadEntityBits(&demo, &bits);
+
+					if ((number <= 0) || (number >= MAX_EDICTS))
+					{
+						broken = true;
+						break;
+					}
+
+					MSG_ReadDeltaEntity(&demo, &nostate,
+							&bench->baselines[number], number, bits);
+				}
+				else
+				{
+					break;
+				}
+			}
+
+			continue;
+		}
+
+		if (cmd != svc_frame)
+		{
+			continue;
+		}
+
+		/* the frame from SV_RecordDemoMessage(), all entities
+		   from nostate, followed by the multicasts */
+		MSG_ReadLong(&demo);
+
+		if (MSG_ReadByte(&demo) != svc_packetentities)
+		{
+			broken = true;
+			break;
+		}
+
+		current ^= 1;
+		memset(bench->present[current], 0, sizeof(bench->present[current]));
+
+		while (1)
+		{
+			number = MSG_ReadEntityBits(&demo, &bits);
+
+			if ((number < 0) || (number >= MAX_EDICTS) ||
+				(demo.readcount > demo.cursize))
+			{
+				broken = true;
+				break;
+			}
+
+			if (!number)
+			{
+				break;
+			}
+
+			MSG_ReadDeltaEntity(&demo, &nostate,
+					&bench->states[current][number], number, bits);
+			bench->present[current][number] = true;
+		}
+
+		if (broken)
+		{
+			break;
+		}
+
+		if (!frames++)
+		{
+			/* entities that are there from the start have
+			   baselines, all others are sent from nothing */
+			for (e = 1; e < MAX_EDICTS; e++)
+			{
+				if (bench->present[current][e] &&
+					!bench->baselines[e].number)
+				{
+					bench->baselines[e] = bench->states[current][e];
+				}
+			}
+		}
+
+		for (e = 1; e < MAX_EDICTS; e++)
+		{
+			if (bench->present[current][e])
+			{
+				entities++;
+			}
+		}
+
+		for (packed = 0; packed < 2; packed++)
+		{
+			start = Sys_Microseconds();
+			SV_BenchEncode(bench, current, maxclients, packed, &msg);
+			encodetime[packed] += Sys_Microseconds() - start;
+
+			totalbytes[packed] += msg.cursize;
+
+			if (msg.cursize < minbytes[packed])
+			{
+				minbytes[packed] = msg.cursize;
+			}
+
+			if (msg.cursize > maxbytes[packed])
+			{
+				maxbytes[packed] = msg.cursize;
+			}
+
+			if (!SV_BenchDecode(bench, current, packed, &msg))
+			{
+				Com_Printf("Frame %i: the %s entities don't decode.\n",
+						frames, names[packed]);
+				broken = true;
+			}
+		}
+
+		for (e = 1; !broken && (e < MAX_EDICTS); e++)
+		{
+			if ((bench->decodedpresent[0][current][e] !=
+				 bench->decodedpresent[1][current][e]) ||
+				(bench->decodedpresent[0][current][e] &&
+				 memcmp(&bench->decoded[0][current][e],
+					 &bench->decoded[1][current][e], sizeof(entity_state_t))))
+			{
+				if (mismatches++ < 10)
+				{
+					Com_Printf("Frame %i: entity %i decodes differently.\n",
+							frames, e);
+				}
+			}
+		}
+	}
+
+	FS_FreeFile(buffer);
+	Z_Free(bench);
+
+	if (broken || !frames)
+	{
+		Com_Printf("%s is not a valid server demo.\n", name);
+		return;
+	}
+
+	Com_Printf("%i frames with %.1f entities and %i clients\n", frames,
+			(float)entities / frames, maxclients);
+
+	for (packed = 0; packed < 2; packed++)
+	{
+		Com_Printf("%-12s: %7.1f bytes per frame, %i min, %i max, "
+				"%.1f usec to encode\n", names[packed],
+				(double)totalbytes[packed] / frames, minbytes[packed],
+				maxbytes[packed], (double)encodetime[packed] / frames);
+	}
+
+	if (totalbytes[0])
+	{
+		Com_Printf("bit packed entities are %.1f%% of the byte aligned ones\n",
+				100.0 * totalbytes[1] / totalbytes[0]);
+	}
+
+	Com_Printf("%i entities decoded differently\n", mismatches);
+
+	edgemismatches = SV_BenchEdgeValues(&edgevalues);
+	Com_Printf("%i of %i edge values decoded differently\n", edgemismatches,
+			edgevalues);
+}
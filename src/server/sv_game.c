@@ -282,7 +282,7 @@ PF_inPVS(vec3_t p1, vec3_t p2)
 	int leafnum;
 	int cluster;
 	int area1, area2;
-	byte *mask;
+	const byte *mask;
 
 	leafnum = CM_PointLeafnum(p1);
 	cluster = CM_LeafCluster(leafnum);
@@ -315,7 +315,7 @@ PF_inPHS(vec3_t p1, vec3_t p2)
 	int leafnum;
 	int cluster;
 	int area1, area2;
-	byte *mask;
+	const byte *mask;
 
 	leafnum = CM_PointLeafnum(p1);
 	cluster = CM_LeafCluster(leafnum);
@@ -398,6 +398,7 @@ SV_InitGameProgs(void)
 	import.unlinkentity = SV_UnlinkEdict;
 	import.BoxEdicts = SV_AreaEdicts;
 	import.trace = SV_Trace;
+	import.trace_batch = SV_TraceBatch;
 	import.pointcontents = SV_PointContents;
 	import.setmodel = PF_setmodel;
 	import.inPVS = PF_inPVS;
@@ -449,7 +450,9 @@ SV_InitGameProgs(void)
 		Com_Error(ERR_DROP, "failed to load game DLL");
 	}
 
-	if (ge->apiversion != GAME_API_VERSION)
+	/* older games just don't use the imports added since */
+	if ((ge->apiversion != GAME_API_VERSION) &&
+		(ge->apiversion != GAME_API_VERSION_ORIGINAL))
 	{
 		Com_Error(ERR_DROP, "game is version %i, not %i", ge->apiversion,
 				GAME_API_VERSION);
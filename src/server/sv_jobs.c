@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 1997-2001 Id Software, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * A small pool of worker threads. The server hands it a number of
+ * independent jobs and blocks until all of them are done, working on
+ * them itself in the meantime. The threads are started on first use.
+ *
+ * =======================================================================
+ */
+
+#include "header/server.h"
+
+typedef struct svjobpool_s svjobpool_t;
+
+typedef struct
+{
+	svjobpool_t *pool;
+	int index;
+} svworker_t;
+
+struct svjobpool_s
+{
+	qmutex_t *mutex;
+	qcond_t *wakeup; /* signaled when new jobs arrive */
+	qcond_t *done; /* signaled when the last job finished */
+
+	qthread_t *threads[MAX_JOB_THREADS];
+	svworker_t workers[MAX_JOB_THREADS];
+	int numthreads;
+	int activeworkers; /* workers allowed to take jobs */
+
+	svjob_t func;
+	void *data;
+	int numjobs;
+	int nextjob;
+	int pending;
+
+	qboolean running;
+	qboolean quit;
+};
+
+static svjobpool_t sv_jobpool;
+cvar_t *sv_threads;
+
+static void
+SV_JobThread(void *data)
+{
+	int job;
+	svworker_t *worker = data;
+	svjobpool_t *pool = worker->pool;
+
+	Sys_LockMutex(pool->mutex);
+
+	while (!pool->quit)
+	{
+		if ((pool->nextjob >= pool->numjobs) ||
+			(worker->index >= pool->activeworkers))
+		{
+			Sys_WaitCond(pool->wakeup);
+			continue;
+		}
+
+		job = pool->nextjob++;
+		Sys_UnlockMutex(pool->mutex);
+
+		pool->func(pool->data, job, worker->index);
+
+		Sys_LockMutex(pool->mutex);
+
+		if (--pool->pending == 0)
+		{
+			Sys_BroadcastCond(pool->done);
+		}
+	}
+
+	Sys_UnlockMutex(pool->mutex);
+}
+
+static void
+SV_StartJobs(void)
+{
+	int i, count;
+	svjobpool_t *pool = &sv_jobpool;
+
+	count = (int)sv_threads->value;
+
+	if (count <= 0)
+	{
+		count = Sys_GetNumCPUs();
+	}
+
+	/* the main thread is one of them */
+	count--;
+
+	if (count > MAX_JOB_THREADS - 1)
+	{
+		count = MAX_JOB_THREADS - 1;
+	}
+
+	sv_threads->modified = false;
+	pool->running = true;
+
+	if (count <= 0)
+	{
+		return;
+	}
+
+	pool->mutex = Sys_CreateMutex();
+	pool->wakeup = Sys_CreateCond(pool->mutex);
+	pool->done = Sys_CreateCond(pool->mutex);
+	pool->quit = false;
+
+	for (i = 0; i < count; i++)
+	{
+		pool->workers[i].pool = pool;
+		pool->workers[i].index = i + 1;
+		pool->threads[i] = Sys_CreateThread(SV_JobThread, &pool->workers[i],
+				"Server Worker");
+
+		if (!pool->threads[i])
+		{
+			break; /* make do with the ones running */
+		}
+	}
+
+	pool->numthreads = i;
+}
+
+void
+SV_ShutdownJobs(void)
+{
+	int i;
+	svjobpool_t *pool = &sv_jobpool;
+
+	if (!pool->running)
+	{
+		return;
+	}
+
+	if (pool->mutex)
+	{
+		Sys_LockMutex(pool->mutex);
+		pool->quit = true;
+		Sys_BroadcastCond(pool->wakeup);
+		Sys_UnlockMutex(pool->mutex);
+
+		for (i = 0; i < pool->numthreads; i++)
+		{
+			Sys_JoinThread(pool->threads[i]);
+		}
+
+		Sys_DestroyCond(pool->wakeup);
+		Sys_DestroyCond(pool->done);
+		Sys_DestroyMutex(pool->mutex);
+	}
+
+	memset(pool, 0, sizeof(*pool));
+}
+
+void
+SV_InitJobs(void)
+{
+	sv_threads = Cvar_Get("sv_threads", "0", CVAR_ARCHIVE);
+}
+
+/*
+ * Number of distinct worker indices passed to the jobs,
+ * index 0 is always the calling thread.
+ */
+int
+SV_NumWorkers(void)
+{
+	if (!sv_jobpool.running || sv_threads->modified)
+	{
+		SV_ShutdownJobs();
+		SV_StartJobs();
+	}
+
+	return sv_jobpool.numthreads + 1;
+}
+
+/*
+ * Runs func for each job on at most maxworkers threads,
+ * 0 means all of them. Returns when all jobs are done.
+ */
+void
+SV_RunJobs(svjob_t func, void *data, int numjobs, int maxworkers)
+{
+	int job;
+	svjobpool_t *pool = &sv_jobpool;
+
+	if ((maxworkers <= 0) || (maxworkers > SV_NumWorkers()))
+	{
+		maxworkers = SV_NumWorkers();
+	}
+
+	if ((maxworkers == 1) || (numjobs == 1))
+	{
+		for (job = 0; job < numjobs; job++)
+		{
+			func(data, job, 0);
+		}
+
+		return;
+	}
+
+	Sys_LockMutex(pool->mutex);
+
+	pool->func = func;
+	pool->data = data;
+	pool->numjobs = numjobs;
+	pool->nextjob = 0;
+	pool->pending = numjobs;
+	pool->activeworkers = maxworkers;
+
+	Sys_BroadcastCond(pool->wakeup);
+
+	while (pool->nextjob < pool->numjobs)
+	{
+		job = pool->nextjob++;
+		Sys_UnlockMutex(pool->mutex);
+
+		func(data, job, 0);
+
+		Sys_LockMutex(pool->mutex);
+		pool->pending--;
+	}
+
+	while (pool->pending)
+	{
+		Sys_WaitCond(pool->done);
+	}
+
+	pool->numjobs = 0;
+	pool->nextjob = 0;
+
+	Sys_UnlockMutex(pool->mutex);
+}
@@ -51,6 +51,9 @@ cvar_t *hostname;
 cvar_t *public_server; /* should heartbeats be sent */
 cvar_t *sv_entfile; /* External entity files. */
 cvar_t *sv_downloadserver; /* Download server. */
+cvar_t *sv_broadphase; /* 0 area tree, 1 loose octree */
+cvar_t *sv_packedentities; /* allow bit packed entities */
+cvar_t *sv_demo_drop; /* drop demo messages if the disk falls behind */
 
 void Master_Shutdown(void);
 void SV_ConnectionlessPacket(void);
@@ -415,6 +418,9 @@ SV_Frame(int usec)
 		return;
 	}
 
+	/* vis rows and point lookups from the last frame expire */
+	CM_NewFrame();
+
 	/* update ping based on the last known frame from all clients */
 	SV_CalcPings();
 
@@ -424,6 +430,9 @@ SV_Frame(int usec)
 	/* let everything in the world think and move */
 	SV_RunGameFrame();
 
+	/* save the linked edicts if recording them */
+	SV_RecordAreaFrame();
+
 	/* send messages back to the clients that had packets read this frame */
 	SV_SendClientMessages();
 
@@ -615,6 +624,12 @@ SV_Init(void)
 
 	sv_entfile = Cvar_Get("sv_entfile", "1", CVAR_ARCHIVE);
 
+	sv_broadphase = Cvar_Get("sv_broadphase", "0", CVAR_ARCHIVE);
+	sv_packedentities = Cvar_Get("sv_packedentities", "1", CVAR_ARCHIVE);
+	sv_demo_drop = Cvar_Get("sv_demo_drop", "1", CVAR_ARCHIVE);
+
+	SV_InitJobs();
+
 	SZ_Init(&net_message, net_message_buffer, sizeof(net_message_buffer));
 }
 
@@ -688,6 +703,7 @@ SV_Shutdown(char *finalmsg, qboolean reconnect)
 
 	Master_Shutdown();
 	SV_ShutdownGameProgs();
+	SV_ShutdownJobs();
 
 	/* free current level */
 	if (sv.demofile)
@@ -709,10 +725,7 @@ SV_Shutdown(char *finalmsg, qboolean reconnect)
 		Z_Free(svs.client_entities);
 	}
 
-	if (svs.demofile)
-	{
-		fclose(svs.demofile);
-	}
+	SV_StopDemo();
 
 	memset(&svs, 0, sizeof(svs));
 }
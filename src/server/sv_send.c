@@ -150,7 +150,7 @@ void
 SV_Multicast(vec3_t origin, multicast_t to)
 {
 	client_t *client;
-	byte *mask;
+	const byte *mask;
 	int leafnum = 0, cluster;
 	int j;
 	qboolean reliable;
@@ -203,6 +203,12 @@ SV_Multicast(vec3_t origin, multicast_t to)
 			Com_Error(ERR_FATAL, "SV_Multicast: bad to:%i", to);
 	}
 
+	/* configstrings and the like, the demo can't do without */
+	if (svs.demofile && reliable)
+	{
+		svs.demo_multicast_reliable = true;
+	}
+
 	/* send the data to all relevent clients */
 	for (j = 0, client = svs.clients; j < maxclients->value; j++, client++)
 	{
@@ -415,21 +421,13 @@ SV_StartSound(vec3_t origin, edict_t *entity, int channel, int soundindex,
 	}
 }
 
+/*
+ * Sends the frame SV_BuildClientFrames() encoded
+ * into msg together with the multicast datagram
+ */
 qboolean
-SV_SendClientDatagram(client_t *client)
+SV_SendClientDatagram(client_t *client, sizebuf_t *msg)
 {
-	byte msg_buf[MAX_MSGLEN];
-	sizebuf_t msg;
-
-	SV_BuildClientFrame(client);
-
-	SZ_Init(&msg, msg_buf, sizeof(msg_buf));
-	msg.allowoverflow = true;
-
-	/* send over all the relevant entity_state_t
-	   and the player_state_t */
-	SV_WriteFrameToClient(client, &msg);
-
 	/* copy the accumulated multicast datagram
 	   for this client out to the message
 	   it is necessary for this to be after the WriteEntities
@@ -440,23 +438,23 @@ SV_SendClientDatagram(client_t *client)
 	}
 	else
 	{
-		SZ_Write(&msg, client->datagram.data, client->datagram.cursize);
+		SZ_Write(msg, client->datagram.data, client->datagram.cursize);
 	}
 
 	SZ_Clear(&client->datagram);
 
-	if (msg.overflowed)
+	if (msg->overflowed)
 	{
 		/* must have room left for the packet header */
 		Com_Printf("WARNING: msg overflowed for %s\n", client->name);
-		SZ_Clear(&msg);
+		SZ_Clear(msg);
 	}
 
 	/* send the datagram */
-	Netchan_Transmit(&client->netchan, msg.cursize, msg.data);
+	Netchan_Transmit(&client->netchan, msg->cursize, msg->data);
 
 	/* record the size for rate estimation */
-	client->message_size[sv.framenum % RATE_MESSAGES] = msg.cursize;
+	client->message_size[sv.framenum % RATE_MESSAGES] = msg->cursize;
 
 	return true;
 }
@@ -514,6 +512,9 @@ SV_SendClientMessages(void)
 	int msglen;
 	byte msgbuf[MAX_MSGLEN];
 	size_t r;
+	client_t *frameclients[MAX_CLIENTS];
+	sizebuf_t *framemsgs[MAX_CLIENTS];
+	int numframes;
 
 	msglen = 0;
 
@@ -559,6 +560,8 @@ SV_SendClientMessages(void)
 		}
 	}
 
+	numframes = 0;
+
 	/* send a message to each connected client */
 	for (i = 0, c = svs.clients; i < maxclients->value; i++, c++)
 	{
@@ -592,7 +595,8 @@ SV_SendClientMessages(void)
 				continue;
 			}
 
-			SV_SendClientDatagram(c);
+			/* built together below */
+			frameclients[numframes++] = c;
 		}
 		else
 		{
@@ -604,5 +608,18 @@ SV_SendClientMessages(void)
 			}
 		}
 	}
+
+	if (!numframes)
+	{
+		return;
+	}
+
+	SV_BuildClientFrames(frameclients, framemsgs, numframes);
+
+	/* the datagrams go out in client order */
+	for (i = 0; i < numframes; i++)
+	{
+		SV_SendClientDatagram(frameclients[i], framemsgs[i]);
+	}
 }
 
@@ -28,6 +28,8 @@
 
 #define AREA_DEPTH 4
 #define AREA_NODES 32
+#define OCTREE_DEPTH 5
+#define OCTREE_NODES 2048
 #define MAX_TOTAL_ENT_LEAFS 128
 
 #define STRUCT_FROM_LINK(l, t, m) ((t *)((byte *)l - (byte *)&(((t *)NULL)->m)))
@@ -42,13 +44,154 @@ typedef struct areanode_s
 	link_t solid_edicts;
 } areanode_t;
 
-areanode_t sv_areanodes[AREA_NODES];
-int sv_numareanodes;
+/* A loose octree node holds the edicts whose center is inside
+   its cube and that are at most half as big as the cube. They
+   can't reach further out than twice the size of the cube. */
+typedef struct octnode_s
+{
+	vec3_t center;
+	float size; /* half the edge length of the cube */
+	struct octnode_s *parent;
+	struct octnode_s *children[8];
+	int side; /* index in the parent */
+	int numedicts[2]; /* solid and trigger edicts below */
+	int occupied[2]; /* bits of the children with edicts */
+	link_t trigger_edicts;
+	link_t solid_edicts;
+} octnode_t;
+
+typedef enum
+{
+	BROADPHASE_AREATREE,
+	BROADPHASE_OCTREE
+} broadphase_t;
+
+typedef struct
+{
+	broadphase_t broadphase;
+
+	areanode_t areanodes[AREA_NODES];
+	int numareanodes;
+
+	octnode_t *octnodes; /* the root comes first */
+	int numoctnodes;
+	octnode_t *freeoctnodes; /* emptied nodes, chained by parent */
+	int numfreeoctnodes;
+	qboolean octnodesfull; /* reported running out of nodes */
+} areaworld_t;
+
+typedef struct
+{
+	float *mins, *maxs;
+	edict_t **list;
+	int count, maxcount;
+	int type;
+	int checked; /* edicts tested against the box */
+	int visited; /* nodes searched */
+} arealist_t;
+
+static areaworld_t sv_world;
+
+/* what SV_LinkEdict found the last time, by edict number */
+typedef struct
+{
+	vec3_t absmin, absmax;
+	int linkcount; /* of the edict after that link */
+	int hint; /* topnode, or -1 - leafnum for a single leaf */
+	int octnode; /* 2 * octree node + trigger, -1 for none */
+} linkcache_t;
+
+static linkcache_t *sv_linkcache;
+static int sv_numlinkcache;
+
+static struct
+{
+	int links;
+	int unchanged; /* same bounds, no lookup */
+} sv_linkstats;
+
+/* traces per job of a batch */
+#define TRACE_BATCH_CHUNK 16
+
+typedef struct
+{
+	tracerequest_t *requests;
+	trace_t *results;
+	int count;
+} tracebatch_t;
+
+static cmtrace_t *sv_tracecontexts[MAX_JOB_THREADS];
+
+/* trace recordings, little endian on disk */
+#define TRACEFILE_IDENT (('R' << 24) + ('T' << 16) + ('2' << 8) + 'Q')
+#define TRACEFILE_VERSION 1
+
+typedef struct
+{
+	int ident;
+	int version;
+	int count;
+	char mapname[MAX_QPATH];
+} tracefileheader_t;
+
+typedef struct
+{
+	vec3_t start;
+	vec3_t mins, maxs;
+	vec3_t end;
+	int passent; /* edict number, -1 for none */
+	int contentmask;
+} tracerecord_t;
+
+static struct
+{
+	tracerecord_t *records;
+	int count, max;
+	char name[MAX_QPATH];
+} sv_tracerecord;
+
+/* recordings of the linked edicts and the area
+   queries of each frame, little endian on disk */
+#define AREAFILE_IDENT (('R' << 24) + ('A' << 16) + ('2' << 8) + 'Q')
+#define AREAFILE_VERSION 1
+#define MAX_AREA_QUERIES 4096 /* per frame */
+
+typedef struct
+{
+	int ident;
+	int version;
+	int numframes;
+	vec3_t mins, maxs; /* of the world */
+	char mapname[MAX_QPATH];
+} areafileheader_t;
+
+typedef struct
+{
+	int numedicts;
+	int numqueries;
+} areaframeheader_t;
+
+/* edicts, followed by the queries */
+typedef struct
+{
+	vec3_t mins, maxs;
+	int type; /* solid of edicts, area type of queries */
+} arearecord_t;
 
-float *area_mins, *area_maxs;
-edict_t **area_list;
-int area_count, area_maxcount;
-int area_type;
+static struct
+{
+	FILE *f;
+	arearecord_t *edicts;
+	arearecord_t *queries;
+	int numqueries;
+	int frames, maxframes;
+	char name[MAX_OSPATH];
+} sv_arearecord;
+
+static void SV_RecordTrace(vec3_t start, vec3_t mins, vec3_t maxs,
+		vec3_t end, edict_t *passedict, int contentmask);
+static void SV_RecordAreaQuery(vec3_t mins, vec3_t maxs, int areatype);
+static void SV_FinishAreaRecord(void);
 
 int SV_HullForEntity(edict_t *ent);
 
@@ -78,15 +221,15 @@ InsertLinkBefore(link_t *l, link_t *before)
 /*
  * Builds a uniformly subdivided tree for the given world size
  */
-areanode_t *
-SV_CreateAreaNode(int depth, vec3_t mins, vec3_t maxs)
+static areanode_t *
+SV_CreateAreaNode(areaworld_t *w, int depth, vec3_t mins, vec3_t maxs)
 {
 	areanode_t *anode;
 	vec3_t size;
 	vec3_t mins1, maxs1, mins2, maxs2;
 
-	anode = &sv_areanodes[sv_numareanodes];
-	sv_numareanodes++;
+	anode = &w->areanodes[w->numareanodes];
+	w->numareanodes++;
 
 	ClearLink(&anode->trigger_edicts);
 	ClearLink(&anode->solid_edicts);
@@ -117,256 +260,271 @@ SV_CreateAreaNode(int depth, vec3_t mins, vec3_t maxs)
 
 	maxs1[anode->axis] = mins2[anode->axis] = anode->dist;
 
-	anode->children[0] = SV_CreateAreaNode(depth + 1, mins2, maxs2);
-	anode->children[1] = SV_CreateAreaNode(depth + 1, mins1, maxs1);
+	anode->children[0] = SV_CreateAreaNode(w, depth + 1, mins2, maxs2);
+	anode->children[1] = SV_CreateAreaNode(w, depth + 1, mins1, maxs1);
 
 	return anode;
 }
 
-void
-SV_ClearWorld(void)
+static octnode_t *
+SV_CreateOctreeNode(areaworld_t *w, octnode_t *parent, int side,
+		vec3_t center, float size)
 {
-	memset(sv_areanodes, 0, sizeof(sv_areanodes));
-	sv_numareanodes = 0;
-	SV_CreateAreaNode(0, sv.models[1]->mins, sv.models[1]->maxs);
-}
+	octnode_t *onode;
 
-void
-SV_UnlinkEdict(edict_t *ent)
-{
-	if (!ent->area.prev)
+	if (w->freeoctnodes)
 	{
-		return; /* not linked in anywhere */
+		onode = w->freeoctnodes;
+		w->freeoctnodes = onode->parent;
+		w->numfreeoctnodes--;
 	}
-
-	RemoveLink(&ent->area);
-	ent->area.prev = ent->area.next = NULL;
-}
-
-void
-SV_LinkEdict(edict_t *ent)
-{
-	areanode_t *node;
-	int leafs[MAX_TOTAL_ENT_LEAFS];
-	int clusters[MAX_TOTAL_ENT_LEAFS];
-	int num_leafs;
-	int i, j, k;
-	int area;
-	int topnode;
-
-	if (ent->area.prev)
+	else if (w->numoctnodes < OCTREE_NODES)
 	{
-		SV_UnlinkEdict(ent); /* unlink from old position */
+		onode = &w->octnodes[w->numoctnodes];
+		w->numoctnodes++;
 	}
-
-	if (ent == ge->edicts)
+	else
 	{
-		return; /* don't add the world */
-	}
+		if (!w->octnodesfull)
+		{
+			Com_DPrintf("SV_CreateOctreeNode: out of nodes, edicts stay "
+					"in bigger nodes\n");
+			w->octnodesfull = true;
+		}
 
-	if (!ent->inuse)
-	{
-		return;
+		return NULL;
 	}
 
-	/* set the size */
-	VectorSubtract(ent->maxs, ent->mins, ent->size);
-
-	/* encode the size into the entity_state for client prediction */
-	if ((ent->solid == SOLID_BBOX) && !(ent->svflags & SVF_DEADMONSTER))
-	{
-		/* assume that x/y are equal and symetric */
-		i = (int)ent->maxs[0] / 8;
+	VectorCopy(center, onode->center);
+	onode->size = size;
+	onode->parent = parent;
+	onode->side = side;
+	memset(onode->children, 0, sizeof(onode->children));
+	onode->numedicts[0] = onode->numedicts[1] = 0;
+	onode->occupied[0] = onode->occupied[1] = 0;
 
-		if (i < 1)
-		{
-			i = 1;
-		}
+	ClearLink(&onode->trigger_edicts);
+	ClearLink(&onode->solid_edicts);
 
-		if (i > 31)
-		{
-			i = 31;
-		}
+	return onode;
+}
 
-		/* z is not symetric */
-		j = (int)(-ent->mins[2]) / 8;
+/*
+ * Sets up an empty broadphase for the given world size. The
+ * octree nodes are created on demand when edicts are linked.
+ */
+static void
+SV_InitAreaWorld(areaworld_t *w, broadphase_t broadphase,
+		vec3_t mins, vec3_t maxs)
+{
+	vec3_t center;
+	float size, v;
+	int i;
 
-		if (j < 1)
-		{
-			j = 1;
-		}
+	w->broadphase = broadphase;
+	w->numareanodes = 0;
+	w->numoctnodes = 0;
+	w->freeoctnodes = NULL;
+	w->numfreeoctnodes = 0;
+	w->octnodesfull = false;
 
-		if (j > 31)
+	if (broadphase == BROADPHASE_OCTREE)
+	{
+		if (!w->octnodes)
 		{
-			j = 31;
+			w->octnodes = Z_Malloc(OCTREE_NODES * sizeof(octnode_t));
 		}
 
-		/* and z maxs can be negative... */
-		k = (int)(ent->maxs[2] + 32) / 8;
+		/* the root is a cube around the world */
+		size = 0;
 
-		if (k < 1)
+		for (i = 0; i < 3; i++)
 		{
-			k = 1;
-		}
+			center[i] = 0.5f * (mins[i] + maxs[i]);
+			v = 0.5f * (maxs[i] - mins[i]);
 
-		if (k > 63)
-		{
-			k = 63;
+			if (v > size)
+			{
+				size = v;
+			}
 		}
 
-		ent->s.solid = (k << 10) | (j << 5) | i;
-	}
-	else if (ent->solid == SOLID_BSP)
-	{
-		ent->s.solid = 31; /* a solid_bbox will never create this value */
+		SV_CreateOctreeNode(w, NULL, 0, center, size);
 	}
 	else
 	{
-		ent->s.solid = 0;
+		memset(w->areanodes, 0, sizeof(w->areanodes));
+		SV_CreateAreaNode(w, 0, mins, maxs);
 	}
+}
 
-	/* set the abs box */
-	if ((ent->solid == SOLID_BSP) &&
-		(ent->s.angles[0] || ent->s.angles[1] ||
-		 ent->s.angles[2]))
+static void
+SV_FreeAreaWorld(areaworld_t *w)
+{
+	if (w->octnodes)
 	{
-		/* expand for rotation */
-		float max, v;
-		int i;
-
-		max = 0;
+		Z_Free(w->octnodes);
+	}
 
-		for (i = 0; i < 3; i++)
-		{
-			v = (float)fabs(ent->mins[i]);
+	memset(w, 0, sizeof(*w));
+}
 
-			if (v > max)
-			{
-				max = v;
-			}
+void
+SV_ClearWorld(void)
+{
+	int i;
 
-			v = (float)fabs(ent->maxs[i]);
+	if (sv_arearecord.f)
+	{
+		SV_FinishAreaRecord();
+	}
 
-			if (v > max)
-			{
-				max = v;
-			}
-		}
+	/* the nodes of the live world are kept, the edicts
+	   linked into them are cleared by the game */
+	SV_InitAreaWorld(&sv_world, (sv_broadphase->value == 1) ?
+			BROADPHASE_OCTREE : BROADPHASE_AREATREE,
+			sv.models[1]->mins, sv.models[1]->maxs);
 
-		for (i = 0; i < 3; i++)
+	/* the leafs are looked up again on the new map */
+	if (sv_numlinkcache != ge->max_edicts)
+	{
+		if (sv_linkcache)
 		{
-			ent->absmin[i] = ent->s.origin[i] - max;
-			ent->absmax[i] = ent->s.origin[i] + max;
+			Z_Free(sv_linkcache);
 		}
+
+		sv_numlinkcache = ge->max_edicts;
+		sv_linkcache = Z_Malloc(sv_numlinkcache * sizeof(linkcache_t));
 	}
-	else
+
+	memset(sv_linkcache, 0, sv_numlinkcache * sizeof(linkcache_t));
+
+	for (i = 0; i < sv_numlinkcache; i++)
 	{
-		/* normal */
-		VectorAdd(ent->s.origin, ent->mins, ent->absmin);
-		VectorAdd(ent->s.origin, ent->maxs, ent->absmax);
+		sv_linkcache[i].octnode = -1;
 	}
+}
 
-	/* because movement is clipped an epsilon away from an actual edge,
-	   we must fully check even when bounding boxes don't quite touch */
-	ent->absmin[0] -= 1;
-	ent->absmin[1] -= 1;
-	ent->absmin[2] -= 1;
-	ent->absmax[0] += 1;
-	ent->absmax[1] += 1;
-	ent->absmax[2] += 1;
-
-	/* link to PVS leafs */
-	ent->num_clusters = 0;
-	ent->areanum = 0;
-	ent->areanum2 = 0;
+/*
+ * Finds the smallest octree node whose loose bounds
+ * enclose the box, creating the nodes on the way.
+ */
+static octnode_t *
+SV_OctreeNodeForBox(areaworld_t *w, vec3_t mins, vec3_t maxs)
+{
+	octnode_t *onode, *child;
+	vec3_t center, childcenter;
+	float radius, v;
+	int i, depth, side;
 
-	/* get all leafs, including solids */
-	num_leafs = CM_BoxLeafnums(ent->absmin, ent->absmax,
-			leafs, MAX_TOTAL_ENT_LEAFS, &topnode);
+	radius = 0;
 
-	/* set areas */
-	for (i = 0; i < num_leafs; i++)
+	for (i = 0; i < 3; i++)
 	{
-		clusters[i] = CM_LeafCluster(leafs[i]);
-		area = CM_LeafArea(leafs[i]);
+		center[i] = 0.5f * (mins[i] + maxs[i]);
+		v = 0.5f * (maxs[i] - mins[i]);
 
-		if (area)
+		if (v > radius)
 		{
-			/* doors may legally straggle two areas,
-			   but nothing should evern need more than that */
-			if (ent->areanum && (ent->areanum != area))
-			{
-				if (ent->areanum2 && (ent->areanum2 != area) &&
-					(sv.state == ss_loading))
-				{
-					Com_DPrintf("Object touching 3 areas at %f %f %f\n",
-							ent->absmin[0], ent->absmin[1], ent->absmin[2]);
-				}
-
-				ent->areanum2 = area;
-			}
-			else
-			{
-				ent->areanum = area;
-			}
+			radius = v;
 		}
 	}
 
-	if (num_leafs >= MAX_TOTAL_ENT_LEAFS)
+	onode = w->octnodes;
+
+	/* outside of the world, the root is always searched */
+	for (i = 0; i < 3; i++)
 	{
-		/* assume we missed some leafs, and mark by headnode */
-		ent->num_clusters = -1;
-		ent->headnode = topnode;
+		if (fabs(center[i] - onode->center[i]) > onode->size)
+		{
+			return onode;
+		}
 	}
-	else
+
+	for (depth = 0; depth < OCTREE_DEPTH; depth++)
 	{
-		ent->num_clusters = 0;
+		/* does the box still fit into the children? */
+		if (radius > 0.5f * onode->size)
+		{
+			break;
+		}
 
-		for (i = 0; i < num_leafs; i++)
+		side = 0;
+
+		for (i = 0; i < 3; i++)
 		{
-			if (clusters[i] == -1)
+			if (center[i] >= onode->center[i])
 			{
-				continue; /* not a visible leaf */
+				side |= 1 << i;
 			}
+		}
 
-			for (j = 0; j < i; j++)
+		child = onode->children[side];
+
+		if (!child)
+		{
+			for (i = 0; i < 3; i++)
 			{
-				if (clusters[j] == clusters[i])
-				{
-					break;
-				}
+				childcenter[i] = onode->center[i] +
+					((side & (1 << i)) ? 0.5f : -0.5f) * onode->size;
 			}
 
-			if (j == i)
-			{
-				if (ent->num_clusters == MAX_ENT_CLUSTERS)
-				{
-					/* assume we missed some leafs, and mark by headnode */
-					ent->num_clusters = -1;
-					ent->headnode = topnode;
-					break;
-				}
+			child = SV_CreateOctreeNode(w, onode, side, childcenter,
+					0.5f * onode->size);
 
-				ent->clusternums[ent->num_clusters++] = clusters[i];
+			if (!child)
+			{
+				break; /* out of nodes, the parent will do */
 			}
+
+			onode->children[side] = child;
 		}
-	}
 
-	/* if first time, make sure old_origin is valid */
-	if (!ent->linkcount)
-	{
-		VectorCopy(ent->s.origin, ent->s.old_origin);
+		onode = child;
 	}
 
-	ent->linkcount++;
+	return onode;
+}
 
-	if (ent->solid == SOLID_NOT)
+/*
+ * Returns where the edict went in the octree, as 2 * node + 1
+ * for the trigger list, or -1 in the area tree.
+ */
+static int
+SV_LinkToAreaWorld(areaworld_t *w, edict_t *ent)
+{
+	areanode_t *node;
+	octnode_t *onode;
+	int type, octnode;
+
+	if (w->broadphase == BROADPHASE_OCTREE)
 	{
-		return;
+		onode = SV_OctreeNodeForBox(w, ent->absmin, ent->absmax);
+		type = (ent->solid == SOLID_TRIGGER);
+		octnode = 2 * (int)(onode - w->octnodes) + type;
+
+		if (type)
+		{
+			InsertLinkBefore(&ent->area, &onode->trigger_edicts);
+		}
+		else
+		{
+			InsertLinkBefore(&ent->area, &onode->solid_edicts);
+		}
+
+		for ( ; onode; onode = onode->parent)
+		{
+			if ((onode->numedicts[type]++ == 0) && onode->parent)
+			{
+				onode->parent->occupied[type] |= 1 << onode->side;
+			}
+		}
+
+		return octnode;
 	}
 
 	/* find the first node that the ent's box crosses */
-	node = sv_areanodes;
+	node = w->areanodes;
 
 	while (1)
 	{
@@ -398,323 +556,1680 @@ SV_LinkEdict(edict_t *ent)
 	{
 		InsertLinkBefore(&ent->area, &node->solid_edicts);
 	}
+
+	return -1;
 }
 
-void
-SV_AreaEdicts_r(areanode_t *node)
+/*
+ * The octree counts the edicts below each node so that the
+ * queries can skip empty branches. A node without edicts
+ * below has no children left either and is recycled.
+ */
+static void
+SV_UnlinkFromOctree(areaworld_t *w, edict_t *ent)
 {
-	link_t *l, *next, *start;
-	edict_t *check;
+	octnode_t *onode, *parent;
+	linkcache_t *cache;
+	int type;
 
-	/* touch linked edicts */
-	if (area_type == AREA_SOLID)
+	if (NUM_FOR_EDICT(ent) >= sv_numlinkcache)
 	{
-		start = &node->solid_edicts;
+		return;
 	}
-	else
+
+	cache = &sv_linkcache[NUM_FOR_EDICT(ent)];
+
+	if (cache->octnode < 0)
 	{
-		start = &node->trigger_edicts;
+		return;
 	}
 
-	for (l = start->next; l != start; l = next)
+	onode = &w->octnodes[cache->octnode >> 1];
+	type = cache->octnode & 1;
+	cache->octnode = -1;
+
+	for ( ; onode; onode = parent)
 	{
-		next = l->next;
-		check = (EDICT_FROM_AREA(l));
+		parent = onode->parent;
 
-		if (check->solid == SOLID_NOT)
+		if ((--onode->numedicts[type] == 0) && parent)
 		{
-			continue; /* deactivated */
-		}
+			parent->occupied[type] &= ~(1 << onode->side);
 
-		if ((check->absmin[0] > area_maxs[0]) ||
-			(check->absmin[1] > area_maxs[1]) ||
-			(check->absmin[2] > area_maxs[2]) ||
-			(check->absmax[0] < area_mins[0]) ||
-			(check->absmax[1] < area_mins[1]) ||
-			(check->absmax[2] < area_mins[2]))
-		{
-			continue; /* not touching */
+			if (!onode->numedicts[type ^ 1])
+			{
+				parent->children[onode->side] = NULL;
+				onode->parent = w->freeoctnodes;
+				w->freeoctnodes = onode;
+				w->numfreeoctnodes++;
+			}
 		}
+	}
+}
+
+/*
+ * Finds the clusters and areas the edict is in, starting
+ * the leaf search at the hint. Returns the hint for the
+ * next time: the topnode or -1 - leafnum for one leaf.
+ */
+static int
+SV_LinkLeafs(edict_t *ent, int hint)
+{
+	int leafs[MAX_TOTAL_ENT_LEAFS];
+	int clusters[MAX_TOTAL_ENT_LEAFS];
+	int num_leafs;
+	int i, j;
+	int area;
+	int topnode;
+
+	ent->num_clusters = 0;
+	ent->areanum = 0;
+	ent->areanum2 = 0;
+
+	/* get all leafs, including solids */
+	num_leafs = CM_BoxLeafnumsHint(ent->absmin, ent->absmax,
+			leafs, MAX_TOTAL_ENT_LEAFS, &topnode, hint);
+
+	/* set areas */
+	for (i = 0; i < num_leafs; i++)
+	{
+		clusters[i] = CM_LeafCluster(leafs[i]);
+		area = CM_LeafArea(leafs[i]);
 
-		if (area_count == area_maxcount)
+		if (area)
 		{
-			Com_Printf("SV_AreaEdicts: MAXCOUNT\n");
-			return;
-		}
+			/* doors may legally straggle two areas,
+			   but nothing should evern need more than that */
+			if (ent->areanum && (ent->areanum != area))
+			{
+				if (ent->areanum2 && (ent->areanum2 != area) &&
+					(sv.state == ss_loading))
+				{
+					Com_DPrintf("Object touching 3 areas at %f %f %f\n",
+							ent->absmin[0], ent->absmin[1], ent->absmin[2]);
+				}
 
-		area_list[area_count] = check;
-		area_count++;
+				ent->areanum2 = area;
+			}
+			else
+			{
+				ent->areanum = area;
+			}
+		}
 	}
 
-	if (node->axis == -1)
+	if (num_leafs >= MAX_TOTAL_ENT_LEAFS)
 	{
-		return; /* terminal node */
+		/* assume we missed some leafs, and mark by headnode */
+		ent->num_clusters = -1;
+		ent->headnode = topnode;
 	}
-
-	/* recurse down both sides */
-	if (area_maxs[node->axis] > node->dist)
+	else
 	{
-		SV_AreaEdicts_r(node->children[0]);
+		ent->num_clusters = 0;
+
+		for (i = 0; i < num_leafs; i++)
+		{
+			if (clusters[i] == -1)
+			{
+				continue; /* not a visible leaf */
+			}
+
+			for (j = 0; j < i; j++)
+			{
+				if (clusters[j] == clusters[i])
+				{
+					break;
+				}
+			}
+
+			if (j == i)
+			{
+				if (ent->num_clusters == MAX_ENT_CLUSTERS)
+				{
+					/* assume we missed some leafs, and mark by headnode */
+					ent->num_clusters = -1;
+					ent->headnode = topnode;
+					break;
+				}
+
+				ent->clusternums[ent->num_clusters++] = clusters[i];
+			}
+		}
 	}
 
-	if (area_mins[node->axis] < node->dist)
+	if ((topnode == -1) && (num_leafs == 1))
 	{
-		SV_AreaEdicts_r(node->children[1]);
+		return -1 - leafs[0];
 	}
+
+	return (topnode == -1) ? 0 : topnode;
 }
 
-int
-SV_AreaEdicts(vec3_t mins, vec3_t maxs, edict_t **list,
-		int maxcount, int areatype)
+/*
+ * The leafs from the last link still hold if the box is
+ * the same, as long as the edict wasn't cleared since.
+ */
+static qboolean
+SV_LinkCacheHit(edict_t *ent, linkcache_t *cache)
 {
-	area_mins = mins;
-	area_maxs = maxs;
-	area_list = list;
-	area_maxcount = maxcount;
-	area_type = areatype;
-	area_count = 0;
+	if (!cache || !ent->linkcount || (cache->linkcount != ent->linkcount))
+	{
+		return false;
+	}
 
-	SV_AreaEdicts_r(sv_areanodes);
+	if (!VectorCompare(ent->absmin, cache->absmin) ||
+		!VectorCompare(ent->absmax, cache->absmax))
+	{
+		return false;
+	}
 
-	area_mins = 0;
-	area_maxs = 0;
-	area_list = 0;
-	area_maxcount = 0;
-	area_type = 0;
+	sv_linkstats.unchanged++;
 
-	return area_count;
+	return true;
 }
 
-int
-SV_PointContents(vec3_t p)
+/*
+ * linkstats
+ * Prints how many links skipped the leaf lookup
+ * and resets the counter. How often the others
+ * started below the root shows cm_pointstats.
+ */
+void
+SV_LinkStats_f(void)
 {
-	edict_t *touch[MAX_EDICTS], *hit;
-	int i, num;
-	int contents, c2;
-	int headnode;
-
-	/* get base contents from world */
-	contents = CM_PointContents(p, sv.models[1]->headnode);
+	Com_Printf("%i links, %i with unchanged bounds (%.1f%%) skipped the "
+			"leaf lookup\n", sv_linkstats.links, sv_linkstats.unchanged,
+			sv_linkstats.links ?
+			100.0 * sv_linkstats.unchanged / sv_linkstats.links : 0.0);
 
-	/* or in contents from all the other entities */
-	num = SV_AreaEdicts(p, p, touch, MAX_EDICTS, AREA_SOLID);
+	memset(&sv_linkstats, 0, sizeof(sv_linkstats));
+}
 
-	for (i = 0; i < num; i++)
+void
+SV_UnlinkEdict(edict_t *ent)
+{
+	if (!ent->area.prev)
 	{
-		hit = touch[i];
-
-		/* might intersect, so do an exact clip */
-		headnode = SV_HullForEntity(hit);
-		c2 = CM_TransformedPointContents(p, headnode,
-				hit->s.origin, hit->s.angles);
+		return; /* not linked in anywhere */
+	}
 
-		contents |= c2;
+	if (sv_world.broadphase == BROADPHASE_OCTREE)
+	{
+		SV_UnlinkFromOctree(&sv_world, ent);
 	}
 
-	return contents;
+	RemoveLink(&ent->area);
+	ent->area.prev = ent->area.next = NULL;
 }
 
-typedef struct
+void
+SV_LinkEdict(edict_t *ent)
 {
-	vec3_t boxmins, boxmaxs; /* enclose the test object along entire move */
-	float *mins, *maxs; /* size of the moving object */
-	vec3_t mins2, maxs2; /* size when clipping against mosnters */
-	float *start, *end;
-	trace_t trace;
-	edict_t *passedict;
-	int contentmask;
-} moveclip_t;
+	linkcache_t *cache;
+	int i, j, k;
+	int hint;
 
-/*
- * Returns a headnode that can be used for testing or clipping an
- * object of mins/maxs size. Offset is filled in to contain the
- * adjustment that must be added to the testing object's origin
- * to get a point to use with the returned hull.
- */
-int
-SV_HullForEntity(edict_t *ent)
-{
-	/* decide which clipping hull to use, based on the size */
-	if (ent->solid == SOLID_BSP)
+	if (ent->area.prev)
 	{
-		cmodel_t *model;
-
-		/* explicit hulls in the BSP model */
-		model = sv.models[ent->s.modelindex];
-
-		if (!model)
-		{
-			Com_Error(ERR_FATAL, "MOVETYPE_PUSH with a non bsp model");
-		}
-
-		return model->headnode;
+		SV_UnlinkEdict(ent); /* unlink from old position */
 	}
 
-	/* create a temp hull from bounding box sizes */
-	return CM_HeadnodeForBox(ent->mins, ent->maxs);
-}
+	if (ent == ge->edicts)
+	{
+		return; /* don't add the world */
+	}
 
-void
-SV_ClipMoveToEntities(moveclip_t *clip)
-{
-	int i, num;
-	edict_t *touchlist[MAX_EDICTS], *touch;
-	trace_t trace;
-	int headnode;
-	float *angles;
+	if (!ent->inuse)
+	{
+		return;
+	}
 
-	num = SV_AreaEdicts(clip->boxmins, clip->boxmaxs, touchlist,
-			MAX_EDICTS, AREA_SOLID);
+	/* set the size */
+	VectorSubtract(ent->maxs, ent->mins, ent->size);
 
-	/* be careful, it is possible to have an entity in this
-	   list removed before we get to it (killtriggered) */
-	for (i = 0; i < num; i++)
+	/* encode the size into the entity_state for client prediction */
+	if ((ent->solid == SOLID_BBOX) && !(ent->svflags & SVF_DEADMONSTER))
 	{
-		touch = touchlist[i];
+		/* assume that x/y are equal and symetric */
+		i = (int)ent->maxs[0] / 8;
 
-		if (touch->solid == SOLID_NOT)
+		if (i < 1)
 		{
-			continue;
+			i = 1;
 		}
 
-		if (touch == clip->passedict)
+		if (i > 31)
 		{
-			continue;
+			i = 31;
 		}
 
-		if (clip->trace.allsolid)
+		/* z is not symetric */
+		j = (int)(-ent->mins[2]) / 8;
+
+		if (j < 1)
 		{
-			return;
+			j = 1;
 		}
 
-		if (clip->passedict)
+		if (j > 31)
 		{
-			if (touch->owner == clip->passedict)
-			{
-				continue; /* don't clip against own missiles */
-			}
+			j = 31;
+		}
 
-			if (clip->passedict->owner == touch)
+		/* and z maxs can be negative... */
+		k = (int)(ent->maxs[2] + 32) / 8;
+
+		if (k < 1)
+		{
+			k = 1;
+		}
+
+		if (k > 63)
+		{
+			k = 63;
+		}
+
+		ent->s.solid = (k << 10) | (j << 5) | i;
+	}
+	else if (ent->solid == SOLID_BSP)
+	{
+		ent->s.solid = 31; /* a solid_bbox will never create this value */
+	}
+	else
+	{
+		ent->s.solid = 0;
+	}
+
+	/* set the abs box */
+	if ((ent->solid == SOLID_BSP) &&
+		(ent->s.angles[0] || ent->s.angles[1] ||
+		 ent->s.angles[2]))
+	{
+		/* expand for rotation */
+		float max, v;
+		int i;
+
+		max = 0;
+
+		for (i = 0; i < 3; i++)
+		{
+			v = (float)fabs(ent->mins[i]);
+
+			if (v > max)
 			{
-				continue; /* don't clip against owner */
+				max = v;
+			}
+
+			v = (float)fabs(ent->maxs[i]);
+
+			if (v > max)
+			{
+				max = v;
 			}
 		}
 
-		if (!(clip->contentmask & CONTENTS_DEADMONSTER) &&
-			(touch->svflags & SVF_DEADMONSTER))
+		for (i = 0; i < 3; i++)
 		{
-			continue;
+			ent->absmin[i] = ent->s.origin[i] - max;
+			ent->absmax[i] = ent->s.origin[i] + max;
 		}
+	}
+	else
+	{
+		/* normal */
+		VectorAdd(ent->s.origin, ent->mins, ent->absmin);
+		VectorAdd(ent->s.origin, ent->maxs, ent->absmax);
+	}
 
-		/* might intersect, so do an exact clip */
-		headnode = SV_HullForEntity(touch);
-		angles = touch->s.angles;
+	/* because movement is clipped an epsilon away from an actual edge,
+	   we must fully check even when bounding boxes don't quite touch */
+	ent->absmin[0] -= 1;
+	ent->absmin[1] -= 1;
+	ent->absmin[2] -= 1;
+	ent->absmax[0] += 1;
+	ent->absmax[1] += 1;
+	ent->absmax[2] += 1;
 
-		if (touch->solid != SOLID_BSP)
+	/* link to PVS leafs, unless the box didn't leave them */
+	cache = NULL;
+
+	if (NUM_FOR_EDICT(ent) < sv_numlinkcache)
+	{
+		cache = &sv_linkcache[NUM_FOR_EDICT(ent)];
+	}
+
+	sv_linkstats.links++;
+
+	if (!SV_LinkCacheHit(ent, cache))
+	{
+		hint = SV_LinkLeafs(ent, cache ? cache->hint : 0);
+
+		if (cache)
 		{
-			angles = vec3_origin; /* boxes don't rotate */
+			VectorCopy(ent->absmin, cache->absmin);
+			VectorCopy(ent->absmax, cache->absmax);
+			cache->hint = hint;
 		}
+	}
 
-		if (touch->svflags & SVF_MONSTER)
+	/* if first time, make sure old_origin is valid */
+	if (!ent->linkcount)
+	{
+		VectorCopy(ent->s.origin, ent->s.old_origin);
+	}
+
+	ent->linkcount++;
+
+	if (cache)
+	{
+		cache->linkcount = ent->linkcount;
+	}
+
+	if (ent->solid == SOLID_NOT)
+	{
+		return;
+	}
+
+	k = SV_LinkToAreaWorld(&sv_world, ent);
+
+	if (cache)
+	{
+		cache->octnode = k;
+	}
+}
+
+static void
+SV_AreaEdictsLinks(arealist_t *al, link_t *solid_edicts,
+		link_t *trigger_edicts)
+{
+	link_t *l, *next, *start;
+	edict_t *check;
+
+	al->visited++;
+
+	/* touch linked edicts */
+	if (al->type == AREA_SOLID)
+	{
+		start = solid_edicts;
+	}
+	else
+	{
+		start = trigger_edicts;
+	}
+
+	for (l = start->next; l != start; l = next)
+	{
+		next = l->next;
+		check = (EDICT_FROM_AREA(l));
+		al->checked++;
+
+		if (check->solid == SOLID_NOT)
 		{
-			trace = CM_TransformedBoxTrace(clip->start, clip->end,
-					clip->mins2, clip->maxs2, headnode, clip->contentmask,
-					touch->s.origin, angles);
+			continue; /* deactivated */
 		}
-		else
+
+		if ((check->absmin[0] > al->maxs[0]) ||
+			(check->absmin[1] > al->maxs[1]) ||
+			(check->absmin[2] > al->maxs[2]) ||
+			(check->absmax[0] < al->mins[0]) ||
+			(check->absmax[1] < al->mins[1]) ||
+			(check->absmax[2] < al->mins[2]))
 		{
-			trace = CM_TransformedBoxTrace(clip->start, clip->end,
-					clip->mins, clip->maxs, headnode, clip->contentmask,
-					touch->s.origin, angles);
+			continue; /* not touching */
 		}
 
-		if (trace.allsolid || trace.startsolid ||
-			(trace.fraction < clip->trace.fraction))
+		if (al->count == al->maxcount)
 		{
-			trace.ent = touch;
-
-			if (clip->trace.startsolid)
-			{
-				clip->trace = trace;
-				clip->trace.startsolid = true;
-			}
-			else
-			{
-				clip->trace = trace;
-			}
+			return;
 		}
+
+		al->list[al->count] = check;
+		al->count++;
 	}
 }
 
-void
-SV_TraceBounds(vec3_t start, vec3_t mins, vec3_t maxs,
-		vec3_t end, vec3_t boxmins, vec3_t boxmaxs)
+static void
+SV_AreaEdicts_r(arealist_t *al, areanode_t *node)
 {
-	int i;
+	SV_AreaEdictsLinks(al, &node->solid_edicts, &node->trigger_edicts);
+
+	if (node->axis == -1)
+	{
+		return; /* terminal node */
+	}
+
+	/* recurse down both sides */
+	if (al->maxs[node->axis] > node->dist)
+	{
+		SV_AreaEdicts_r(al, node->children[0]);
+	}
+
+	if (al->mins[node->axis] < node->dist)
+	{
+		SV_AreaEdicts_r(al, node->children[1]);
+	}
+}
+
+static void
+SV_AreaEdictsOctree_r(arealist_t *al, octnode_t *onode)
+{
+	static const int upper[3] = {0xaa, 0xcc, 0xf0};
+	float c, near, far;
+	int i, sides, type;
+
+	SV_AreaEdictsLinks(al, &onode->solid_edicts, &onode->trigger_edicts);
+
+	/* the loose bounds of the children reach half the size of
+	   the cube across the center and one and a half outwards,
+	   with an epsilon for rounding */
+	sides = 0xff;
+	near = 0.5f * onode->size + 1;
+	far = 1.5f * onode->size + 1;
 
 	for (i = 0; i < 3; i++)
 	{
-		if (end[i] > start[i])
+		c = onode->center[i];
+
+		if ((al->maxs[i] < c - near) || (al->mins[i] > c + far))
 		{
-			boxmins[i] = start[i] + mins[i] - 1;
-			boxmaxs[i] = end[i] + maxs[i] + 1;
+			sides &= ~upper[i];
 		}
-		else
+
+		if ((al->mins[i] > c + near) || (al->maxs[i] < c - far))
 		{
-			boxmins[i] = end[i] + mins[i] - 1;
-			boxmaxs[i] = start[i] + maxs[i] + 1;
+			sides &= upper[i];
+		}
+	}
+
+	type = (al->type != AREA_SOLID);
+	sides &= onode->occupied[type];
+
+	for (i = 0; sides; i++, sides >>= 1)
+	{
+		if (sides & 1)
+		{
+			SV_AreaEdictsOctree_r(al, onode->children[i]);
 		}
 	}
 }
 
+static void
+SV_AreaEdictsWorld(areaworld_t *w, arealist_t *al)
+{
+	if (w->broadphase == BROADPHASE_OCTREE)
+	{
+		SV_AreaEdictsOctree_r(al, w->octnodes);
+	}
+	else
+	{
+		SV_AreaEdicts_r(al, w->areanodes);
+	}
+}
+
 /*
- * Moves the given mins/maxs volume through the world from start to end.
- * Passedict and edicts owned by passedict are explicitly not checked.
+ * Doesn't touch any global state, so it's
+ * safe to call from the trace workers.
  */
-trace_t
-SV_Trace(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end,
-		edict_t *passedict, int contentmask)
+static int
+SV_AreaEdictsList(vec3_t mins, vec3_t maxs, edict_t **list,
+		int maxcount, int areatype)
 {
-	moveclip_t clip;
+	arealist_t al;
 
-	if (!mins)
+	al.mins = mins;
+	al.maxs = maxs;
+	al.list = list;
+	al.maxcount = maxcount;
+	al.type = areatype;
+	al.count = 0;
+	al.checked = 0;
+	al.visited = 0;
+
+	SV_AreaEdictsWorld(&sv_world, &al);
+
+	return al.count;
+}
+
+int
+SV_AreaEdicts(vec3_t mins, vec3_t maxs, edict_t **list,
+		int maxcount, int areatype)
+{
+	int count;
+
+	if (sv_arearecord.f)
 	{
-		mins = vec3_origin;
+		SV_RecordAreaQuery(mins, maxs, areatype);
 	}
 
-	if (!maxs)
+	count = SV_AreaEdictsList(mins, maxs, list, maxcount, areatype);
+
+	if (count == maxcount)
 	{
-		maxs = vec3_origin;
+		Com_Printf("SV_AreaEdicts: MAXCOUNT\n");
 	}
 
-	memset(&clip, 0, sizeof(moveclip_t));
+	return count;
+}
 
-	/* clip to world */
-	clip.trace = CM_BoxTrace(start, end, mins, maxs, 0, contentmask);
-	clip.trace.ent = ge->edicts;
+int
+SV_PointContents(vec3_t p)
+{
+	edict_t *touch[MAX_EDICTS], *hit;
+	int i, num;
+	int contents, c2;
+	int headnode;
 
-	if (clip.trace.fraction == 0)
-	{
-		return clip.trace; /* blocked by the world */
-	}
+	/* get base contents from world */
+	contents = CM_PointContents(p, sv.models[1]->headnode);
 
-	clip.contentmask = contentmask;
-	clip.start = start;
-	clip.end = end;
-	clip.mins = mins;
-	clip.maxs = maxs;
-	clip.passedict = passedict;
+	/* or in contents from all the other entities */
+	num = SV_AreaEdicts(p, p, touch, MAX_EDICTS, AREA_SOLID);
 
-	VectorCopy(mins, clip.mins2);
-	VectorCopy(maxs, clip.maxs2);
+	for (i = 0; i < num; i++)
+	{
+		hit = touch[i];
 
-	/* create the bounding box of the entire move */
-	SV_TraceBounds(start, clip.mins2, clip.maxs2,
-			end, clip.boxmins, clip.boxmaxs);
+		/* might intersect, so do an exact clip */
+		headnode = SV_HullForEntity(hit);
+		c2 = CM_TransformedPointContents(p, headnode,
+				hit->s.origin, hit->s.angles);
 
-	/* clip to other solid entities */
-	SV_ClipMoveToEntities(&clip);
+		contents |= c2;
+	}
 
-	return clip.trace;
+	return contents;
 }
 
+typedef struct
+{
+	vec3_t boxmins, boxmaxs; /* enclose the test object along entire move */
+	float *mins, *maxs; /* size of the moving object */
+	vec3_t mins2, maxs2; /* size when clipping against mosnters */
+	float *start, *end;
+	trace_t trace;
+	edict_t *passedict;
+	int contentmask;
+} moveclip_t;
+
+/*
+ * Returns a headnode that can be used for testing or clipping an
+ * object of mins/maxs size. Offset is filled in to contain the
+ * adjustment that must be added to the testing object's origin
+ * to get a point to use with the returned hull.
+ */
+static int
+SV_HullForEntityContext(cmtrace_t *tc, edict_t *ent)
+{
+	/* decide which clipping hull to use, based on the size */
+	if (ent->solid == SOLID_BSP)
+	{
+		cmodel_t *model;
+
+		/* explicit hulls in the BSP model */
+		model = sv.models[ent->s.modelindex];
+
+		if (!model)
+		{
+			Com_Error(ERR_FATAL, "MOVETYPE_PUSH with a non bsp model");
+		}
+
+		return model->headnode;
+	}
+
+	/* create a temp hull from bounding box sizes */
+	return CM_HeadnodeForBoxContext(tc, ent->mins, ent->maxs);
+}
+
+int
+SV_HullForEntity(edict_t *ent)
+{
+	return SV_HullForEntityContext(NULL, ent);
+}
+
+static void
+SV_ClipMoveToEntities(cmtrace_t *tc, moveclip_t *clip)
+{
+	int i, num;
+	edict_t *touchlist[MAX_EDICTS], *touch;
+	trace_t trace;
+	int headnode;
+	float *angles;
+
+	num = SV_AreaEdictsList(clip->boxmins, clip->boxmaxs, touchlist,
+			MAX_EDICTS, AREA_SOLID);
+
+	/* be careful, it is possible to have an entity in this
+	   list removed before we get to it (killtriggered) */
+	for (i = 0; i < num; i++)
+	{
+		touch = touchlist[i];
+
+		if (touch->solid == SOLID_NOT)
+		{
+			continue;
+		}
+
+		if (touch == clip->passedict)
+		{
+			continue;
+		}
+
+		if (clip->trace.allsolid)
+		{
+			return;
+		}
+
+		if (clip->passedict)
+		{
+			if (touch->owner == clip->passedict)
+			{
+				continue; /* don't clip against own missiles */
+			}
+
+			if (clip->passedict->owner == touch)
+			{
+				continue; /* don't clip against owner */
+			}
+		}
+
+		if (!(clip->contentmask & CONTENTS_DEADMONSTER) &&
+			(touch->svflags & SVF_DEADMONSTER))
+		{
+			continue;
+		}
+
+		/* might intersect, so do an exact clip */
+		headnode = SV_HullForEntityContext(tc, touch);
+		angles = touch->s.angles;
+
+		if (touch->solid != SOLID_BSP)
+		{
+			angles = vec3_origin; /* boxes don't rotate */
+		}
+
+		if (touch->svflags & SVF_MONSTER)
+		{
+			trace = CM_TransformedBoxTraceContext(tc, clip->start, clip->end,
+					clip->mins2, clip->maxs2, headnode, clip->contentmask,
+					touch->s.origin, angles);
+		}
+		else
+		{
+			trace = CM_TransformedBoxTraceContext(tc, clip->start, clip->end,
+					clip->mins, clip->maxs, headnode, clip->contentmask,
+					touch->s.origin, angles);
+		}
+
+		if (trace.allsolid || trace.startsolid ||
+			(trace.fraction < clip->trace.fraction))
+		{
+			trace.ent = touch;
+
+			if (clip->trace.startsolid)
+			{
+				clip->trace = trace;
+				clip->trace.startsolid = true;
+			}
+			else
+			{
+				clip->trace = trace;
+			}
+		}
+	}
+}
+
+void
+SV_TraceBounds(vec3_t start, vec3_t mins, vec3_t maxs,
+		vec3_t end, vec3_t boxmins, vec3_t boxmaxs)
+{
+	int i;
+
+	for (i = 0; i < 3; i++)
+	{
+		if (end[i] > start[i])
+		{
+			boxmins[i] = start[i] + mins[i] - 1;
+			boxmaxs[i] = end[i] + maxs[i] + 1;
+		}
+		else
+		{
+			boxmins[i] = end[i] + mins[i] - 1;
+			boxmaxs[i] = start[i] + maxs[i] + 1;
+		}
+	}
+}
+
+/*
+ * Moves the given mins/maxs volume through the world from start to end.
+ * Passedict and edicts owned by passedict are explicitly not checked.
+ * Only reads the world and the edicts, so several threads may trace
+ * at once as long as each one brings its own context.
+ */
+static trace_t
+SV_TraceContext(cmtrace_t *tc, vec3_t start, vec3_t mins, vec3_t maxs,
+		vec3_t end, edict_t *passedict, int contentmask)
+{
+	moveclip_t clip;
+
+	if (!mins)
+	{
+		mins = vec3_origin;
+	}
+
+	if (!maxs)
+	{
+		maxs = vec3_origin;
+	}
+
+	memset(&clip, 0, sizeof(moveclip_t));
+
+	/* clip to world */
+	clip.trace = CM_BoxTraceContext(tc, start, end, mins, maxs, 0, contentmask);
+	clip.trace.ent = ge->edicts;
+
+	if (clip.trace.fraction == 0)
+	{
+		return clip.trace; /* blocked by the world */
+	}
+
+	clip.contentmask = contentmask;
+	clip.start = start;
+	clip.end = end;
+	clip.mins = mins;
+	clip.maxs = maxs;
+	clip.passedict = passedict;
+
+	VectorCopy(mins, clip.mins2);
+	VectorCopy(maxs, clip.maxs2);
+
+	/* create the bounding box of the entire move */
+	SV_TraceBounds(start, clip.mins2, clip.maxs2,
+			end, clip.boxmins, clip.boxmaxs);
+
+	/* clip to other solid entities */
+	SV_ClipMoveToEntities(tc, &clip);
+
+	return clip.trace;
+}
+
+static void
+SV_RecordTraceArea(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end)
+{
+	vec3_t boxmins, boxmaxs;
+
+	if (!mins)
+	{
+		mins = vec3_origin;
+	}
+
+	if (!maxs)
+	{
+		maxs = vec3_origin;
+	}
+
+	SV_TraceBounds(start, mins, maxs, end, boxmins, boxmaxs);
+	SV_RecordAreaQuery(boxmins, boxmaxs, AREA_SOLID);
+}
+
+trace_t
+SV_Trace(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end,
+		edict_t *passedict, int contentmask)
+{
+	if (sv_tracerecord.records)
+	{
+		SV_RecordTrace(start, mins, maxs, end, passedict, contentmask);
+	}
+
+	if (sv_arearecord.f)
+	{
+		SV_RecordTraceArea(start, mins, maxs, end);
+	}
+
+	return SV_TraceContext(NULL, start, mins, maxs, end,
+			passedict, contentmask);
+}
+
+static void
+SV_TraceBatchJob(void *data, int job, int worker)
+{
+	int i, last;
+	tracebatch_t *batch = data;
+	tracerequest_t *req;
+
+	i = job * TRACE_BATCH_CHUNK;
+	last = i + TRACE_BATCH_CHUNK;
+
+	if (last > batch->count)
+	{
+		last = batch->count;
+	}
+
+	for ( ; i < last; i++)
+	{
+		req = &batch->requests[i];
+		batch->results[i] = SV_TraceContext(sv_tracecontexts[worker],
+				req->start, req->mins, req->maxs, req->end,
+				req->passent, req->contentmask);
+	}
+}
+
+static void
+SV_RunTraceBatch(tracerequest_t *requests, trace_t *results,
+		int count, int maxworkers)
+{
+	int i, numworkers;
+	tracebatch_t batch;
+
+	numworkers = SV_NumWorkers();
+
+	if ((maxworkers <= 0) || (maxworkers > numworkers))
+	{
+		maxworkers = numworkers;
+	}
+
+	/* each worker traces with its own context */
+	for (i = 1; i < maxworkers; i++)
+	{
+		if (!sv_tracecontexts[i])
+		{
+			sv_tracecontexts[i] = CM_CreateTraceContext();
+
+			if (!sv_tracecontexts[i])
+			{
+				break;
+			}
+		}
+	}
+
+	batch.requests = requests;
+	batch.results = results;
+	batch.count = count;
+
+	SV_RunJobs(SV_TraceBatchJob, &batch,
+			(count + TRACE_BATCH_CHUNK - 1) / TRACE_BATCH_CHUNK, i);
+}
+
+void
+SV_TraceBatch(tracerequest_t *requests, trace_t *results, int count)
+{
+	int i;
+
+	if (count <= 0)
+	{
+		return;
+	}
+
+	if (sv_tracerecord.records)
+	{
+		for (i = 0; i < count; i++)
+		{
+			SV_RecordTrace(requests[i].start, requests[i].mins,
+					requests[i].maxs, requests[i].end,
+					requests[i].passent, requests[i].contentmask);
+		}
+	}
+
+	if (sv_arearecord.f)
+	{
+		for (i = 0; i < count; i++)
+		{
+			SV_RecordTraceArea(requests[i].start, requests[i].mins,
+					requests[i].maxs, requests[i].end);
+		}
+	}
+
+	/* not worth waking up the workers */
+	if (count < 2 * TRACE_BATCH_CHUNK)
+	{
+		for (i = 0; i < count; i++)
+		{
+			results[i] = SV_TraceContext(NULL, requests[i].start,
+					requests[i].mins, requests[i].maxs, requests[i].end,
+					requests[i].passent, requests[i].contentmask);
+		}
+
+		return;
+	}
+
+	SV_RunTraceBatch(requests, results, count, 0);
+}
+
+/*
+ * Trace recording and replay, to measure how well
+ * the batched traces scale with the number of threads.
+ */
+
+static void
+SV_WriteTraceRecord(void)
+{
+	char name[MAX_OSPATH];
+	tracefileheader_t header;
+	FILE *f;
+	int i, count;
+
+	count = sv_tracerecord.count;
+
+	for (i = 0; i < count * (int)(sizeof(tracerecord_t) / 4); i++)
+	{
+		((int *)sv_tracerecord.records)[i] =
+			LittleLong(((int *)sv_tracerecord.records)[i]);
+	}
+
+	Com_sprintf(name, sizeof(name), "%s/traces/%s.trc", FS_Gamedir(),
+			sv_tracerecord.name);
+	FS_CreatePath(name);
+
+	f = Q_fopen(name, "wb");
+
+	if (!f)
+	{
+		Com_Printf("ERROR: couldn't open %s.\n", name);
+	}
+	else
+	{
+		memset(&header, 0, sizeof(header));
+		header.ident = LittleLong(TRACEFILE_IDENT);
+		header.version = LittleLong(TRACEFILE_VERSION);
+		header.count = LittleLong(count);
+		Q_strlcpy(header.mapname, sv.name, sizeof(header.mapname));
+
+		fwrite(&header, sizeof(header), 1, f);
+		fwrite(sv_tracerecord.records, sizeof(tracerecord_t), count, f);
+		fclose(f);
+
+		Com_Printf("Wrote %i traces to %s.\n", count, name);
+	}
+
+	Z_Free(sv_tracerecord.records);
+	memset(&sv_tracerecord, 0, sizeof(sv_tracerecord));
+}
+
+static void
+SV_RecordTrace(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end,
+		edict_t *passedict, int contentmask)
+{
+	tracerecord_t *rec;
+
+	if (!mins)
+	{
+		mins = vec3_origin;
+	}
+
+	if (!maxs)
+	{
+		maxs = vec3_origin;
+	}
+
+	rec = &sv_tracerecord.records[sv_tracerecord.count++];
+
+	VectorCopy(start, rec->start);
+	VectorCopy(mins, rec->mins);
+	VectorCopy(maxs, rec->maxs);
+	VectorCopy(end, rec->end);
+	rec->passent = passedict ? NUM_FOR_EDICT(passedict) : -1;
+	rec->contentmask = contentmask;
+
+	if (sv_tracerecord.count == sv_tracerecord.max)
+	{
+		SV_WriteTraceRecord();
+	}
+}
+
+/*
+ * tracerecord <name> [count]
+ * Records the next count traces issued by the game.
+ */
+void
+SV_TraceRecord_f(void)
+{
+	int count;
+
+	if ((Cmd_Argc() < 2) || (Cmd_Argc() > 3))
+	{
+		Com_Printf("tracerecord <name> [count]\n");
+		return;
+	}
+
+	if (sv.state != ss_game)
+	{
+		Com_Printf("You must be in a level to record.\n");
+		return;
+	}
+
+	if (sv_tracerecord.records)
+	{
+		Com_Printf("Already recording.\n");
+		return;
+	}
+
+	if (strstr(Cmd_Argv(1), "..") ||
+		strstr(Cmd_Argv(1), "/") ||
+		strstr(Cmd_Argv(1), "\\"))
+	{
+		Com_Printf("Illegal filename.\n");
+		return;
+	}
+
+	count = (Cmd_Argc() == 3) ? (int)strtol(Cmd_Argv(2), NULL, 10) : 10000;
+
+	if (count <= 0)
+	{
+		Com_Printf("Nothing to record.\n");
+		return;
+	}
+
+	Q_strlcpy(sv_tracerecord.name, Cmd_Argv(1), sizeof(sv_tracerecord.name));
+	sv_tracerecord.records = Z_Malloc(count * sizeof(tracerecord_t));
+	sv_tracerecord.max = count;
+	sv_tracerecord.count = 0;
+
+	Com_Printf("Recording the next %i traces.\n", count);
+}
+
+static qboolean
+SV_TracesEqual(trace_t *a, trace_t *b)
+{
+	return (a->allsolid == b->allsolid) &&
+		(a->startsolid == b->startsolid) &&
+		(a->fraction == b->fraction) &&
+		VectorCompare(a->endpos, b->endpos) &&
+		VectorCompare(a->plane.normal, b->plane.normal) &&
+		(a->plane.dist == b->plane.dist) &&
+		(a->surface == b->surface) &&
+		(a->contents == b->contents) &&
+		(a->ent == b->ent);
+}
+
+/*
+ * tracebench <name> [threads]
+ * Replays a recorded set of traces against the current
+ * level with 1 up to threads workers and prints the
+ * throughput. Results are checked against a serial run.
+ */
+void
+SV_TraceBench_f(void)
+{
+	char name[MAX_QPATH];
+	byte *buffer;
+	tracefileheader_t *header;
+	tracerecord_t *rec;
+	tracerequest_t *requests;
+	trace_t *reference, *results;
+	int len, count, i, j;
+	int threads, passes, pass, mismatches;
+	long long start, time;
+
+	if ((Cmd_Argc() < 2) || (Cmd_Argc() > 3))
+	{
+		Com_Printf("tracebench <name> [threads]\n");
+		return;
+	}
+
+	if (sv.state != ss_game)
+	{
+		Com_Printf("You must be in a level to replay traces.\n");
+		return;
+	}
+
+	Com_sprintf(name, sizeof(name), "traces/%s.trc", Cmd_Argv(1));
+	len = FS_LoadFile(name, (void **)&buffer);
+
+	if (!buffer)
+	{
+		Com_Printf("Couldn't load %s.\n", name);
+		return;
+	}
+
+	header = (tracefileheader_t *)buffer;
+	count = (len < sizeof(*header)) ? 0 : LittleLong(header->count);
+
+	if ((len < sizeof(*header)) ||
+		(LittleLong(header->ident) != TRACEFILE_IDENT) ||
+		(LittleLong(header->version) != TRACEFILE_VERSION) ||
+		(count <= 0) ||
+		(count > (len - (int)sizeof(*header)) / (int)sizeof(tracerecord_t)))
+	{
+		Com_Printf("%s is not a valid trace recording.\n", name);
+		FS_FreeFile(buffer);
+		return;
+	}
+
+	if (strcmp(header->mapname, sv.name))
+	{
+		Com_Printf("Warning: %s was recorded on %s.\n", name, header->mapname);
+	}
+
+	requests = Z_Malloc(count * sizeof(tracerequest_t));
+	reference = Z_Malloc(count * sizeof(trace_t));
+	results = Z_Malloc(count * sizeof(trace_t));
+
+	rec = (tracerecord_t *)(header + 1);
+
+	for (i = 0; i < count; i++, rec++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			requests[i].start[j] = LittleFloat(rec->start[j]);
+			requests[i].mins[j] = LittleFloat(rec->mins[j]);
+			requests[i].maxs[j] = LittleFloat(rec->maxs[j]);
+			requests[i].end[j] = LittleFloat(rec->end[j]);
+		}
+
+		j = LittleLong(rec->passent);
+		requests[i].passent = ((j >= 0) && (j < ge->num_edicts)) ?
+			EDICT_NUM(j) : NULL;
+		requests[i].contentmask = LittleLong(rec->contentmask);
+	}
+
+	FS_FreeFile(buffer);
+
+	for (i = 0; i < count; i++)
+	{
+		reference[i] = SV_TraceContext(NULL, requests[i].start,
+				requests[i].mins, requests[i].maxs, requests[i].end,
+				requests[i].passent, requests[i].contentmask);
+	}
+
+	threads = (Cmd_Argc() == 3) ? (int)strtol(Cmd_Argv(2), NULL, 10) : 0;
+
+	if ((threads <= 0) || (threads > SV_NumWorkers()))
+	{
+		threads = SV_NumWorkers();
+	}
+
+	/* at least 100000 traces per measurement */
+	passes = 100000 / count + 1;
+
+	Com_Printf("Replaying %i traces, %i passes:\n", count, passes);
+
+	for (i = 1; i <= threads; i++)
+	{
+		mismatches = 0;
+		start = Sys_Microseconds();
+
+		for (pass = 0; pass < passes; pass++)
+		{
+			SV_RunTraceBatch(requests, results, count, i);
+		}
+
+		time = Sys_Microseconds() - start;
+
+		for (j = 0; j < count; j++)
+		{
+			if (!SV_TracesEqual(&results[j], &reference[j]))
+			{
+				mismatches++;
+			}
+		}
+
+		Com_Printf("%2i thread%s %10.0f traces/sec", i, (i == 1) ? ": " : "s:",
+				(double)count * passes * 1000000.0 / (time ? time : 1));
+
+		if (mismatches)
+		{
+			Com_Printf(" (%i results differ)", mismatches);
+		}
+
+		Com_Printf("\n");
+	}
+
+	Z_Free(results);
+	Z_Free(reference);
+	Z_Free(requests);
+}
+
+
+/*
+ * Area recording and replay, to compare the cost
+ * of the broadphases on the same sets of edicts.
+ */
+
+static void
+SV_SwapAreaRecords(arearecord_t *records, int count)
+{
+	int i;
+
+	for (i = 0; i < count * (int)(sizeof(arearecord_t) / 4); i++)
+	{
+		((int *)records)[i] = LittleLong(((int *)records)[i]);
+	}
+}
+
+static void
+SV_WriteAreaHeader(void)
+{
+	areafileheader_t header;
+	int i;
+
+	memset(&header, 0, sizeof(header));
+	header.ident = LittleLong(AREAFILE_IDENT);
+	header.version = LittleLong(AREAFILE_VERSION);
+	header.numframes = LittleLong(sv_arearecord.frames);
+
+	for (i = 0; i < 3; i++)
+	{
+		header.mins[i] = LittleFloat(sv.models[1]->mins[i]);
+		header.maxs[i] = LittleFloat(sv.models[1]->maxs[i]);
+	}
+
+	Q_strlcpy(header.mapname, sv.name, sizeof(header.mapname));
+
+	fseek(sv_arearecord.f, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, sv_arearecord.f);
+	fseek(sv_arearecord.f, 0, SEEK_END);
+}
+
+static void
+SV_FinishAreaRecord(void)
+{
+	fclose(sv_arearecord.f);
+
+	Com_Printf("Wrote %i frames to %s.\n", sv_arearecord.frames,
+			sv_arearecord.name);
+
+	Z_Free(sv_arearecord.queries);
+	Z_Free(sv_arearecord.edicts);
+	memset(&sv_arearecord, 0, sizeof(sv_arearecord));
+}
+
+static void
+SV_RecordAreaQuery(vec3_t mins, vec3_t maxs, int areatype)
+{
+	arearecord_t *rec;
+
+	if (sv_arearecord.numqueries == MAX_AREA_QUERIES)
+	{
+		return;
+	}
+
+	rec = &sv_arearecord.queries[sv_arearecord.numqueries++];
+
+	VectorCopy(mins, rec->mins);
+	VectorCopy(maxs, rec->maxs);
+	rec->type = areatype;
+}
+
+/*
+ * Writes the linked edicts and the queries since the last
+ * frame. Called once per frame after the game has run.
+ */
+void
+SV_RecordAreaFrame(void)
+{
+	areaframeheader_t frame;
+	arearecord_t *rec;
+	edict_t *ent;
+	int i, numedicts;
+
+	if (!sv_arearecord.f)
+	{
+		return;
+	}
+
+	numedicts = 0;
+
+	for (i = 1; i < ge->num_edicts; i++)
+	{
+		ent = EDICT_NUM(i);
+
+		if (!ent->inuse || !ent->area.prev || (ent->solid == SOLID_NOT))
+		{
+			continue;
+		}
+
+		rec = &sv_arearecord.edicts[numedicts++];
+
+		VectorCopy(ent->absmin, rec->mins);
+		VectorCopy(ent->absmax, rec->maxs);
+		rec->type = ent->solid;
+	}
+
+	frame.numedicts = LittleLong(numedicts);
+	frame.numqueries = LittleLong(sv_arearecord.numqueries);
+
+	SV_SwapAreaRecords(sv_arearecord.edicts, numedicts);
+	SV_SwapAreaRecords(sv_arearecord.queries, sv_arearecord.numqueries);
+
+	fwrite(&frame, sizeof(frame), 1, sv_arearecord.f);
+	fwrite(sv_arearecord.edicts, sizeof(arearecord_t), numedicts,
+			sv_arearecord.f);
+	fwrite(sv_arearecord.queries, sizeof(arearecord_t),
+			sv_arearecord.numqueries, sv_arearecord.f);
+
+	sv_arearecord.numqueries = 0;
+	sv_arearecord.frames++;
+
+	/* keep the file valid if the recording is cut short */
+	SV_WriteAreaHeader();
+
+	if (sv_arearecord.frames == sv_arearecord.maxframes)
+	{
+		SV_FinishAreaRecord();
+	}
+}
+
+/*
+ * arearecord <name> [frames]
+ * Records the linked edicts and the area queries
+ * of the next frames, the level change ends it.
+ */
+void
+SV_AreaRecord_f(void)
+{
+	int frames;
+
+	if ((Cmd_Argc() < 2) || (Cmd_Argc() > 3))
+	{
+		Com_Printf("arearecord <name> [frames]\n");
+		return;
+	}
+
+	if (sv.state != ss_game)
+	{
+		Com_Printf("You must be in a level to record.\n");
+		return;
+	}
+
+	if (sv_arearecord.f)
+	{
+		Com_Printf("Already recording.\n");
+		return;
+	}
+
+	if (strstr(Cmd_Argv(1), "..") ||
+		strstr(Cmd_Argv(1), "/") ||
+		strstr(Cmd_Argv(1), "\\"))
+	{
+		Com_Printf("Illegal filename.\n");
+		return;
+	}
+
+	frames = (Cmd_Argc() == 3) ? (int)strtol(Cmd_Argv(2), NULL, 10) : 100;
+
+	if (frames <= 0)
+	{
+		Com_Printf("Nothing to record.\n");
+		return;
+	}
+
+	Com_sprintf(sv_arearecord.name, sizeof(sv_arearecord.name),
+			"%s/areas/%s.are", FS_Gamedir(), Cmd_Argv(1));
+	FS_CreatePath(sv_arearecord.name);
+
+	sv_arearecord.f = Q_fopen(sv_arearecord.name, "wb");
+
+	if (!sv_arearecord.f)
+	{
+		Com_Printf("ERROR: couldn't open %s.\n", sv_arearecord.name);
+		return;
+	}
+
+	sv_arearecord.edicts = Z_Malloc(MAX_EDICTS * sizeof(arearecord_t));
+	sv_arearecord.queries = Z_Malloc(MAX_AREA_QUERIES * sizeof(arearecord_t));
+	sv_arearecord.numqueries = 0;
+	sv_arearecord.frames = 0;
+	sv_arearecord.maxframes = frames;
+
+	SV_WriteAreaHeader();
+
+	Com_Printf("Recording the next %i frames.\n", frames);
+}
+
+static void
+SV_ReadAreaRecords(arearecord_t *in, arearecord_t *out, int count)
+{
+	int i, j;
+
+	for (i = 0; i < count; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			out[i].mins[j] = LittleFloat(in[i].mins[j]);
+			out[i].maxs[j] = LittleFloat(in[i].maxs[j]);
+		}
+
+		out[i].type = LittleLong(in[i].type);
+	}
+}
+
+/*
+ * areabench <name>
+ * Links the edicts of each frame of an area recording into
+ * the area tree and the loose octree, replays the queries
+ * against both and prints the cost of each broadphase.
+ * Queries with differing results are reported.
+ */
+void
+SV_AreaBench_f(void)
+{
+	static const char *names[2] = {"area tree", "loose octree"};
+	char name[MAX_QPATH];
+	byte *buffer, *p, *end;
+	areafileheader_t *header;
+	areaframeheader_t *frame;
+	arearecord_t *edictrecs, *queries, *q;
+	areaworld_t world;
+	arealist_t al;
+	edict_t *edicts, **list;
+	vec3_t mins, maxs;
+	int *counts, *sums;
+	int len, numframes, numedicts, numqueries;
+	int totaledicts, totalqueries;
+	int i, j, k, f, bp, pass, passes, sum, mismatches;
+	long long start, linktime[2], querytime[2];
+	long long checked[2], found[2], visited[2];
+
+	if (Cmd_Argc() != 2)
+	{
+		Com_Printf("areabench <name>\n");
+		return;
+	}
+
+	Com_sprintf(name, sizeof(name), "areas/%s.are", Cmd_Argv(1));
+	len = FS_LoadFile(name, (void **)&buffer);
+
+	if (!buffer)
+	{
+		Com_Printf("Couldn't load %s.\n", name);
+		return;
+	}
+
+	header = (areafileheader_t *)buffer;
+	numframes = (len < sizeof(*header)) ? 0 : LittleLong(header->numframes);
+
+	if ((len < sizeof(*header)) ||
+		(LittleLong(header->ident) != AREAFILE_IDENT) ||
+		(LittleLong(header->version) != AREAFILE_VERSION) ||
+		(numframes <= 0))
+	{
+		Com_Printf("%s is not a valid area recording.\n", name);
+		FS_FreeFile(buffer);
+		return;
+	}
+
+	/* check the frames before running anything */
+	p = (byte *)(header + 1);
+	end = buffer + len;
+	totaledicts = totalqueries = 0;
+
+	for (f = 0; f < numframes; f++)
+	{
+		frame = (areaframeheader_t *)p;
+
+		if (p + sizeof(*frame) > end)
+		{
+			break;
+		}
+
+		numedicts = LittleLong(frame->numedicts);
+		numqueries = LittleLong(frame->numqueries);
+
+		if ((numedicts < 0) || (numedicts > MAX_EDICTS) ||
+			(numqueries < 0) || (numqueries > MAX_AREA_QUERIES) ||
+			((numedicts + numqueries) * sizeof(arearecord_t) >
+			 end - p - sizeof(*frame)))
+		{
+			break;
+		}
+
+		totaledicts += numedicts;
+		totalqueries += numqueries;
+		p += sizeof(*frame) + (numedicts + numqueries) * sizeof(arearecord_t);
+	}
+
+	if ((f < numframes) || !totalqueries)
+	{
+		Com_Printf("%s is not a valid area recording.\n", name);
+		FS_FreeFile(buffer);
+		return;
+	}
+
+	for (i = 0; i < 3; i++)
+	{
+		mins[i] = LittleFloat(header->mins[i]);
+		maxs[i] = LittleFloat(header->maxs[i]);
+	}
+
+	edicts = Z_Malloc(MAX_EDICTS * sizeof(edict_t));
+	list = Z_Malloc(MAX_EDICTS * sizeof(edict_t *));
+	edictrecs = Z_Malloc(MAX_EDICTS * sizeof(arearecord_t));
+	queries = Z_Malloc(MAX_AREA_QUERIES * sizeof(arearecord_t));
+	counts = Z_Malloc(MAX_AREA_QUERIES * sizeof(int));
+	sums = Z_Malloc(MAX_AREA_QUERIES * sizeof(int));
+	memset(&world, 0, sizeof(world));
+
+	/* at least 100000 queries per measurement */
+	passes = 100000 / totalqueries + 1;
+	mismatches = 0;
+
+	for (bp = 0; bp < 2; bp++)
+	{
+		linktime[bp] = querytime[bp] = 0;
+		checked[bp] = found[bp] = visited[bp] = 0;
+	}
+
+	p = (byte *)(header + 1);
+
+	for (f = 0; f < numframes; f++)
+	{
+		frame = (areaframeheader_t *)p;
+		numedicts = LittleLong(frame->numedicts);
+		numqueries = LittleLong(frame->numqueries);
+		p += sizeof(*frame);
+
+		SV_ReadAreaRecords((arearecord_t *)p, edictrecs, numedicts);
+		p += numedicts * sizeof(arearecord_t);
+		SV_ReadAreaRecords((arearecord_t *)p, queries, numqueries);
+		p += numqueries * sizeof(arearecord_t);
+
+		memset(edicts, 0, numedicts * sizeof(edict_t));
+
+		for (j = 0; j < numedicts; j++)
+		{
+			edicts[j].inuse = true;
+			edicts[j].solid = edictrecs[j].type;
+			VectorCopy(edictrecs[j].mins, edicts[j].absmin);
+			VectorCopy(edictrecs[j].maxs, edicts[j].absmax);
+		}
+
+		for (bp = 0; bp < 2; bp++)
+		{
+			start = Sys_Microseconds();
+
+			for (pass = 0; pass < passes; pass++)
+			{
+				SV_InitAreaWorld(&world, bp, mins, maxs);
+
+				for (j = 0; j < numedicts; j++)
+				{
+					SV_LinkToAreaWorld(&world, &edicts[j]);
+				}
+			}
+
+			linktime[bp] += Sys_Microseconds() - start;
+			start = Sys_Microseconds();
+
+			for (pass = 0; pass < passes; pass++)
+			{
+				for (j = 0, q = queries; j < numqueries; j++, q++)
+				{
+					al.mins = q->mins;
+					al.maxs = q->maxs;
+					al.list = list;
+					al.maxcount = MAX_EDICTS;
+					al.type = q->type;
+					al.count = 0;
+					al.checked = 0;
+					al.visited = 0;
+
+					SV_AreaEdictsWorld(&world, &al);
+
+					if (pass)
+					{
+						continue;
+					}
+
+					checked[bp] += al.checked;
+					visited[bp] += al.visited;
+					found[bp] += al.count;
+
+					/* the order differs, compare the sets */
+					for (k = 0, sum = 0; k < al.count; k++)
+					{
+						sum += (int)(list[k] - edicts) + 1;
+					}
+
+					if (!bp)
+					{
+						counts[j] = al.count;
+						sums[j] = sum;
+					}
+					else if ((counts[j] != al.count) || (sums[j] != sum))
+					{
+						mismatches++;
+					}
+				}
+			}
+
+			querytime[bp] += Sys_Microseconds() - start;
+		}
+	}
+
+	Com_Printf("Replaying %i frames of %s, %.0f edicts and %.0f queries "
+			"per frame, %i passes:\n", numframes, header->mapname,
+			(double)totaledicts / numframes, (double)totalqueries / numframes,
+			passes);
+
+	for (bp = 0; bp < 2; bp++)
+	{
+		Com_Printf("%-12s %10.0f queries/sec, %5.1f nodes searched, "
+				"%5.1f edicts tested and %5.1f found per query, "
+				"%6.1f us to link a frame\n",
+				names[bp],
+				(double)totalqueries * passes * 1000000.0 /
+				(querytime[bp] ? querytime[bp] : 1),
+				(double)visited[bp] / totalqueries,
+				(double)checked[bp] / totalqueries,
+				(double)found[bp] / totalqueries,
+				(double)linktime[bp] / ((double)numframes * passes));
+	}
+
+	if (mismatches)
+	{
+		Com_Printf("%i queries returned different edicts.\n", mismatches);
+	}
+
+	Com_Printf("The octree used %i of %i nodes in the last frame.\n",
+			world.numoctnodes - world.numfreeoctnodes, OCTREE_NODES);
+
+	SV_FreeAreaWorld(&world);
+
+	Z_Free(sums);
+	Z_Free(counts);
+	Z_Free(queries);
+	Z_Free(edictrecs);
+	Z_Free(list);
+	Z_Free(edicts);
+	FS_FreeFile(buffer);
+}